@@ -0,0 +1,1230 @@
+    .section __TEXT,__text,regular,pure_instructions
+    .build_version macos, 14, 0
+    .p2align 2
+
+    .globl _is_digit
+_is_digit:
+    .cfi_startproc
+    stp x29, x30, [sp, #-16]!
+    mov x29, sp
+    .cfi_def_cfa w29, 16
+    .cfi_offset w30, -8
+    .cfi_offset w29, -16
+    // Save parameters to stack
+    str d0, [sp, #-16]!
+    // Generate function body
+    // If: evaluate condition
+    // Comparison: >=
+    // Load parameter
+    ldr d0, [x29, #-16]
+    str d0, [sp, #-16]!
+    // Load number
+    adrp x8, .L_const_1@PAGE
+    add x8, x8, .L_const_1@PAGEOFF
+    ldr d0, [x8]
+    str d0, [sp, #-16]!
+    ldr d1, [sp], #16
+    ldr d0, [sp], #16
+    fcmp d0, d1
+    cset x0, ge
+    ucvtf d0, x0
+    str d0, [sp, #-16]!
+    // If: check condition
+    ldr d0, [sp], #16
+    fcmp d0, #0.0
+    b.eq L_else_0
+    // If: then branch
+    // If: evaluate condition
+    // Comparison: <=
+    // Load parameter
+    ldr d0, [x29, #-16]
+    str d0, [sp, #-16]!
+    // Load number
+    adrp x8, .L_const_3@PAGE
+    add x8, x8, .L_const_3@PAGEOFF
+    ldr d0, [x8]
+    str d0, [sp, #-16]!
+    ldr d1, [sp], #16
+    ldr d0, [sp], #16
+    fcmp d0, d1
+    cset x0, le
+    ucvtf d0, x0
+    str d0, [sp, #-16]!
+    // If: check condition
+    ldr d0, [sp], #16
+    fcmp d0, #0.0
+    b.eq L_else_2
+    // If: then branch
+    // Load number
+    adrp x8, .L_const_4@PAGE
+    add x8, x8, .L_const_4@PAGEOFF
+    ldr d0, [x8]
+    str d0, [sp, #-16]!
+    b L_end_2
+L_else_2:
+    // If: else branch
+    // Load number
+    adrp x8, .L_const_5@PAGE
+    add x8, x8, .L_const_5@PAGEOFF
+    ldr d0, [x8]
+    str d0, [sp, #-16]!
+L_end_2:
+    b L_end_0
+L_else_0:
+    // If: else branch
+    // Load number
+    adrp x8, .L_const_5@PAGE
+    add x8, x8, .L_const_5@PAGEOFF
+    ldr d0, [x8]
+    str d0, [sp, #-16]!
+L_end_0:
+    // Pop result into d0
+    ldr d0, [sp], #16
+    mov sp, x29
+    ldp x29, x30, [sp], #16
+    ret
+    .cfi_endproc
+
+    .globl _is_space
+_is_space:
+    .cfi_startproc
+    stp x29, x30, [sp, #-16]!
+    mov x29, sp
+    .cfi_def_cfa w29, 16
+    .cfi_offset w30, -8
+    .cfi_offset w29, -16
+    // Save parameters to stack
+    str d0, [sp, #-16]!
+    // Generate function body
+    // If: evaluate condition
+    // Comparison: =
+    // Load parameter
+    ldr d0, [x29, #-16]
+    str d0, [sp, #-16]!
+    // Load number
+    adrp x8, .L_const_7@PAGE
+    add x8, x8, .L_const_7@PAGEOFF
+    ldr d0, [x8]
+    str d0, [sp, #-16]!
+    ldr x1, [sp], #16
+    ldr x0, [sp], #16
+    fmov d0, x0
+    fmov d1, x1
+    fcmp d0, d1
+    b.vc L_eq_num_8
+    bl _value_equals
+    b L_eq_done_8
+L_eq_num_8:
+    cset x0, eq
+L_eq_done_8:
+    ucvtf d0, x0
+    str d0, [sp, #-16]!
+    // If: check condition
+    ldr d0, [sp], #16
+    fcmp d0, #0.0
+    b.eq L_else_6
+    // If: then branch
+    // Load number
+    adrp x8, .L_const_4@PAGE
+    add x8, x8, .L_const_4@PAGEOFF
+    ldr d0, [x8]
+    str d0, [sp, #-16]!
+    b L_end_6
+L_else_6:
+    // If: else branch
+    // If: evaluate condition
+    // Comparison: =
+    // Load parameter
+    ldr d0, [x29, #-16]
+    str d0, [sp, #-16]!
+    // Load number
+    adrp x8, .L_const_10@PAGE
+    add x8, x8, .L_const_10@PAGEOFF
+    ldr d0, [x8]
+    str d0, [sp, #-16]!
+    ldr x1, [sp], #16
+    ldr x0, [sp], #16
+    fmov d0, x0
+    fmov d1, x1
+    fcmp d0, d1
+    b.vc L_eq_num_11
+    bl _value_equals
+    b L_eq_done_11
+L_eq_num_11:
+    cset x0, eq
+L_eq_done_11:
+    ucvtf d0, x0
+    str d0, [sp, #-16]!
+    // If: check condition
+    ldr d0, [sp], #16
+    fcmp d0, #0.0
+    b.eq L_else_9
+    // If: then branch
+    // Load number
+    adrp x8, .L_const_4@PAGE
+    add x8, x8, .L_const_4@PAGEOFF
+    ldr d0, [x8]
+    str d0, [sp, #-16]!
+    b L_end_9
+L_else_9:
+    // If: else branch
+    // If: evaluate condition
+    // Comparison: =
+    // Load parameter
+    ldr d0, [x29, #-16]
+    str d0, [sp, #-16]!
+    // Load number
+    adrp x8, .L_const_13@PAGE
+    add x8, x8, .L_const_13@PAGEOFF
+    ldr d0, [x8]
+    str d0, [sp, #-16]!
+    ldr x1, [sp], #16
+    ldr x0, [sp], #16
+    fmov d0, x0
+    fmov d1, x1
+    fcmp d0, d1
+    b.vc L_eq_num_14
+    bl _value_equals
+    b L_eq_done_14
+L_eq_num_14:
+    cset x0, eq
+L_eq_done_14:
+    ucvtf d0, x0
+    str d0, [sp, #-16]!
+    // If: check condition
+    ldr d0, [sp], #16
+    fcmp d0, #0.0
+    b.eq L_else_12
+    // If: then branch
+    // Load number
+    adrp x8, .L_const_4@PAGE
+    add x8, x8, .L_const_4@PAGEOFF
+    ldr d0, [x8]
+    str d0, [sp, #-16]!
+    b L_end_12
+L_else_12:
+    // If: else branch
+    // If: evaluate condition
+    // Comparison: =
+    // Load parameter
+    ldr d0, [x29, #-16]
+    str d0, [sp, #-16]!
+    // Load number
+    adrp x8, .L_const_16@PAGE
+    add x8, x8, .L_const_16@PAGEOFF
+    ldr d0, [x8]
+    str d0, [sp, #-16]!
+    ldr x1, [sp], #16
+    ldr x0, [sp], #16
+    fmov d0, x0
+    fmov d1, x1
+    fcmp d0, d1
+    b.vc L_eq_num_17
+    bl _value_equals
+    b L_eq_done_17
+L_eq_num_17:
+    cset x0, eq
+L_eq_done_17:
+    ucvtf d0, x0
+    str d0, [sp, #-16]!
+    // If: check condition
+    ldr d0, [sp], #16
+    fcmp d0, #0.0
+    b.eq L_else_15
+    // If: then branch
+    // Load number
+    adrp x8, .L_const_4@PAGE
+    add x8, x8, .L_const_4@PAGEOFF
+    ldr d0, [x8]
+    str d0, [sp, #-16]!
+    b L_end_15
+L_else_15:
+    // If: else branch
+    // Load number
+    adrp x8, .L_const_5@PAGE
+    add x8, x8, .L_const_5@PAGEOFF
+    ldr d0, [x8]
+    str d0, [sp, #-16]!
+L_end_15:
+L_end_12:
+L_end_9:
+L_end_6:
+    // Pop result into d0
+    ldr d0, [sp], #16
+    mov sp, x29
+    ldp x29, x30, [sp], #16
+    ret
+    .cfi_endproc
+
+    .globl _make_token
+_make_token:
+    .cfi_startproc
+    stp x29, x30, [sp, #-16]!
+    mov x29, sp
+    .cfi_def_cfa w29, 16
+    .cfi_offset w30, -8
+    .cfi_offset w29, -16
+    // Save parameters to stack
+    str d0, [sp, #-16]!
+    str d1, [sp, #-16]!
+    str d2, [sp, #-16]!
+    str d3, [sp, #-16]!
+    // Generate function body
+    // List function: cons
+    // Load parameter
+    ldr d0, [x29, #-16]
+    str d0, [sp, #-16]!
+    // List function: cons
+    // Load parameter
+    ldr d0, [x29, #-32]
+    str d0, [sp, #-16]!
+    // List function: cons
+    // Load parameter
+    ldr d0, [x29, #-48]
+    str d0, [sp, #-16]!
+    // List function: cons
+    // Load parameter
+    ldr d0, [x29, #-64]
+    str d0, [sp, #-16]!
+    // List function: empty-list
+    bl _create_list
+    str x0, [sp, #-16]!
+    ldr x1, [sp], #16
+    ldr x0, [sp], #16
+    bl _cons
+    str x0, [sp, #-16]!
+    ldr x1, [sp], #16
+    ldr x0, [sp], #16
+    bl _cons
+    str x0, [sp, #-16]!
+    ldr x1, [sp], #16
+    ldr x0, [sp], #16
+    bl _cons
+    str x0, [sp, #-16]!
+    ldr x1, [sp], #16
+    ldr x0, [sp], #16
+    bl _cons
+    str x0, [sp, #-16]!
+    // Pop result into d0
+    ldr d0, [sp], #16
+    mov sp, x29
+    ldp x29, x30, [sp], #16
+    ret
+    .cfi_endproc
+
+    .globl _tokenize_simple
+_tokenize_simple:
+    .cfi_startproc
+    sub sp, sp, #16
+    .cfi_def_cfa_offset 16
+    stp x29, x30, [sp, #-16]!
+    mov x29, sp
+    .cfi_def_cfa w29, 32
+    .cfi_offset w30, -24
+    .cfi_offset w29, -32
+    // Save parameters to stack
+    str d0, [sp, #-16]!
+    str d1, [sp, #-16]!
+    str d2, [sp, #-16]!
+    str d3, [sp, #-16]!
+    str d4, [sp, #-16]!
+    str d5, [sp, #-16]!
+    // Generate function body
+    // If: evaluate condition
+    // Comparison: >=
+    // Load parameter
+    ldr d0, [x29, #-32]
+    str d0, [sp, #-16]!
+    // Load parameter
+    ldr d0, [x29, #-48]
+    str d0, [sp, #-16]!
+    ldr d1, [sp], #16
+    ldr d0, [sp], #16
+    fcmp d0, d1
+    cset x0, ge
+    ucvtf d0, x0
+    str d0, [sp, #-16]!
+    // If: check condition
+    ldr d0, [sp], #16
+    fcmp d0, #0.0
+    b.eq L_else_18
+    // If: then branch
+    // Load parameter
+    ldr d0, [x29, #-96]
+    str d0, [sp, #-16]!
+    b L_end_18
+L_else_18:
+    // If: else branch
+    // If: evaluate condition
+    // Call function: is-space
+    // String function: str-char-at
+    // Load parameter
+    ldr d0, [x29, #-16]
+    str d0, [sp, #-16]!
+    // Load parameter
+    ldr d0, [x29, #-32]
+    str d0, [sp, #-16]!
+    ldr d0, [sp], #16
+    ldr x0, [sp], #16
+    lsr x9, x0, #48
+    mov x10, #0xfff9
+    cmp x9, x10
+    b.ne L_inline_slow_20
+    and x9, x0, #0xffffffffffff
+    ldur x10, [x9, #-8]
+    fcvtzs x11, d0
+    fmov d0, xzr
+    cmp x11, x10
+    b.hs L_inline_done_20
+    ldrsb w12, [x9, x11]
+    scvtf d0, w12
+    b L_inline_done_20
+L_inline_slow_20:
+    bl _str_char_at
+L_inline_done_20:
+    str d0, [sp, #-16]!
+    // Keep common subexpression
+    ldr x0, [sp]
+    str x0, [x29, #16]
+    ldr d0, [sp], #16
+    bl _is_space
+    str d0, [sp, #-16]!
+    // If: check condition
+    ldr d0, [sp], #16
+    fcmp d0, #0.0
+    b.eq L_else_19
+    // If: then branch
+    // Call function: tokenize-simple
+    // Load parameter
+    ldr d0, [x29, #-16]
+    str d0, [sp, #-16]!
+    // Operator: +
+    // Load parameter
+    ldr d0, [x29, #-32]
+    str d0, [sp, #-16]!
+    // Load number
+    adrp x8, .L_const_4@PAGE
+    add x8, x8, .L_const_4@PAGEOFF
+    ldr d0, [x8]
+    str d0, [sp, #-16]!
+    ldr d0, [sp], #16
+    ldr d1, [sp], #16
+    fadd d0, d0, d1
+    str d0, [sp, #-16]!
+    // Load parameter
+    ldr d0, [x29, #-48]
+    str d0, [sp, #-16]!
+    // Load parameter
+    ldr d0, [x29, #-64]
+    str d0, [sp, #-16]!
+    // Operator: +
+    // Load parameter
+    ldr d0, [x29, #-80]
+    str d0, [sp, #-16]!
+    // Load number
+    adrp x8, .L_const_4@PAGE
+    add x8, x8, .L_const_4@PAGEOFF
+    ldr d0, [x8]
+    str d0, [sp, #-16]!
+    ldr d0, [sp], #16
+    ldr d1, [sp], #16
+    fadd d0, d0, d1
+    str d0, [sp, #-16]!
+    // Load parameter
+    ldr d0, [x29, #-96]
+    str d0, [sp, #-16]!
+    ldr d5, [sp], #16
+    ldr d4, [sp], #16
+    ldr d3, [sp], #16
+    ldr d2, [sp], #16
+    ldr d1, [sp], #16
+    ldr d0, [sp], #16
+    bl _tokenize_simple
+    str d0, [sp, #-16]!
+    b L_end_19
+L_else_19:
+    // If: else branch
+    // If: evaluate condition
+    // Comparison: =
+    // Reuse common subexpression
+    ldr x0, [x29, #16]
+    str x0, [sp, #-16]!
+    // Load number
+    adrp x8, .L_const_22@PAGE
+    add x8, x8, .L_const_22@PAGEOFF
+    ldr d0, [x8]
+    str d0, [sp, #-16]!
+    ldr x1, [sp], #16
+    ldr x0, [sp], #16
+    fmov d0, x0
+    fmov d1, x1
+    fcmp d0, d1
+    b.vc L_eq_num_23
+    bl _value_equals
+    b L_eq_done_23
+L_eq_num_23:
+    cset x0, eq
+L_eq_done_23:
+    ucvtf d0, x0
+    str d0, [sp, #-16]!
+    // If: check condition
+    ldr d0, [sp], #16
+    fcmp d0, #0.0
+    b.eq L_else_21
+    // If: then branch
+    // Call function: tokenize-simple
+    // Load parameter
+    ldr d0, [x29, #-16]
+    str d0, [sp, #-16]!
+    // Operator: +
+    // Load parameter
+    ldr d0, [x29, #-32]
+    str d0, [sp, #-16]!
+    // Load number
+    adrp x8, .L_const_4@PAGE
+    add x8, x8, .L_const_4@PAGEOFF
+    ldr d0, [x8]
+    str d0, [sp, #-16]!
+    ldr d0, [sp], #16
+    ldr d1, [sp], #16
+    fadd d0, d0, d1
+    str d0, [sp, #-16]!
+    // Load parameter
+    ldr d0, [x29, #-48]
+    str d0, [sp, #-16]!
+    // Load parameter
+    ldr d0, [x29, #-64]
+    str d0, [sp, #-16]!
+    ldr x0, [sp]
+    lsr x9, x0, #48
+    mov x10, #0xfffa
+    sub x9, x9, x10
+    cmp x9, #1
+    b.hi L_share_24
+    and x9, x0, #0xffffffffffff
+    mov w10, #1
+    str w10, [x9, #16]
+L_share_24:
+    // Operator: +
+    // Load parameter
+    ldr d0, [x29, #-80]
+    str d0, [sp, #-16]!
+    // Load number
+    adrp x8, .L_const_4@PAGE
+    add x8, x8, .L_const_4@PAGEOFF
+    ldr d0, [x8]
+    str d0, [sp, #-16]!
+    ldr d0, [sp], #16
+    ldr d1, [sp], #16
+    fadd d0, d0, d1
+    str d0, [sp, #-16]!
+    // List function: append
+    // Load parameter
+    ldr d0, [x29, #-96]
+    str d0, [sp, #-16]!
+    // Call function: make-token
+    // Load number
+    adrp x8, .L_const_5@PAGE
+    add x8, x8, .L_const_5@PAGEOFF
+    ldr d0, [x8]
+    str d0, [sp, #-16]!
+    // Load number
+    adrp x8, .L_const_22@PAGE
+    add x8, x8, .L_const_22@PAGEOFF
+    ldr d0, [x8]
+    str d0, [sp, #-16]!
+    // Load parameter
+    ldr d0, [x29, #-64]
+    str d0, [sp, #-16]!
+    ldr x0, [sp]
+    lsr x9, x0, #48
+    mov x10, #0xfffa
+    sub x9, x9, x10
+    cmp x9, #1
+    b.hi L_share_25
+    and x9, x0, #0xffffffffffff
+    mov w10, #1
+    str w10, [x9, #16]
+L_share_25:
+    // Load parameter
+    ldr d0, [x29, #-80]
+    str d0, [sp, #-16]!
+    ldr x0, [sp]
+    lsr x9, x0, #48
+    mov x10, #0xfffa
+    sub x9, x9, x10
+    cmp x9, #1
+    b.hi L_share_26
+    and x9, x0, #0xffffffffffff
+    mov w10, #1
+    str w10, [x9, #16]
+L_share_26:
+    ldr d3, [sp], #16
+    ldr d2, [sp], #16
+    ldr d1, [sp], #16
+    ldr d0, [sp], #16
+    bl _make_token
+    str d0, [sp, #-16]!
+    ldr x1, [sp], #16
+    ldr x0, [sp], #16
+    bl _append_elem
+    str x0, [sp, #-16]!
+    ldr d5, [sp], #16
+    ldr d4, [sp], #16
+    ldr d3, [sp], #16
+    ldr d2, [sp], #16
+    ldr d1, [sp], #16
+    ldr d0, [sp], #16
+    bl _tokenize_simple
+    str d0, [sp, #-16]!
+    b L_end_21
+L_else_21:
+    // If: else branch
+    // If: evaluate condition
+    // Comparison: =
+    // Reuse common subexpression
+    ldr x0, [x29, #16]
+    str x0, [sp, #-16]!
+    // Load number
+    adrp x8, .L_const_28@PAGE
+    add x8, x8, .L_const_28@PAGEOFF
+    ldr d0, [x8]
+    str d0, [sp, #-16]!
+    ldr x1, [sp], #16
+    ldr x0, [sp], #16
+    fmov d0, x0
+    fmov d1, x1
+    fcmp d0, d1
+    b.vc L_eq_num_29
+    bl _value_equals
+    b L_eq_done_29
+L_eq_num_29:
+    cset x0, eq
+L_eq_done_29:
+    ucvtf d0, x0
+    str d0, [sp, #-16]!
+    // If: check condition
+    ldr d0, [sp], #16
+    fcmp d0, #0.0
+    b.eq L_else_27
+    // If: then branch
+    // Call function: tokenize-simple
+    // Load parameter
+    ldr d0, [x29, #-16]
+    str d0, [sp, #-16]!
+    // Operator: +
+    // Load parameter
+    ldr d0, [x29, #-32]
+    str d0, [sp, #-16]!
+    // Load number
+    adrp x8, .L_const_4@PAGE
+    add x8, x8, .L_const_4@PAGEOFF
+    ldr d0, [x8]
+    str d0, [sp, #-16]!
+    ldr d0, [sp], #16
+    ldr d1, [sp], #16
+    fadd d0, d0, d1
+    str d0, [sp, #-16]!
+    // Load parameter
+    ldr d0, [x29, #-48]
+    str d0, [sp, #-16]!
+    // Load parameter
+    ldr d0, [x29, #-64]
+    str d0, [sp, #-16]!
+    ldr x0, [sp]
+    lsr x9, x0, #48
+    mov x10, #0xfffa
+    sub x9, x9, x10
+    cmp x9, #1
+    b.hi L_share_30
+    and x9, x0, #0xffffffffffff
+    mov w10, #1
+    str w10, [x9, #16]
+L_share_30:
+    // Operator: +
+    // Load parameter
+    ldr d0, [x29, #-80]
+    str d0, [sp, #-16]!
+    // Load number
+    adrp x8, .L_const_4@PAGE
+    add x8, x8, .L_const_4@PAGEOFF
+    ldr d0, [x8]
+    str d0, [sp, #-16]!
+    ldr d0, [sp], #16
+    ldr d1, [sp], #16
+    fadd d0, d0, d1
+    str d0, [sp, #-16]!
+    // List function: append
+    // Load parameter
+    ldr d0, [x29, #-96]
+    str d0, [sp, #-16]!
+    // Call function: make-token
+    // Load number
+    adrp x8, .L_const_4@PAGE
+    add x8, x8, .L_const_4@PAGEOFF
+    ldr d0, [x8]
+    str d0, [sp, #-16]!
+    // Load number
+    adrp x8, .L_const_28@PAGE
+    add x8, x8, .L_const_28@PAGEOFF
+    ldr d0, [x8]
+    str d0, [sp, #-16]!
+    // Load parameter
+    ldr d0, [x29, #-64]
+    str d0, [sp, #-16]!
+    ldr x0, [sp]
+    lsr x9, x0, #48
+    mov x10, #0xfffa
+    sub x9, x9, x10
+    cmp x9, #1
+    b.hi L_share_31
+    and x9, x0, #0xffffffffffff
+    mov w10, #1
+    str w10, [x9, #16]
+L_share_31:
+    // Load parameter
+    ldr d0, [x29, #-80]
+    str d0, [sp, #-16]!
+    ldr x0, [sp]
+    lsr x9, x0, #48
+    mov x10, #0xfffa
+    sub x9, x9, x10
+    cmp x9, #1
+    b.hi L_share_32
+    and x9, x0, #0xffffffffffff
+    mov w10, #1
+    str w10, [x9, #16]
+L_share_32:
+    ldr d3, [sp], #16
+    ldr d2, [sp], #16
+    ldr d1, [sp], #16
+    ldr d0, [sp], #16
+    bl _make_token
+    str d0, [sp, #-16]!
+    ldr x1, [sp], #16
+    ldr x0, [sp], #16
+    bl _append_elem
+    str x0, [sp, #-16]!
+    ldr d5, [sp], #16
+    ldr d4, [sp], #16
+    ldr d3, [sp], #16
+    ldr d2, [sp], #16
+    ldr d1, [sp], #16
+    ldr d0, [sp], #16
+    bl _tokenize_simple
+    str d0, [sp, #-16]!
+    b L_end_27
+L_else_27:
+    // If: else branch
+    // If: evaluate condition
+    // Call function: is-digit
+    // Reuse common subexpression
+    ldr x0, [x29, #16]
+    str x0, [sp, #-16]!
+    ldr d0, [sp], #16
+    bl _is_digit
+    str d0, [sp, #-16]!
+    // If: check condition
+    ldr d0, [sp], #16
+    fcmp d0, #0.0
+    b.eq L_else_33
+    // If: then branch
+    // Call function: tokenize-simple
+    // Load parameter
+    ldr d0, [x29, #-16]
+    str d0, [sp, #-16]!
+    ldr x0, [sp]
+    lsr x9, x0, #48
+    mov x10, #0xfffa
+    sub x9, x9, x10
+    cmp x9, #1
+    b.hi L_share_34
+    and x9, x0, #0xffffffffffff
+    mov w10, #1
+    str w10, [x9, #16]
+L_share_34:
+    // Operator: +
+    // Load parameter
+    ldr d0, [x29, #-32]
+    str d0, [sp, #-16]!
+    // Load number
+    adrp x8, .L_const_4@PAGE
+    add x8, x8, .L_const_4@PAGEOFF
+    ldr d0, [x8]
+    str d0, [sp, #-16]!
+    ldr d0, [sp], #16
+    ldr d1, [sp], #16
+    fadd d0, d0, d1
+    str d0, [sp, #-16]!
+    // Load parameter
+    ldr d0, [x29, #-48]
+    str d0, [sp, #-16]!
+    // Load parameter
+    ldr d0, [x29, #-64]
+    str d0, [sp, #-16]!
+    ldr x0, [sp]
+    lsr x9, x0, #48
+    mov x10, #0xfffa
+    sub x9, x9, x10
+    cmp x9, #1
+    b.hi L_share_35
+    and x9, x0, #0xffffffffffff
+    mov w10, #1
+    str w10, [x9, #16]
+L_share_35:
+    // Operator: +
+    // Load parameter
+    ldr d0, [x29, #-80]
+    str d0, [sp, #-16]!
+    // Load number
+    adrp x8, .L_const_4@PAGE
+    add x8, x8, .L_const_4@PAGEOFF
+    ldr d0, [x8]
+    str d0, [sp, #-16]!
+    ldr d0, [sp], #16
+    ldr d1, [sp], #16
+    fadd d0, d0, d1
+    str d0, [sp, #-16]!
+    // List function: append
+    // Load parameter
+    ldr d0, [x29, #-96]
+    str d0, [sp, #-16]!
+    // Call function: make-token
+    // Load number
+    adrp x8, .L_const_36@PAGE
+    add x8, x8, .L_const_36@PAGEOFF
+    ldr d0, [x8]
+    str d0, [sp, #-16]!
+    // Reuse common subexpression
+    ldr x0, [x29, #16]
+    str x0, [sp, #-16]!
+    // Load parameter
+    ldr d0, [x29, #-64]
+    str d0, [sp, #-16]!
+    ldr x0, [sp]
+    lsr x9, x0, #48
+    mov x10, #0xfffa
+    sub x9, x9, x10
+    cmp x9, #1
+    b.hi L_share_37
+    and x9, x0, #0xffffffffffff
+    mov w10, #1
+    str w10, [x9, #16]
+L_share_37:
+    // Load parameter
+    ldr d0, [x29, #-80]
+    str d0, [sp, #-16]!
+    ldr x0, [sp]
+    lsr x9, x0, #48
+    mov x10, #0xfffa
+    sub x9, x9, x10
+    cmp x9, #1
+    b.hi L_share_38
+    and x9, x0, #0xffffffffffff
+    mov w10, #1
+    str w10, [x9, #16]
+L_share_38:
+    ldr d3, [sp], #16
+    ldr d2, [sp], #16
+    ldr d1, [sp], #16
+    ldr d0, [sp], #16
+    bl _make_token
+    str d0, [sp, #-16]!
+    ldr x1, [sp], #16
+    ldr x0, [sp], #16
+    bl _append_elem
+    str x0, [sp, #-16]!
+    ldr d5, [sp], #16
+    ldr d4, [sp], #16
+    ldr d3, [sp], #16
+    ldr d2, [sp], #16
+    ldr d1, [sp], #16
+    ldr d0, [sp], #16
+    bl _tokenize_simple
+    str d0, [sp, #-16]!
+    b L_end_33
+L_else_33:
+    // If: else branch
+    // Call function: tokenize-simple
+    // Load parameter
+    ldr d0, [x29, #-16]
+    str d0, [sp, #-16]!
+    ldr x0, [sp]
+    lsr x9, x0, #48
+    mov x10, #0xfffa
+    sub x9, x9, x10
+    cmp x9, #1
+    b.hi L_share_39
+    and x9, x0, #0xffffffffffff
+    mov w10, #1
+    str w10, [x9, #16]
+L_share_39:
+    // Operator: +
+    // Load parameter
+    ldr d0, [x29, #-32]
+    str d0, [sp, #-16]!
+    // Load number
+    adrp x8, .L_const_4@PAGE
+    add x8, x8, .L_const_4@PAGEOFF
+    ldr d0, [x8]
+    str d0, [sp, #-16]!
+    ldr d0, [sp], #16
+    ldr d1, [sp], #16
+    fadd d0, d0, d1
+    str d0, [sp, #-16]!
+    // Load parameter
+    ldr d0, [x29, #-48]
+    str d0, [sp, #-16]!
+    // Load parameter
+    ldr d0, [x29, #-64]
+    str d0, [sp, #-16]!
+    ldr x0, [sp]
+    lsr x9, x0, #48
+    mov x10, #0xfffa
+    sub x9, x9, x10
+    cmp x9, #1
+    b.hi L_share_40
+    and x9, x0, #0xffffffffffff
+    mov w10, #1
+    str w10, [x9, #16]
+L_share_40:
+    // Operator: +
+    // Load parameter
+    ldr d0, [x29, #-80]
+    str d0, [sp, #-16]!
+    // Load number
+    adrp x8, .L_const_4@PAGE
+    add x8, x8, .L_const_4@PAGEOFF
+    ldr d0, [x8]
+    str d0, [sp, #-16]!
+    ldr d0, [sp], #16
+    ldr d1, [sp], #16
+    fadd d0, d0, d1
+    str d0, [sp, #-16]!
+    // List function: append
+    // Load parameter
+    ldr d0, [x29, #-96]
+    str d0, [sp, #-16]!
+    // Call function: make-token
+    // Load number
+    adrp x8, .L_const_41@PAGE
+    add x8, x8, .L_const_41@PAGEOFF
+    ldr d0, [x8]
+    str d0, [sp, #-16]!
+    // Reuse common subexpression
+    ldr x0, [x29, #16]
+    str x0, [sp, #-16]!
+    // Load parameter
+    ldr d0, [x29, #-64]
+    str d0, [sp, #-16]!
+    ldr x0, [sp]
+    lsr x9, x0, #48
+    mov x10, #0xfffa
+    sub x9, x9, x10
+    cmp x9, #1
+    b.hi L_share_42
+    and x9, x0, #0xffffffffffff
+    mov w10, #1
+    str w10, [x9, #16]
+L_share_42:
+    // Load parameter
+    ldr d0, [x29, #-80]
+    str d0, [sp, #-16]!
+    ldr x0, [sp]
+    lsr x9, x0, #48
+    mov x10, #0xfffa
+    sub x9, x9, x10
+    cmp x9, #1
+    b.hi L_share_43
+    and x9, x0, #0xffffffffffff
+    mov w10, #1
+    str w10, [x9, #16]
+L_share_43:
+    ldr d3, [sp], #16
+    ldr d2, [sp], #16
+    ldr d1, [sp], #16
+    ldr d0, [sp], #16
+    bl _make_token
+    str d0, [sp, #-16]!
+    ldr x1, [sp], #16
+    ldr x0, [sp], #16
+    bl _append_elem
+    str x0, [sp, #-16]!
+    ldr d5, [sp], #16
+    ldr d4, [sp], #16
+    ldr d3, [sp], #16
+    ldr d2, [sp], #16
+    ldr d1, [sp], #16
+    ldr d0, [sp], #16
+    bl _tokenize_simple
+    str d0, [sp, #-16]!
+L_end_33:
+L_end_27:
+L_end_21:
+L_end_19:
+L_end_18:
+    // Pop result into d0
+    ldr d0, [sp], #16
+    mov sp, x29
+    ldp x29, x30, [sp], #16
+    add sp, sp, #16
+    ret
+    .cfi_endproc
+
+    .globl _tokenize
+_tokenize:
+    .cfi_startproc
+    stp x29, x30, [sp, #-16]!
+    mov x29, sp
+    .cfi_def_cfa w29, 16
+    .cfi_offset w30, -8
+    .cfi_offset w29, -16
+    // Save parameters to stack
+    str d0, [sp, #-16]!
+    // Generate function body
+    // Call function: tokenize-simple
+    // Load parameter
+    ldr d0, [x29, #-16]
+    str d0, [sp, #-16]!
+    ldr x0, [sp]
+    lsr x9, x0, #48
+    mov x10, #0xfffa
+    sub x9, x9, x10
+    cmp x9, #1
+    b.hi L_share_44
+    and x9, x0, #0xffffffffffff
+    mov w10, #1
+    str w10, [x9, #16]
+L_share_44:
+    // Load number
+    adrp x8, .L_const_5@PAGE
+    add x8, x8, .L_const_5@PAGEOFF
+    ldr d0, [x8]
+    str d0, [sp, #-16]!
+    // String function: str-length
+    // Load parameter
+    ldr d0, [x29, #-16]
+    str d0, [sp, #-16]!
+    ldr x0, [sp], #16
+    lsr x9, x0, #48
+    mov x10, #0xfff9
+    cmp x9, x10
+    b.ne L_inline_slow_45
+    and x9, x0, #0xffffffffffff
+    ldur x10, [x9, #-8]
+    scvtf d0, x10
+    b L_inline_done_45
+L_inline_slow_45:
+    bl _str_length
+L_inline_done_45:
+    str d0, [sp, #-16]!
+    // Load number
+    adrp x8, .L_const_4@PAGE
+    add x8, x8, .L_const_4@PAGEOFF
+    ldr d0, [x8]
+    str d0, [sp, #-16]!
+    // Load number
+    adrp x8, .L_const_4@PAGE
+    add x8, x8, .L_const_4@PAGEOFF
+    ldr d0, [x8]
+    str d0, [sp, #-16]!
+    // List function: empty-list
+    bl _create_list
+    str x0, [sp, #-16]!
+    ldr d5, [sp], #16
+    ldr d4, [sp], #16
+    ldr d3, [sp], #16
+    ldr d2, [sp], #16
+    ldr d1, [sp], #16
+    ldr d0, [sp], #16
+    bl _tokenize_simple
+    str d0, [sp, #-16]!
+    // Pop result into d0
+    ldr d0, [sp], #16
+    mov sp, x29
+    ldp x29, x30, [sp], #16
+    ret
+    .cfi_endproc
+
+    .globl _grow
+_grow:
+    .cfi_startproc
+    stp x29, x30, [sp, #-16]!
+    mov x29, sp
+    .cfi_def_cfa w29, 16
+    .cfi_offset w30, -8
+    .cfi_offset w29, -16
+    // Save parameters to stack
+    str d0, [sp, #-16]!
+    str d1, [sp, #-16]!
+    // Generate function body
+    // If: evaluate condition
+    // Comparison: <
+    // Load parameter
+    ldr d0, [x29, #-32]
+    str d0, [sp, #-16]!
+    // Load number
+    adrp x8, .L_const_4@PAGE
+    add x8, x8, .L_const_4@PAGEOFF
+    ldr d0, [x8]
+    str d0, [sp, #-16]!
+    ldr d1, [sp], #16
+    ldr d0, [sp], #16
+    fcmp d0, d1
+    cset x0, lt
+    ucvtf d0, x0
+    str d0, [sp, #-16]!
+    // If: check condition
+    ldr d0, [sp], #16
+    fcmp d0, #0.0
+    b.eq L_else_46
+    // If: then branch
+    // Load parameter
+    ldr d0, [x29, #-16]
+    str d0, [sp, #-16]!
+    b L_end_46
+L_else_46:
+    // If: else branch
+    // Call function: grow
+    // String function: str-concat
+    // Load parameter
+    ldr d0, [x29, #-16]
+    str d0, [sp, #-16]!
+    ldr x0, [sp]
+    lsr x9, x0, #48
+    mov x10, #0xfffa
+    sub x9, x9, x10
+    cmp x9, #1
+    b.hi L_share_47
+    and x9, x0, #0xffffffffffff
+    mov w10, #1
+    str w10, [x9, #16]
+L_share_47:
+    // Load parameter
+    ldr d0, [x29, #-16]
+    str d0, [sp, #-16]!
+    ldr x0, [sp]
+    lsr x9, x0, #48
+    mov x10, #0xfffa
+    sub x9, x9, x10
+    cmp x9, #1
+    b.hi L_share_48
+    and x9, x0, #0xffffffffffff
+    mov w10, #1
+    str w10, [x9, #16]
+L_share_48:
+    ldr x1, [sp], #16
+    ldr x0, [sp], #16
+    bl _str_concat
+    str x0, [sp, #-16]!
+    // Operator: -
+    // Load parameter
+    ldr d0, [x29, #-32]
+    str d0, [sp, #-16]!
+    // Load number
+    adrp x8, .L_const_4@PAGE
+    add x8, x8, .L_const_4@PAGEOFF
+    ldr d0, [x8]
+    str d0, [sp, #-16]!
+    ldr d0, [sp], #16
+    ldr d1, [sp], #16
+    fsub d0, d1, d0
+    str d0, [sp, #-16]!
+    ldr d1, [sp], #16
+    ldr d0, [sp], #16
+    bl _grow
+    str d0, [sp, #-16]!
+L_end_46:
+    // Pop result into d0
+    ldr d0, [sp], #16
+    mov sp, x29
+    ldp x29, x30, [sp], #16
+    ret
+    .cfi_endproc
+
+    .section __TEXT,__text
+    .p2align 2
+    .globl _main
+_main:
+    .cfi_startproc
+    stp x29, x30, [sp, #-16]!
+    mov x29, sp
+    .cfi_def_cfa w29, 16
+    .cfi_offset w30, -8
+    .cfi_offset w29, -16
+    // Evaluate expression
+    // List function: list-count
+    // Call function: tokenize
+    // Call function: grow
+    // Load string
+    adrp x0, .L_str_49@PAGE
+    add x0, x0, .L_str_49@PAGEOFF
+    movk x0, #0xfff9, lsl #48
+    str x0, [sp, #-16]!
+    // Load number
+    adrp x8, .L_const_10@PAGE
+    add x8, x8, .L_const_10@PAGEOFF
+    ldr d0, [x8]
+    str d0, [sp, #-16]!
+    ldr d1, [sp], #16
+    ldr d0, [sp], #16
+    bl _grow
+    str d0, [sp, #-16]!
+    ldr d0, [sp], #16
+    bl _tokenize
+    str d0, [sp, #-16]!
+    ldr x0, [sp], #16
+    lsr x9, x0, #48
+    mov x10, #0xfffa
+    sub x9, x9, x10
+    cmp x9, #1
+    b.hi L_inline_slow_50
+    and x9, x0, #0xffffffffffff
+    ldr w10, [x9, #8]
+    scvtf d0, w10
+    b L_inline_done_50
+L_inline_slow_50:
+    bl _list_count
+L_inline_done_50:
+    str d0, [sp, #-16]!
+    // Pop result and print
+    ldr x0, [sp], #16
+    bl _print_value
+    // Return 0
+    mov w0, #0
+    mov sp, x29
+    ldp x29, x30, [sp], #16
+    ret
+    .cfi_endproc
+
+    .section __DATA,__data
+    .p2align 3
+.L_const_1:
+    .double 48
+.L_const_3:
+    .double 57
+.L_const_4:
+    .double 1
+.L_const_5:
+    .double 0
+.L_const_7:
+    .double 32
+.L_const_10:
+    .double 9
+.L_const_13:
+    .double 10
+.L_const_16:
+    .double 13
+.L_const_22:
+    .double 40
+.L_const_28:
+    .double 41
+.L_const_36:
+    .double 4
+.L_const_41:
+    .double 5
+    .p2align 3
+    .quad .L_str_49_end - .L_str_49 - 1
+.L_str_49:
+    .asciz "(+ 12 (* 3 4)) "
+.L_str_49_end:
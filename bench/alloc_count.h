@@ -0,0 +1,21 @@
+#ifndef ALLOC_COUNT_H
+#define ALLOC_COUNT_H
+
+// Force-included (-include) into the runtime objects built for
+// bench/runtime_bench.c, so their heap calls go through its counters.
+// Only compiler headers are included here: runtime files set feature
+// macros before their own includes.
+
+#include <stddef.h>
+
+void *bench_malloc(size_t size);
+void *bench_calloc(size_t count, size_t size);
+void *bench_realloc(void *ptr, size_t size);
+void bench_free(void *ptr);
+
+#define malloc bench_malloc
+#define calloc bench_calloc
+#define realloc bench_realloc
+#define free bench_free
+
+#endif
@@ -0,0 +1,208 @@
+#!/usr/bin/env python3
+"""End-to-end benchmarks for cljc.
+
+Compiles every program in bench/programs with --time-report=json and
+--emit=exe. It records the time of each compiler phase, the binary size,
+and the run time over repeated runs. Results are written as JSON and
+compared against a stored baseline. The script exits 1 when a metric got
+worse than the baseline by more than the threshold.
+
+No baseline is committed, because timings only compare on one machine.
+Until --update-baseline stores one at --baseline, the comparison is
+skipped and the script exits 0; --require-baseline makes that an error
+instead, for CI.
+
+    python3 bench/bench.py                    # run and compare
+    python3 bench/bench.py --update-baseline  # run and store as baseline
+    python3 bench/bench.py fib strings        # only some programs
+    python3 bench/bench.py --require-baseline # fail if nothing to compare
+"""
+
+import argparse
+import json
+import os
+import platform
+import subprocess
+import sys
+import time
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+PROGRAMS = os.path.join(ROOT, "bench", "programs")
+
+# Metrics compared against the baseline, all lower-is-better. Times also
+# need to grow by --min-ms, so sub-millisecond jitter is not a regression.
+METRICS = [
+    ("run_ms", True, lambda r: r["run_ms"]["median"]),
+    ("compile_ms", True, lambda r: r["compile_ms"]["median"]),
+    ("binary_bytes", False, lambda r: r["binary_bytes"]),
+]
+
+
+def percentile(samples, p):
+    """Nearest-rank percentile of a non-empty list"""
+    ordered = sorted(samples)
+    rank = max(1, -(-len(ordered) * p // 100))
+    return ordered[int(rank) - 1]
+
+
+def summarize(samples):
+    return {
+        "median": percentile(samples, 50),
+        "p95": percentile(samples, 95),
+        "min": min(samples),
+        "runs": len(samples),
+    }
+
+
+def read_source(path):
+    # The tokenizer has no comment syntax, so full-line ;; comments go here
+    with open(path) as f:
+        lines = [line for line in f if not line.lstrip().startswith(";")]
+    return "".join(lines).strip()
+
+
+def compile_program(args, name, source, exe):
+    cmd = [args.compiler, "--time-report=json", "--emit=exe",
+           "--runtime=" + args.runtime, "-o", exe, source]
+    start = time.perf_counter()
+    proc = subprocess.run(cmd, capture_output=True, text=True)
+    elapsed = (time.perf_counter() - start) * 1e3
+    if proc.returncode != 0:
+        sys.exit("%s: compilation failed\n%s" % (name, proc.stderr))
+    report = json.loads(proc.stderr[proc.stderr.index("{"):])
+    return elapsed, report
+
+
+def bench_program(args, name):
+    source = read_source(os.path.join(PROGRAMS, name + ".cljc"))
+    exe = os.path.join(args.work_dir, name)
+
+    compile_samples = []
+    phase_samples = {}
+    for _ in range(args.compile_runs):
+        elapsed, report = compile_program(args, name, source, exe)
+        compile_samples.append(elapsed)
+        for phase in report["phases"]:
+            phase_samples.setdefault(phase["name"], []).append(phase["wall_ms"])
+
+    outputs = set()
+    run_samples = []
+    for i in range(args.warmup + args.runs):
+        start = time.perf_counter()
+        proc = subprocess.run([exe], capture_output=True, text=True)
+        elapsed = (time.perf_counter() - start) * 1e3
+        if proc.returncode != 0:
+            sys.exit("%s: exited with %d\n%s" % (name, proc.returncode, proc.stderr))
+        outputs.add(proc.stdout.strip())
+        if i >= args.warmup:
+            run_samples.append(elapsed)
+    if len(outputs) != 1:
+        sys.exit("%s: output differs between runs" % name)
+
+    return {
+        "compile_ms": summarize(compile_samples),
+        "phases_ms": {phase: percentile(s, 50) for phase, s in phase_samples.items()},
+        "counts": report["counts"],
+        "peak_rss_kb": max(p["peak_rss_kb"] for p in report["phases"]),
+        "binary_bytes": os.path.getsize(exe),
+        "run_ms": summarize(run_samples),
+        "output": outputs.pop(),
+    }
+
+
+def compare(results, baseline, threshold, min_ms):
+    """Prints each metric against the baseline, returns the regressions"""
+    regressions = []
+    print("\n%-12s %-14s %12s %12s %9s" % ("benchmark", "metric", "baseline", "current", "change"))
+    for name, result in sorted(results.items()):
+        base = baseline.get(name)
+        if base is None:
+            print("%-12s (not in baseline)" % name)
+            continue
+        if base["output"] != result["output"]:
+            regressions.append("%s: output changed from %s to %s" %
+                               (name, base["output"], result["output"]))
+        for metric, is_time, get in METRICS:
+            old, new = get(base), get(result)
+            change = (new - old) / old if old else 0.0
+            flag = ""
+            if change > threshold and (not is_time or new - old > min_ms):
+                flag = "  REGRESSION"
+                regressions.append("%s: %s %.3f -> %.3f (%+.1f%%)" %
+                                   (name, metric, old, new, change * 100))
+            print("%-12s %-14s %12.3f %12.3f %+8.1f%%%s" %
+                  (name, metric, old, new, change * 100, flag))
+    return regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description=__doc__.splitlines()[0],
+        epilog="Without a baseline file the comparison is skipped and the exit "
+               "status is 0, unless --require-baseline is given.")
+    parser.add_argument("programs", nargs="*", help="names in bench/programs (default all)")
+    parser.add_argument("--compiler", default=os.path.join(ROOT, "build", "program"))
+    parser.add_argument("--runtime", default=os.path.join(ROOT, "build", "libruntime.a"))
+    parser.add_argument("--runs", type=int, default=10, help="timed runs per program")
+    parser.add_argument("--warmup", type=int, default=2, help="untimed runs first")
+    parser.add_argument("--compile-runs", type=int, default=3)
+    parser.add_argument("--work-dir", default=os.path.join(ROOT, "build", "bench"))
+    parser.add_argument("--output", default=os.path.join(ROOT, "build", "bench", "results.json"))
+    parser.add_argument("--baseline", default=os.path.join(ROOT, "bench", "baseline.json"))
+    parser.add_argument("--threshold", type=float, default=0.10,
+                        help="allowed slowdown as a fraction (default 0.10)")
+    parser.add_argument("--min-ms", type=float, default=0.5,
+                        help="smallest time increase that can be a regression")
+    parser.add_argument("--update-baseline", action="store_true",
+                        help="store the results as the new baseline")
+    parser.add_argument("--require-baseline", action="store_true",
+                        help="exit 1 instead of skipping the comparison when there is no baseline")
+    args = parser.parse_args()
+
+    names = args.programs or sorted(f[:-5] for f in os.listdir(PROGRAMS) if f.endswith(".cljc"))
+    os.makedirs(args.work_dir, exist_ok=True)
+
+    results = {}
+    for name in names:
+        print("%-12s" % name, end="", flush=True)
+        result = bench_program(args, name)
+        results[name] = result
+        print(" run %8.3f ms (p95 %8.3f)  compile %7.3f ms  %8d bytes" %
+              (result["run_ms"]["median"], result["run_ms"]["p95"],
+               result["compile_ms"]["median"], result["binary_bytes"]))
+
+    document = {
+        "machine": {"system": platform.system(), "machine": platform.machine(),
+                    "node": platform.node()},
+        "time": time.strftime("%Y-%m-%dT%H:%M:%S"),
+        "benchmarks": results,
+    }
+    os.makedirs(os.path.dirname(args.output), exist_ok=True)
+    with open(args.output, "w") as f:
+        json.dump(document, f, indent=2, sort_keys=True)
+    print("Results written to %s" % args.output)
+
+    if args.update_baseline:
+        with open(args.baseline, "w") as f:
+            json.dump(document, f, indent=2, sort_keys=True)
+        print("Baseline written to %s" % args.baseline)
+        return 0
+
+    if not os.path.exists(args.baseline):
+        print("No baseline at %s, comparison skipped; run with --update-baseline "
+              "to store one" % args.baseline)
+        return 1 if args.require_baseline else 0
+
+    with open(args.baseline) as f:
+        baseline = json.load(f)["benchmarks"]
+    regressions = compare(results, baseline, args.threshold, args.min_ms)
+    if regressions:
+        print("\n%d regression(s) over %.0f%%:" % (len(regressions), args.threshold * 100))
+        for regression in regressions:
+            print("  " + regression)
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,141 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Synthetic cljc programs for compiler scalability tests.
+//
+// Prints a program of `functions` one-argument defns f0 ... fN-1 that form
+// a call DAG: fi calls up to `fanout` of the functions after it, so there
+// is no recursion and every function is reachable from f0. Each body is a
+// chain of `lets` nested single-binding lets around an arithmetic
+// expression `depth` levels deep, with `constants` distinct float and
+// string literals spread over all bodies. main calls f0 on a value only
+// known at runtime, so partial evaluation cannot fold the program away.
+//
+//   build/gen --functions 1000 --fanout 3 --depth 20 | build/program --emit=asm -o /dev/null -
+
+typedef struct GenOptions {
+    long functions;
+    long fanout;
+    long depth;
+    long constants;
+    long lets;
+} GenOptions;
+
+static void usage(const char *program) {
+    fprintf(stderr, "Usage: %s [--functions N] [--fanout F] [--depth D] [--constants M] [--lets L]\n", program);
+}
+
+static void parse_options(int argc, char *argv[], GenOptions *opts) {
+    opts->functions = 100;
+    opts->fanout = 2;
+    opts->depth = 8;
+    opts->constants = 100;
+    opts->lets = 4;
+
+    for (int i = 1; i < argc; i++) {
+        long *target = NULL;
+        if (strcmp(argv[i], "--functions") == 0) {
+            target = &opts->functions;
+        } else if (strcmp(argv[i], "--fanout") == 0) {
+            target = &opts->fanout;
+        } else if (strcmp(argv[i], "--depth") == 0) {
+            target = &opts->depth;
+        } else if (strcmp(argv[i], "--constants") == 0) {
+            target = &opts->constants;
+        } else if (strcmp(argv[i], "--lets") == 0) {
+            target = &opts->lets;
+        }
+        if (!target || i + 1 == argc || atol(argv[i + 1]) < 0) {
+            usage(argv[0]);
+            exit(1);
+        }
+        *target = atol(argv[++i]);
+    }
+
+    if (opts->functions < 1) {
+        fprintf(stderr, "Error: --functions must be at least 1\n");
+        exit(1);
+    }
+}
+
+// Constant k alternates between a float and a string literal
+static void print_constant(long k) {
+    if (k % 2 == 0) {
+        printf("%ld.5", k);
+    } else {
+        printf("(str-length \"c%ld\")", k);
+    }
+}
+
+// One leaf of the expression chain at `level`: a call to a later function
+// while fanout lasts, then the function's share of constants, then the
+// innermost let name
+static void print_leaf(GenOptions *opts, long fn, long level, long *next_constant, long last_constant,
+                       const char *local) {
+    long callee = fn + 1 + level;
+    if (level < opts->fanout && callee < opts->functions) {
+        printf("(f%ld %s)", callee, local);
+    } else if (*next_constant < last_constant) {
+        print_constant((*next_constant)++);
+    } else {
+        printf("%s", local);
+    }
+}
+
+static void print_function(GenOptions *opts, long fn) {
+    // Constants [first, last) belong to this function
+    long first_constant = opts->constants * fn / opts->functions;
+    long last_constant = opts->constants * (fn + 1) / opts->functions;
+    long next_constant = first_constant;
+    char local[32] = "x";
+
+    printf("(defn f%ld [x]\n", fn);
+    for (long i = 0; i < opts->lets; i++) {
+        printf("  (let [a%ld (+ %s %ld)]\n", i, local, i + 1);
+        snprintf(local, sizeof(local), "a%ld", i);
+    }
+
+    // Constants the chain has no room for are extra arguments of a +
+    long calls = opts->functions - 1 - fn;
+    calls = calls < opts->fanout ? calls : opts->fanout;
+    calls = calls < opts->depth ? calls : opts->depth;
+    long extra = (last_constant - first_constant) - (opts->depth - calls);
+
+    // (+ (* (+ ... leaf) leaf) leaf), alternating + and *
+    printf("    ");
+    if (extra > 0) {
+        printf("(+ ");
+    }
+    for (long level = opts->depth - 1; level >= 0; level--) {
+        printf("(%s ", level % 2 ? "*" : "+");
+    }
+    printf("%s", local);
+    for (long level = 0; level < opts->depth; level++) {
+        printf(" ");
+        print_leaf(opts, fn, level, &next_constant, last_constant, local);
+        printf(")");
+    }
+    if (extra > 0) {
+        while (next_constant < last_constant) {
+            printf("\n      ");
+            print_constant(next_constant++);
+        }
+        printf(")");
+    }
+    for (long i = 0; i < opts->lets; i++) {
+        printf(")");
+    }
+    printf(")\n\n");
+}
+
+int main(int argc, char *argv[]) {
+    GenOptions opts;
+    parse_options(argc, argv, &opts);
+
+    for (long fn = 0; fn < opts.functions; fn++) {
+        print_function(&opts, fn);
+    }
+    printf("(f0 (list-count (list 1 2)))\n");
+    return 0;
+}
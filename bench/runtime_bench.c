@@ -0,0 +1,304 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+#include "runtime.h"
+
+// Microbenchmarks for the runtime's list and string builtins.
+//
+// Every benchmark runs one operation on an input of a given size. The
+// iteration count is doubled until a batch takes --min-time, which also
+// warms caches and the allocator, then SAMPLES batches are timed and the
+// median reported. Ticks are TSC reference cycles on x86-64 and generic
+// timer ticks on arm64, where the cycle counter is not readable from user
+// space. Allocations are counted by linking against runtime objects built
+// with bench/alloc_count.h (see the bench-runtime target in the Makefile).
+//
+// "shared" inputs are referenced elsewhere, so updates copy them; "unique"
+// ones are updated in place, see copy-on-write in runtime.h.
+
+#define SAMPLES 5
+#define MAX_SAMPLES 16
+
+// Builtins called by compiled code, which has no header for them
+Value cons(Value elem, Value lst);
+Value rest(Value lst);
+Value str_concat(Value s1, Value s2);
+Value substring(Value s, double start, double end);
+double str_char_at(Value s, double index);
+
+// Allocation counters behind bench/alloc_count.h
+
+static long alloc_calls = 0;
+static long alloc_bytes = 0;
+
+void *bench_malloc(size_t size) {
+    alloc_calls++;
+    alloc_bytes += (long)size;
+    return malloc(size);
+}
+
+void *bench_calloc(size_t count, size_t size) {
+    alloc_calls++;
+    alloc_bytes += (long)(count * size);
+    return calloc(count, size);
+}
+
+void *bench_realloc(void *ptr, size_t size) {
+    alloc_calls++;
+    alloc_bytes += (long)size;
+    return realloc(ptr, size);
+}
+
+void bench_free(void *ptr) {
+    free(ptr);
+}
+
+static inline uint64_t read_ticks(void) {
+#if defined(__x86_64__)
+    return __rdtsc();
+#elif defined(__aarch64__)
+    uint64_t ticks;
+    __asm__ volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+    return ticks;
+#else
+    return 0;
+#endif
+}
+
+static inline uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+typedef struct BenchState {
+    long size;
+    Value input;  // Shared
+    Value work;   // Unique, updated by the operation
+    long index;
+    double sink;
+} BenchState;
+
+typedef struct Bench {
+    const char *name;
+    int string_input;
+    void (*run)(BenchState *state);
+} Bench;
+
+static void free_list(Value v) {
+    RuntimeList *list = rt_as_list(v);
+    free(list->elements);
+    free(list);
+}
+
+static void free_string(Value v) {
+    free((char *)value_as_pointer(v) - offsetof(RuntimeString, chars));
+}
+
+static Value make_list(long size) {
+    Value v = create_list();
+    for (long i = 0; i < size; i++) {
+        v = append_elem(v, value_from_double((double)i));
+    }
+    return v;
+}
+
+static Value make_string(long size) {
+    char *chars = rt_alloc_string((size_t)size);
+    for (long i = 0; i < size; i++) {
+        chars[i] = (char)('a' + i % 26);
+    }
+    return value_box(VALUE_TAG_STRING, chars);
+}
+
+static void run_cons_shared(BenchState *s) {
+    free_list(cons(value_from_double(1.0), s->input));
+}
+
+static void run_cons_rest_unique(BenchState *s) {
+    s->work = rest(cons(value_from_double(1.0), s->work));
+}
+
+static void run_rest_shared(BenchState *s) {
+    free_list(rest(s->input));
+}
+
+static void run_append_shared(BenchState *s) {
+    free_list(append_elem(s->input, value_from_double(1.0)));
+}
+
+static void run_append_unique(BenchState *s) {
+    s->work = append_elem(s->work, value_from_double(1.0));
+    rt_as_list(s->work)->count--;
+}
+
+static void run_str_concat(BenchState *s) {
+    free_string(str_concat(s->input, s->input));
+}
+
+static void run_substring(BenchState *s) {
+    free_string(substring(s->input, 1, (double)(s->size - 1)));
+}
+
+static void run_str_char_at(BenchState *s) {
+    s->sink += str_char_at(s->input, (double)s->index);
+    s->index = (s->index + 7) % s->size;
+}
+
+static const Bench benches[] = {
+    { "cons/shared", 0, run_cons_shared },
+    { "cons+rest/unique", 0, run_cons_rest_unique },
+    { "rest/shared", 0, run_rest_shared },
+    { "append_elem/shared", 0, run_append_shared },
+    { "append_elem/unique", 0, run_append_unique },
+    { "str_concat", 1, run_str_concat },
+    { "substring", 1, run_substring },
+    { "str_char_at", 1, run_str_char_at },
+};
+
+static const long sizes[] = { 16, 256, 4096 };
+
+typedef struct BenchResult {
+    long iterations;
+    double ns_per_op;
+    double ticks_per_op;
+    double allocs_per_op;
+    double bytes_per_op;
+} BenchResult;
+
+static void setup(const Bench *bench, BenchState *state, long size) {
+    state->size = size;
+    state->index = 0;
+    state->sink = 0;
+    if (bench->string_input) {
+        state->input = make_string(size);
+        state->work = state->input;
+    } else {
+        state->input = make_list(size);
+        rt_share(state->input);
+        state->work = make_list(size);
+    }
+}
+
+static void teardown(const Bench *bench, BenchState *state) {
+    if (bench->string_input) {
+        free_string(state->input);
+    } else {
+        free_list(state->input);
+        free_list(state->work);
+    }
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static BenchResult measure(const Bench *bench, long size, uint64_t min_ns) {
+    BenchState state;
+    setup(bench, &state, size);
+
+    // Calibrate: double the batch until it runs for min_ns
+    long iterations = 1;
+    for (;;) {
+        uint64_t start = now_ns();
+        for (long i = 0; i < iterations; i++) {
+            bench->run(&state);
+        }
+        if (now_ns() - start >= min_ns) {
+            break;
+        }
+        iterations *= 2;
+    }
+
+    double ns[MAX_SAMPLES];
+    double ticks[MAX_SAMPLES];
+    long calls_before = alloc_calls;
+    long bytes_before = alloc_bytes;
+    for (int s = 0; s < SAMPLES; s++) {
+        uint64_t start = now_ns();
+        uint64_t start_ticks = read_ticks();
+        for (long i = 0; i < iterations; i++) {
+            bench->run(&state);
+        }
+        ticks[s] = (double)(read_ticks() - start_ticks) / iterations;
+        ns[s] = (double)(now_ns() - start) / iterations;
+    }
+    long total = iterations * SAMPLES;
+
+    BenchResult result;
+    result.iterations = iterations;
+    qsort(ns, SAMPLES, sizeof(double), compare_doubles);
+    qsort(ticks, SAMPLES, sizeof(double), compare_doubles);
+    result.ns_per_op = ns[SAMPLES / 2];
+    result.ticks_per_op = ticks[SAMPLES / 2];
+    result.allocs_per_op = (double)(alloc_calls - calls_before) / total;
+    result.bytes_per_op = (double)(alloc_bytes - bytes_before) / total;
+
+    if (state.sink < 0) {
+        printf("%f\n", state.sink);
+    }
+    teardown(bench, &state);
+    return result;
+}
+
+int main(int argc, char *argv[]) {
+    int json = 0;
+    const char *filter = NULL;
+    uint64_t min_ns = 20 * 1000000ULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--json") == 0) {
+            json = 1;
+        } else if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+            min_ns = (uint64_t)(atof(argv[++i]) * 1e6);
+        } else if (argv[i][0] != '-' && !filter) {
+            filter = argv[i];
+        } else {
+            fprintf(stderr, "Usage: %s [--json] [--min-time <ms>] [name-filter]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (json) {
+        printf("[");
+    } else {
+        printf("%-20s %6s %12s %12s %10s %10s %12s\n",
+               "benchmark", "size", "ns/op", "ticks/op", "allocs/op", "bytes/op", "iterations");
+    }
+
+    int first = 1;
+    for (size_t b = 0; b < sizeof(benches) / sizeof(benches[0]); b++) {
+        if (filter && !strstr(benches[b].name, filter)) {
+            continue;
+        }
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+            BenchResult r = measure(&benches[b], sizes[s], min_ns);
+            if (json) {
+                printf("%s\n  {\"name\": \"%s\", \"size\": %ld, \"ns_per_op\": %.3f, "
+                       "\"ticks_per_op\": %.3f, \"allocs_per_op\": %.3f, \"bytes_per_op\": %.1f, "
+                       "\"iterations\": %ld}",
+                       first ? "" : ",", benches[b].name, sizes[s], r.ns_per_op,
+                       r.ticks_per_op, r.allocs_per_op, r.bytes_per_op, r.iterations);
+            } else {
+                printf("%-20s %6ld %12.2f %12.2f %10.2f %10.1f %12ld\n",
+                       benches[b].name, sizes[s], r.ns_per_op, r.ticks_per_op,
+                       r.allocs_per_op, r.bytes_per_op, r.iterations);
+            }
+            fflush(stdout);
+            first = 0;
+        }
+    }
+    if (json) {
+        printf("\n]\n");
+    }
+    return 0;
+}
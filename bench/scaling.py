@@ -0,0 +1,136 @@
+#!/usr/bin/env python3
+"""Compiler scalability curves.
+
+Generates programs with build/gen (bench/gen.c) at increasing sizes along
+one dimension and compiles each one to assembly. It reports compile time,
+heap allocated and peak RSS against size. The growth exponent between
+consecutive sizes shows how a phase scales: about 1 is linear, about 2 is
+quadratic.
+
+    python3 bench/scaling.py                        # every dimension
+    python3 bench/scaling.py functions --sizes 250,500,1000,2000
+    python3 bench/scaling.py constants --fixed depth=4
+"""
+
+import argparse
+import json
+import math
+import os
+import subprocess
+import sys
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+# Size steps per dimension; the others keep the generator defaults
+# unless set with --fixed. Calls are leaves of the depth chain, so fanout
+# stops growing at depth.
+DIMENSIONS = {
+    "functions": [125, 250, 500, 1000, 2000],
+    "depth": [16, 32, 64, 128, 256],
+    "constants": [500, 1000, 2000, 4000, 8000],
+    "lets": [8, 16, 32, 64, 128],
+    "fanout": [1, 2, 4, 8],
+}
+
+
+def generate(args, dimension, size):
+    options = dict(args.fixed)
+    options[dimension] = size
+    cmd = [args.gen]
+    for name, value in sorted(options.items()):
+        cmd += ["--" + name, str(value)]
+    return subprocess.run(cmd, capture_output=True, text=True, check=True).stdout
+
+
+def compile_once(args, source):
+    cmd = [args.compiler, "--time-report=json", "--emit=asm", "-o", os.devnull, "-"]
+    proc = subprocess.run(cmd, input=source, capture_output=True, text=True)
+    if proc.returncode != 0:
+        sys.exit("compilation failed\n%s" % proc.stderr)
+    return json.loads(proc.stderr[proc.stderr.index("{"):])
+
+
+def measure(args, dimension, size):
+    source = generate(args, dimension, size)
+    reports = [compile_once(args, source) for _ in range(args.repeat)]
+    totals = [sum(p["wall_ms"] for p in r["phases"]) for r in reports]
+    # The median run stands for this size
+    report = reports[sorted(range(len(totals)), key=totals.__getitem__)[len(totals) // 2]]
+    phases = {p["name"]: p["wall_ms"] for p in report["phases"]}
+    return {
+        "size": size,
+        "source_bytes": len(source),
+        "total_ms": sum(phases.values()),
+        "phases_ms": phases,
+        "heap_bytes": sum(p["bytes"] or 0 for p in report["phases"]),
+        "peak_rss_kb": max(p["peak_rss_kb"] for p in report["phases"]),
+        "counts": report["counts"],
+    }
+
+
+def exponent(prev, cur, key):
+    """Local growth exponent of prev[key] -> cur[key] against size"""
+    if prev[key] <= 0 or cur[key] <= 0 or prev["size"] == cur["size"]:
+        return None
+    return math.log(cur[key] / prev[key]) / math.log(cur["size"] / prev["size"])
+
+
+def report_dimension(dimension, rows):
+    print("\n%s" % dimension)
+    print("%8s %10s %10s %6s %12s %10s  %s" %
+          ("size", "bytes", "total ms", "exp", "heap bytes", "rss KB", "slowest phase (exp)"))
+    for i, row in enumerate(rows):
+        prev = rows[i - 1] if i else None
+        growth = exponent(prev, row, "total_ms") if prev else None
+        slowest = max(row["phases_ms"], key=row["phases_ms"].get)
+        slowest_growth = None
+        if prev and prev["phases_ms"].get(slowest, 0) > 0:
+            slowest_growth = exponent({"size": prev["size"], "t": prev["phases_ms"][slowest]},
+                                      {"size": row["size"], "t": row["phases_ms"][slowest]}, "t")
+        print("%8d %10d %10.3f %6s %12d %10d  %s %.3f ms%s" %
+              (row["size"], row["source_bytes"], row["total_ms"],
+               "%.2f" % growth if growth is not None else "-",
+               row["heap_bytes"], row["peak_rss_kb"], slowest, row["phases_ms"][slowest],
+               " (%.2f)" % slowest_growth if slowest_growth is not None else ""))
+
+
+def parse_fixed(items):
+    fixed = {}
+    for item in items:
+        name, _, value = item.partition("=")
+        if name not in DIMENSIONS or not value.isdigit():
+            sys.exit("--fixed takes <dimension>=<count>, e.g. depth=8")
+        fixed[name] = int(value)
+    return fixed
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("dimensions", nargs="*", choices=[[]] + sorted(DIMENSIONS),
+                        help="what to grow (default all)")
+    parser.add_argument("--sizes", help="comma-separated sizes instead of the defaults")
+    parser.add_argument("--fixed", action="append", default=[],
+                        help="hold another dimension at a value, e.g. depth=8")
+    parser.add_argument("--repeat", type=int, default=3, help="compiles per size")
+    parser.add_argument("--compiler", default=os.path.join(ROOT, "build", "program"))
+    parser.add_argument("--gen", default=os.path.join(ROOT, "build", "gen"))
+    parser.add_argument("--output", default=os.path.join(ROOT, "build", "bench", "scaling.json"))
+    args = parser.parse_args()
+    args.fixed = parse_fixed(args.fixed)
+
+    results = {}
+    for dimension in args.dimensions or sorted(DIMENSIONS):
+        sizes = [int(s) for s in args.sizes.split(",")] if args.sizes else DIMENSIONS[dimension]
+        rows = [measure(args, dimension, size) for size in sizes]
+        results[dimension] = rows
+        report_dimension(dimension, rows)
+
+    os.makedirs(os.path.dirname(args.output), exist_ok=True)
+    with open(args.output, "w") as f:
+        json.dump({"fixed": args.fixed, "dimensions": results}, f, indent=2, sort_keys=True)
+    print("\nResults written to %s" % args.output)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -7,11 +7,17 @@ void emit_header(FILE *f);
 void emit_data_section_start(FILE *f);
 void emit_text_section_start(FILE *f);
 void emit_function_start(FILE *f, const char *name);
+void emit_function_end(FILE *f);
 void emit_function_prologue(FILE *f);
+void emit_function_prologue_above(FILE *f, int extra);
 void emit_function_epilogue(FILE *f);
 void emit_load_double_literal(FILE *f, const char *label);
 void emit_push_double(FILE *f, int dreg);
 void emit_pop_double(FILE *f, int dreg);
+void emit_push_value(FILE *f, int xreg);
+void emit_pop_value(FILE *f, int xreg);
+void emit_box_pointer(FILE *f, int xreg, unsigned tag);
+void emit_load_imm32(FILE *f, int wreg, unsigned value);
 void emit_fadd(FILE *f);
 void emit_fsub(FILE *f);
 void emit_fmul(FILE *f);
@@ -19,8 +25,17 @@ void emit_fdiv(FILE *f);
 void emit_call(FILE *f, const char *label);
 void emit_return(FILE *f);
 void emit_comment(FILE *f, const char *comment);
+void emit_debug_file(FILE *f, const char *dir, const char *name);
+void emit_loc(FILE *f, int line, int column);
+void emit_debug_info(FILE *f, const char *dir, const char *name);
 void emit_float_constant(FILE *f, const char *label, double value);
 void emit_string_constant(FILE *f, const char *label, const char *value);
+void emit_memo_cache(FILE *f, const char *label, long max_entries, int evict);
+void emit_keyword_constant(FILE *f, const char *label, const char *name, unsigned hash);
+void emit_function_descriptor(FILE *f, const char *label, const char *code_label, int arity);
+void emit_call_counter(FILE *f, const char *label, const char *name);
+void emit_branch_counter(FILE *f, const char *label);
+void emit_increment_counter(FILE *f, const char *label);
 void emit_fcmp(FILE *f);
 void emit_label(FILE *f, const char *label);
 void emit_branch(FILE *f, const char *label);
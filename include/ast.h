@@ -1,33 +1,48 @@
 #ifndef AST_H
 #define AST_H
 
+#include <stdio.h>
+
 typedef enum {
     AST_NUMBER,
     AST_SYMBOL,
     AST_LIST,
-    AST_STRING
+    AST_STRING,
+    AST_KEYWORD,
+    AST_MAP
 } ASTNodeType;
 
 typedef struct ASTNode {
     ASTNodeType type;
+    int scratch;   // AST_LIST literal proven not to escape, see src/escape.c
+    int last_use;  // AST_SYMBOL not read again, see src/uniqueness.c
+    int consumed;  // AST_SYMBOL read where its value cannot escape, ditto
+    int cse_slot;  // Frame slot holding this value, or -1, see src/cse.c
+    int cse_reuse; // Load cse_slot instead of evaluating
+    int line;      // Source position of the form's first token, 0 for
+    int column;    // nodes the compiler made
     union {
         char *symbol;
         double number;
         char *string;
+        char *keyword;  // Name without the leading colon
         struct {
             struct ASTNode **elements;
             int count;
             int capacity;
-        } list;
+        } list;  // Also holds the alternating keys/values of AST_MAP
     } as;
 } ASTNode;
 
 ASTNode *create_number_node(double value);
 ASTNode *create_symbol_node(const char *symbol);
 ASTNode *create_string_node(const char *string);
+ASTNode *create_keyword_node(const char *name);
 ASTNode *create_list_node(void);
+ASTNode *create_map_node(void);
 void add_to_list(ASTNode *list, ASTNode *element);
+ASTNode *copy_ast(ASTNode *node);
 void free_ast(ASTNode *node);
-void print_ast(ASTNode *node, int indent);
+void print_ast(FILE *f, ASTNode *node, int indent);
 
 #endif
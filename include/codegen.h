@@ -2,8 +2,10 @@
 #define CODEGEN_H
 
 #include "ast.h"
+#include "profile.h"
 #include "symbol_table.h"
 #include <stdio.h>
+#include <stdint.h>
 
 typedef struct FloatConstant {
     double value;
@@ -15,27 +17,68 @@ typedef struct StringConstant {
     char *label;
 } StringConstant;
 
+typedef struct KeywordConstant {
+    char *name;
+    char *label;
+    uint32_t hash;
+} KeywordConstant;
+
+// Then/else counters of an if, for --profile-generate
+typedef struct BranchCounter {
+    int line;
+    int column;
+    char *label;
+} BranchCounter;
+
 typedef struct Variable {
     char *name;
     double value;
     char *label;
+    ASTNode *init;  // Evaluated by main when the value is not a literal
 } Variable;
 
+// Compiler flags that change the generated code
+typedef struct CodegenOptions {
+    int stats;  // --stats: count defn calls, report runtime stats at exit
+    int perf_counters;  // --perf-counters: hardware counters per top-level form
+    int debug_info;  // -g: .loc line table and a DWARF unit for the source
+    const char *source_name;  // File name the line table refers to
+    const char *source_dir;
+    const char *profile_generate;  // Profile path the program writes at exit, or NULL
+    const Profile *profile;        // --profile-use, or NULL
+} CodegenOptions;
+
 typedef struct CodeGen {
     FILE *output;
+    const CodegenOptions *options;
     SymbolTable *symbols;
     int label_counter;
+    int functions_emitted;
+    int cse_offset;  // [x29, #cse_offset] is the current function's CSE slot 0
+    int loc_line;    // Source position of the last .loc, with -g
+    int loc_column;
+    FILE *cold_output;  // Code moved after the current function's return
+    char *cold_text;
+    size_t cold_length;
     FloatConstant **float_constants;
     int float_count;
     int float_capacity;
     StringConstant **string_constants;
     int string_count;
     int string_capacity;
+    KeywordConstant **keyword_constants;
+    int keyword_count;
+    int keyword_capacity;
     Variable **variables;
     int var_count;
     int var_capacity;
+    BranchCounter **branch_counters;
+    int branch_count;
+    int branch_capacity;
 } CodeGen;
 
-void generate_asm(ASTNode *ast, const char *output_file);
+// Writes the program's assembly to `output`, which the caller closes
+void generate_asm(ASTNode *ast, FILE *output, const CodegenOptions *options);
+int is_builtin(const char *symbol);
 
 #endif
@@ -0,0 +1,13 @@
+#ifndef CSE_H
+#define CSE_H
+
+#include "ast.h"
+#include "symbol_table.h"
+
+// Finds pure subexpressions of a function body that are computed again
+// after an earlier, always-evaluated copy. The first copy gets a frame
+// slot in `cse_slot` to store its value in, the later ones `cse_reuse`
+// to load it instead. Returns how many slots the body needs.
+int cse_analyze(ASTNode *body, char **params, int param_count, SymbolTable *symbols);
+
+#endif
@@ -0,0 +1,11 @@
+#ifndef ESCAPE_H
+#define ESCAPE_H
+
+#include "ast.h"
+
+// Marks the (list ...) and (vector ...) literals in a function body whose
+// value provably never outlives the call, setting their `scratch` flag.
+// Returns how many were marked.
+int escape_analyze(ASTNode *body);
+
+#endif
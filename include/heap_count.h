@@ -0,0 +1,22 @@
+#ifndef HEAP_COUNT_H
+#define HEAP_COUNT_H
+
+// Force-included (-include) into the compiler's objects by the Makefile,
+// so their heap calls go through the per-phase counters of --time-report
+// (src/time_report.c), the same way bench/alloc_count.h counts the
+// runtime's. Only compiler headers are included here: source files set
+// feature macros before their own includes.
+
+#include <stddef.h>
+
+void *counted_malloc(size_t size);
+void *counted_calloc(size_t count, size_t size);
+void *counted_realloc(void *ptr, size_t size);
+char *counted_strdup(const char *s);
+
+#define malloc counted_malloc
+#define calloc counted_calloc
+#define realloc counted_realloc
+#define strdup counted_strdup
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef INLINE_H
+#define INLINE_H
+
+#include "ast.h"
+#include "profile.h"
+#include "symbol_table.h"
+
+// Replaces calls to small functions that `profile` shows are hot by a copy
+// of the callee's body with the arguments substituted for its parameters.
+// Calls in an if arm the profile never saw taken are left alone. Returns
+// how many calls were inlined.
+int inline_hot_calls(SymbolTable *symbols, ASTNode *ast, const Profile *profile);
+
+#endif
@@ -0,0 +1,13 @@
+#ifndef PARTIAL_EVAL_H
+#define PARTIAL_EVAL_H
+
+#include "ast.h"
+#include "symbol_table.h"
+
+// Sets `pure` on the functions in `symbols`, then replaces every call in
+// the program whose value is known at compile time -- arithmetic and
+// comparisons on number literals, and pure function calls with literal
+// arguments -- by the number it returns. Returns how many were replaced.
+int partial_eval(SymbolTable *symbols, ASTNode *ast);
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+// Execution profile written by a program compiled with --profile-generate
+// (runtime/profile.c) and read back by --profile-use. Text, one record per
+// line after a "cljc-profile 1" header:
+//
+//   function <name> <calls>
+//   branch <line>:<column> <then-count> <else-count>
+//
+// Branches are keyed by the source position of their `if`, so a profile
+// stays valid for an unchanged source whatever else the flags change.
+
+typedef struct ProfileFunction {
+    char *name;
+    long calls;
+} ProfileFunction;
+
+typedef struct ProfileBranch {
+    int line;
+    int column;
+    long then_count;
+    long else_count;
+} ProfileBranch;
+
+typedef struct Profile {
+    ProfileFunction *functions;
+    int function_count;
+    int function_capacity;
+    ProfileBranch *branches;
+    int branch_count;
+    int branch_capacity;
+    long max_calls;  // Of the hottest function
+} Profile;
+
+// Exits with an error if the file cannot be read or is not a profile.
+// Records seen twice, e.g. for an inlined if, are added up.
+Profile *load_profile(const char *path);
+long profile_calls(const Profile *profile, const char *name);
+const ProfileBranch *profile_branch(const Profile *profile, int line, int column);
+void free_profile(Profile *profile);
+
+#endif
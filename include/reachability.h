@@ -0,0 +1,12 @@
+#ifndef REACHABILITY_H
+#define REACHABILITY_H
+
+#include "ast.h"
+#include "symbol_table.h"
+
+// Sets `reachable` on the functions in `symbols` that the program's
+// top-level expressions and def values can call, directly or through
+// other functions. Returns how many functions are unreachable.
+int mark_reachable(SymbolTable *symbols, ASTNode *ast);
+
+#endif
@@ -0,0 +1,332 @@
+#ifndef RUNTIME_H
+#define RUNTIME_H
+
+#include <pthread.h>
+#include <stdio.h>
+#include "value.h"
+
+// Shared between the runtime translation units. Generated code only sees
+// the exported builtins below, called with NaN-boxed values in x registers.
+
+// Lists are updated in place while `shared` is clear, see rt_share
+typedef struct RuntimeList {
+    Value *elements;
+    int count;
+    int capacity;
+    int shared;
+} RuntimeList;
+
+// Strings are NUL-terminated and carry their length in the word before
+// the first character, so compiled code can index and measure them
+// without scanning. A string value points at `chars`; literals get the
+// same layout from emit_string_constant.
+typedef struct RuntimeString {
+    int64_t length;
+    char chars[];
+} RuntimeString;
+
+// Keywords are emitted by the compiler into the data section, one record
+// per distinct keyword, so equal keywords are always the same pointer.
+typedef struct RuntimeKeyword {
+    uint64_t hash;
+    char name[];
+} RuntimeKeyword;
+
+typedef struct HamtNode HamtNode;
+
+typedef struct RuntimeMap {
+    HamtNode *root;
+    int count;
+} RuntimeMap;
+
+typedef struct RuntimeObject {
+    uint64_t type;
+} RuntimeObject;
+
+// Emitted by the compiler for every defn that is used as a value. `code`
+// takes its arguments in d0-d7 and returns in d0.
+typedef struct RuntimeFunction {
+    RuntimeObject header;
+    void *code;
+    uint64_t arity;
+} RuntimeFunction;
+
+// Lazy sequences realize LAZY_CHUNK_SIZE elements at a time. Realized
+// chunks are linked so every seq derived by `rest` shares them.
+#define LAZY_CHUNK_SIZE 32
+
+typedef struct LazyChunk LazyChunk;
+typedef struct LazyGen LazyGen;
+
+typedef struct LazySeq {
+    RuntimeObject header;
+    LazyGen *gen;
+    LazyChunk *chunk;  // NULL until forced, or when forced and empty
+    int offset;
+    int forced;
+} LazySeq;
+
+typedef enum {
+    CURSOR_LIST,     // Walking a list or vector
+    CURSOR_CHAIN,    // Walking the realized chunks of a lazy seq
+    CURSOR_PRIVATE,  // Past them, running a private copy of the generator
+    CURSOR_DONE
+} CursorState;
+
+// Streams any sequence span by span. Cursors never realize chunks into a
+// seq, so consuming a pipeline needs one buffer per stage however long it is.
+typedef struct SeqCursor {
+    CursorState state;
+    const Value *values;
+    int count;
+    int pos;
+    LazyChunk *chunk;
+    LazyGen *gen;
+    Value *buffer;
+} SeqCursor;
+
+// Unit of work for the scheduler in runtime/scheduler.c. Embedded at the
+// start of a larger struct that carries the task's arguments.
+typedef struct RtTask RtTask;
+struct RtTask {
+    void (*run)(RtTask *task);
+    _Atomic int done;
+    int detached;  // Never waited on: run may free or respawn the task
+};
+
+typedef struct RuntimeFuture {
+    RuntimeObject header;
+    RtTask task;
+    void *code;
+    int argc;
+    double args[8];
+    Value result;
+} RuntimeFuture;
+
+typedef struct RuntimeAtom {
+    RuntimeObject header;
+    _Atomic Value value;
+} RuntimeAtom;
+
+// LIFO region for collections that never outlive the call that built
+// them, see runtime/scratch.c. One per thread and one per go block.
+typedef struct ScratchBlock ScratchBlock;
+
+typedef struct Scratch {
+    ScratchBlock *block;
+    char *top;
+    ScratchBlock *spare;
+} Scratch;
+
+// Result cache of a defn-memo function, emitted by the compiler in the
+// data section. The table is created on the first call, see runtime/memo.c.
+typedef struct MemoTable MemoTable;
+
+#define MEMO_EVICT_CLOCK 0  // Evict an entry not hit recently
+#define MEMO_EVICT_CLEAR 1  // Empty the whole table
+
+#define MEMO_DEFAULT_MAX_ENTRIES 65536
+
+typedef struct MemoCache {
+    _Atomic(MemoTable *) table;
+    int64_t max_entries;
+    int64_t evict;
+} MemoCache;
+
+// Green thread running a go block, see runtime/fiber.c
+typedef struct RtFiber RtFiber;
+
+extern const RuntimeFunction rt_add_function;
+extern const RuntimeFunction rt_mul_function;
+
+// A collection may be updated in place until a second reference to it
+// can exist. The compiler shares a local's value when the local is read
+// again later; the runtime shares every value it stores into a container
+// (a list, map, atom, future or lazy seq), so values read back out of one
+// are already shared. The flag is only ever set, so racing stores agree.
+static inline void rt_share(Value v) {
+    if (value_has_tag(v, VALUE_TAG_LIST) || value_has_tag(v, VALUE_TAG_VECTOR)) {
+        ((RuntimeList *)value_as_pointer(v))->shared = 1;
+    }
+}
+
+// Opt-in runtime statistics, see runtime/stats.c. Builtins open a scope
+// naming themselves with RT_STATS_SCOPE; allocations made inside it are
+// charged to that builtin. When stats are off this is a load and a branch.
+typedef enum {
+    RT_STAT_OTHER,  // Allocations outside any instrumented builtin
+    RT_STAT_CREATE_LIST,
+    RT_STAT_CREATE_VECTOR,
+    RT_STAT_CONS,
+    RT_STAT_FIRST,
+    RT_STAT_REST,
+    RT_STAT_APPEND,
+    RT_STAT_COUNT,
+    RT_STAT_COPY_COLLECTION,
+    RT_STAT_STR_LENGTH,
+    RT_STAT_STR_CHAR_AT,
+    RT_STAT_STR_CONCAT,
+    RT_STAT_SUBSTRING,
+    RT_STAT_MAP_ASSOC,
+    RT_STAT_MAP_DISSOC,
+    RT_STAT_MAP_GET,
+    RT_STAT_BUILTIN_COUNT
+} RtStat;
+
+#define RT_STAT_DISABLED (-1)
+
+// Call counters of the user functions, emitted by the compiler with
+// --stats and handed to rt_stats_start by main
+typedef struct RtDefnCounter {
+    const char *name;
+    int64_t *calls;
+} RtDefnCounter;
+
+typedef struct RtDefnStats {
+    int64_t count;
+    RtDefnCounter counters[];
+} RtDefnStats;
+
+extern int rt_stats_enabled;
+int rt_stats_enter(RtStat stat);
+void rt_stats_restore(int saved);
+void rt_stats_record_alloc(size_t bytes);
+void rt_stats_record_realloc(size_t old_bytes, size_t new_bytes);
+
+static inline void rt_stats_leave(int *saved) {
+    if (*saved != RT_STAT_DISABLED) {
+        rt_stats_restore(*saved);
+    }
+}
+
+#define RT_STATS_SCOPE(stat) \
+    int rt_stats_saved __attribute__((cleanup(rt_stats_leave))) = \
+        rt_stats_enabled ? rt_stats_enter(stat) : RT_STAT_DISABLED
+
+static inline void rt_stats_alloc(size_t bytes) {
+    if (rt_stats_enabled) {
+        rt_stats_record_alloc(bytes);
+    }
+}
+
+// A list buffer growing from old_bytes to new_bytes
+static inline void rt_stats_realloc(size_t old_bytes, size_t new_bytes) {
+    if (rt_stats_enabled) {
+        rt_stats_record_realloc(old_bytes, new_bytes);
+    }
+}
+
+// Internal helpers
+RuntimeFunction *rt_as_function(Value v, const char *builtin);
+Value rt_call1(RuntimeFunction *fn, Value arg);
+Value rt_call2(RuntimeFunction *fn, Value a, Value b);
+int rt_truthy(Value v);
+RuntimeList *rt_alloc_list(int capacity);
+void rt_list_reserve(RuntimeList *list, int extra);
+RuntimeList *rt_as_list(Value v);
+RuntimeMap *rt_as_map(Value v);
+const char *rt_as_string(Value v);
+long rt_string_length(Value v);
+char *rt_alloc_string(size_t length);
+void rt_write_value(FILE *out, Value v);
+uint32_t rt_value_hash(Value v);
+long rt_map_equals(RuntimeMap *a, RuntimeMap *b);
+void rt_write_map(FILE *out, RuntimeMap *map);
+LazySeq *rt_as_lazy_seq(Value v);
+int rt_is_seq(Value v);
+void rt_cursor_init(SeqCursor *cursor, Value coll);
+int rt_cursor_next(SeqCursor *cursor, Value *out);
+int rt_cursor_span(SeqCursor *cursor, const Value **span, int max);
+Value rt_lazy_first(LazySeq *seq);
+Value rt_lazy_rest(LazySeq *seq);
+RuntimeList *rt_realize(Value coll);
+int rt_worker_count(void);
+void rt_spawn(RtTask *task);
+void rt_wait(RtTask *task);
+int rt_help(void);
+RtFiber *rt_current_fiber(void);
+void rt_park(pthread_mutex_t *lock);
+void rt_unpark(RtFiber *fiber);
+Scratch *rt_current_scratch(void);
+void rt_scratch_free(Scratch *scratch);
+Value rt_atom_load(RuntimeAtom *atom);
+
+// Builtins
+long value_equals(Value a, Value b);
+Value create_list(void);
+Value append_elem(Value lst, Value elem);
+Value share_value(Value v);
+Value copy_collection(Value coll);
+Value into_reserve(Value target, Value source);
+
+void *scratch_mark(void);
+void scratch_release(void *mark);
+Value create_list_scratch(long count);
+Value create_vector_scratch(long count);
+
+Value create_map(void);
+Value map_assoc(Value map, Value key, Value val);
+Value map_assoc_hashed(Value map, Value key, Value val, uint32_t hash);
+Value map_dissoc(Value map, Value key);
+Value map_dissoc_hashed(Value map, Value key, uint32_t hash);
+Value map_get(Value map, Value key, Value not_found);
+Value map_get_hashed(Value map, Value key, Value not_found, uint32_t hash);
+double map_contains(Value map, Value key);
+double map_contains_hashed(Value map, Value key, uint32_t hash);
+double count(Value coll);
+
+Value range_seq(long bounded, double start, double end, double step);
+Value iterate_seq(Value fn, Value init);
+Value map_seq(Value fn, Value coll);
+Value filter_seq(Value fn, Value coll);
+Value take_seq(double n, Value coll);
+Value drop_seq(double n, Value coll);
+
+Value pmap(Value fn, Value coll);
+Value preduce(Value fn, Value init, Value coll);
+Value future_spawn(void *code, long argc, double a0, double a1, double a2, double a3,
+                   double a4, double a5, double a6, double a7);
+Value deref(Value ref);
+
+Value atom_new(Value init);
+Value atom_reset(Value ref, Value value);
+Value atom_swap(Value ref, Value fn);
+Value atom_swap_with(Value ref, Value fn, Value arg);
+double atom_add(Value ref, double delta);
+double atom_mul(Value ref, double factor);
+
+void rt_stats_start(const RtDefnStats *defns);
+
+// Counters of a program compiled with --profile-generate, written to
+// `path` (or $CLJC_PROFILE) at exit by runtime/profile.c. counts[0] is how
+// often the if at line:column took its then arm, counts[1] its else arm.
+typedef struct RtBranchCounter {
+    int64_t line;
+    int64_t column;
+    int64_t *counts;
+} RtBranchCounter;
+
+typedef struct RtProfile {
+    const char *path;
+    const RtDefnStats *functions;
+    int64_t branch_count;
+    RtBranchCounter branches[];
+} RtProfile;
+
+void rt_profile_start(const RtProfile *profile);
+
+// Counter scopes around top-level forms, see runtime/perf.c
+void perf_scope_begin(long index, const char *label);
+void perf_scope_end(long index);
+
+long memo_lookup(MemoCache *cache, const Value *frame, long argc, Value *out);
+double memo_store(MemoCache *cache, const Value *frame, long argc, double result);
+
+Value chan_new(double capacity);
+double chan_send(Value ref, Value value);
+Value chan_recv(Value ref, Value not_found);
+Value chan_close(Value ref);
+Value go_spawn(void *code, long argc, double a0, double a1, double a2, double a3,
+               double a4, double a5, double a6, double a7);
+
+#endif
@@ -9,6 +9,12 @@ typedef struct FunctionInfo {
     char **param_names;
     ASTNode *body;
     char *label;
+    int used_as_value;  // Needs a static descriptor in the data section
+    int pure;           // Arithmetic only, can run in the compiler (src/partial_eval.c)
+    int memo;           // defn-memo: results cached in a MemoCache (runtime/memo.c)
+    long memo_max_entries;
+    int memo_evict;
+    int reachable;      // Called from the program, see src/reachability.c
 } FunctionInfo;
 
 typedef struct SymbolTable {
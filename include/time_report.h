@@ -0,0 +1,29 @@
+#ifndef TIME_REPORT_H
+#define TIME_REPORT_H
+
+#include <stdio.h>
+
+// Per-phase compile statistics for --time-report. Everything here is a
+// no-op until time_report_enable is called.
+
+typedef enum {
+    TIME_REPORT_TABLE,
+    TIME_REPORT_JSON
+} TimeReportFormat;
+
+void time_report_enable(void);
+int time_report_enabled(void);
+
+// Phases may be entered more than once; their numbers add up
+void phase_begin(const char *name);
+void phase_end(void);
+
+// Sets a named count, e.g. tokens or emitted instructions
+void time_report_count(const char *name, long value);
+
+// Instruction lines in generated assembly text
+long count_instructions(const char *text);
+
+void time_report_print(FILE *f, TimeReportFormat format);
+
+#endif
@@ -1,14 +1,19 @@
 #ifndef TOKENIZER_H
 #define TOKENIZER_H
 
+#include <stdio.h>
+
 typedef enum {
     TOKEN_LEFT_PAREN,
     TOKEN_RIGHT_PAREN,
     TOKEN_LEFT_BRACKET,
     TOKEN_RIGHT_BRACKET,
+    TOKEN_LEFT_BRACE,
+    TOKEN_RIGHT_BRACE,
     TOKEN_NUMBER,
     TOKEN_SYMBOL,
     TOKEN_STRING,
+    TOKEN_KEYWORD,
     TOKEN_EOF,
     TOKEN_ERROR
 } TokenType;
@@ -28,7 +33,7 @@ typedef struct {
 
 TokenList *tokenize(const char *source);
 void free_tokens(TokenList *list);
-void print_tokens(TokenList *list);
+void print_tokens(FILE *f, TokenList *list);
 const char *token_type_to_string(TokenType type);
 
 #endif
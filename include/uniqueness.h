@@ -0,0 +1,11 @@
+#ifndef UNIQUENESS_H
+#define UNIQUENESS_H
+
+#include "ast.h"
+
+// Sets `last_use` on every symbol in an expression that is not read again
+// afterwards, so loading a local there can move its value instead of
+// sharing it. Future and go bodies are left for their lifted functions.
+void uniqueness_analyze(ASTNode *expr);
+
+#endif
@@ -0,0 +1,123 @@
+#ifndef VALUE_H
+#define VALUE_H
+
+#include <stdint.h>
+#include <string.h>
+
+// NaN-boxed runtime values.
+//
+// Every cljc value is 64 bits wide. Doubles are stored unboxed. Everything
+// else lives in the negative quiet-NaN space: the top 16 bits hold a tag and
+// the low 48 bits hold a pointer. 0xFFF8 is left alone because it is the
+// default NaN on x86-64, so arithmetic can never produce a boxed value.
+//
+//   0x0000.. - 0xFFF8..   double
+//   0xFFF9 | ptr          string  (char *)
+//   0xFFFA | ptr          list    (RuntimeList *)
+//   0xFFFB | ptr          vector  (RuntimeList *)
+//   0xFFFC | ptr          symbol  (char *, interned by the compiler)
+//   0xFFFD | ptr          map     (RuntimeMap *, persistent HAMT)
+//   0xFFFE | ptr          keyword (RuntimeKeyword *, static, interned)
+//   0xFFFF | ptr          object  (RuntimeObject *, type in the header)
+
+typedef uint64_t Value;
+
+#define VALUE_CANONICAL_NAN 0x7FF8000000000000ULL
+#define VALUE_TAG_SHIFT 48
+#define VALUE_PAYLOAD_MASK 0x0000FFFFFFFFFFFFULL
+
+// High halfwords, used directly by codegen for `movk xN, #tag, lsl #48`
+#define VALUE_TAG_STRING 0xFFF9
+#define VALUE_TAG_LIST 0xFFFA
+#define VALUE_TAG_VECTOR 0xFFFB
+#define VALUE_TAG_SYMBOL 0xFFFC
+#define VALUE_TAG_MAP 0xFFFD
+#define VALUE_TAG_KEYWORD 0xFFFE
+#define VALUE_TAG_OBJECT 0xFFFF
+
+// First word of every object, also emitted by codegen for static objects
+#define OBJECT_TYPE_FUNCTION 1
+#define OBJECT_TYPE_LAZY_SEQ 2
+#define OBJECT_TYPE_FUTURE 3
+#define OBJECT_TYPE_ATOM 4
+#define OBJECT_TYPE_CHAN 5
+
+#define VALUE_FIRST_BOXED_TAG VALUE_TAG_STRING
+
+static inline unsigned value_tag(Value v) {
+    return (unsigned)(v >> VALUE_TAG_SHIFT);
+}
+
+static inline int value_is_number(Value v) {
+    return value_tag(v) < VALUE_FIRST_BOXED_TAG;
+}
+
+static inline int value_has_tag(Value v, unsigned tag) {
+    return value_tag(v) == tag;
+}
+
+static inline void *value_as_pointer(Value v) {
+    return (void *)(uintptr_t)(v & VALUE_PAYLOAD_MASK);
+}
+
+static inline Value value_box(unsigned tag, const void *ptr) {
+    return ((Value)tag << VALUE_TAG_SHIFT) | ((Value)(uintptr_t)ptr & VALUE_PAYLOAD_MASK);
+}
+
+static inline double value_as_double(Value v) {
+    double d;
+    memcpy(&d, &v, sizeof(d));
+    return d;
+}
+
+static inline Value value_from_double(double d) {
+    Value v;
+    if (d != d) {
+        return VALUE_CANONICAL_NAN;
+    }
+    memcpy(&v, &d, sizeof(v));
+    return v;
+}
+
+// Keeps the payload of a value that was carried in a d register, such as
+// the result of a compiled function
+static inline Value value_from_bits(double d) {
+    Value v;
+    memcpy(&v, &d, sizeof(v));
+    return v;
+}
+
+// Hashes shared by the runtime and by codegen, which precomputes the hash
+// of constant map keys. Both sides must agree bit for bit.
+static inline uint32_t value_hash_bytes(const char *s) {
+    uint32_t h = 2166136261u;
+    while (*s) {
+        h ^= (unsigned char)*s++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// Seeded so that :foo and "foo" land in different buckets
+static inline uint32_t value_hash_keyword(const char *name) {
+    return value_hash_bytes(name) ^ 0x9E3779B9u;
+}
+
+static inline uint32_t value_hash_mix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xFF51AFD7ED558CCDULL;
+    x ^= x >> 33;
+    x *= 0xC4CEB9FE1A85EC53ULL;
+    x ^= x >> 33;
+    return (uint32_t)x;
+}
+
+static inline uint32_t value_hash_number(double d) {
+    // 0.0 and -0.0 are = so they must hash alike
+    if (d == 0.0) {
+        d = 0.0;
+    }
+    return value_hash_mix64(value_from_double(d));
+}
+
+#endif
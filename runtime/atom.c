@@ -0,0 +1,99 @@
+#include <stdatomic.h>
+#include <stdlib.h>
+#include "runtime.h"
+
+// Atoms: one atomic 64-bit cell holding a Value, updated by compare and
+// swap. C11 atomics compile the CAS to `casal` on ARMv8.1+ (a LL/SC loop
+// before that) and to `lock cmpxchg` on x86-64. Numbers are stored
+// unboxed in the cell, so counters never allocate.
+
+static RuntimeAtom *as_atom(Value v, const char *builtin) {
+    if (value_has_tag(v, VALUE_TAG_OBJECT)) {
+        RuntimeObject *obj = value_as_pointer(v);
+        if (obj->type == OBJECT_TYPE_ATOM) {
+            return (RuntimeAtom *)obj;
+        }
+    }
+    fprintf(stderr, "Error: %s requires an atom\n", builtin);
+    exit(1);
+}
+
+Value atom_new(Value init) {
+    RuntimeAtom *atom = malloc(sizeof(RuntimeAtom));
+    atom->header.type = OBJECT_TYPE_ATOM;
+    rt_share(init);
+    atomic_init(&atom->value, init);
+    return value_box(VALUE_TAG_OBJECT, atom);
+}
+
+Value rt_atom_load(RuntimeAtom *atom) {
+    return atomic_load_explicit(&atom->value, memory_order_acquire);
+}
+
+Value atom_reset(Value ref, Value value) {
+    RuntimeAtom *atom = as_atom(ref, "reset!");
+    rt_share(value);
+    atomic_store_explicit(&atom->value, value, memory_order_release);
+    return value;
+}
+
+// f may run more than once under contention, so it should be pure
+Value atom_swap(Value ref, Value fn) {
+    RuntimeAtom *atom = as_atom(ref, "swap!");
+    RuntimeFunction *f = rt_as_function(fn, "swap!");
+    Value old = atomic_load_explicit(&atom->value, memory_order_acquire);
+    for (;;) {
+        Value next = rt_call1(f, old);
+        rt_share(next);
+        if (atomic_compare_exchange_weak_explicit(&atom->value, &old, next,
+                                                  memory_order_acq_rel,
+                                                  memory_order_acquire)) {
+            return next;
+        }
+    }
+}
+
+Value atom_swap_with(Value ref, Value fn, Value arg) {
+    RuntimeAtom *atom = as_atom(ref, "swap!");
+    RuntimeFunction *f = rt_as_function(fn, "swap!");
+    // f may see arg again on a retry
+    rt_share(arg);
+    Value old = atomic_load_explicit(&atom->value, memory_order_acquire);
+    for (;;) {
+        Value next = rt_call2(f, old, arg);
+        rt_share(next);
+        if (atomic_compare_exchange_weak_explicit(&atom->value, &old, next,
+                                                  memory_order_acq_rel,
+                                                  memory_order_acquire)) {
+            return next;
+        }
+    }
+}
+
+// (swap! a + n) and (swap! a * n): the arithmetic runs inside the CAS
+// loop with no call out
+double atom_add(Value ref, double delta) {
+    RuntimeAtom *atom = as_atom(ref, "swap!");
+    Value old = atomic_load_explicit(&atom->value, memory_order_acquire);
+    for (;;) {
+        double next = value_as_double(old) + delta;
+        if (atomic_compare_exchange_weak_explicit(&atom->value, &old, value_from_double(next),
+                                                  memory_order_acq_rel,
+                                                  memory_order_acquire)) {
+            return next;
+        }
+    }
+}
+
+double atom_mul(Value ref, double factor) {
+    RuntimeAtom *atom = as_atom(ref, "swap!");
+    Value old = atomic_load_explicit(&atom->value, memory_order_acquire);
+    for (;;) {
+        double next = value_as_double(old) * factor;
+        if (atomic_compare_exchange_weak_explicit(&atom->value, &old, value_from_double(next),
+                                                  memory_order_acq_rel,
+                                                  memory_order_acquire)) {
+            return next;
+        }
+    }
+}
@@ -0,0 +1,271 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "runtime.h"
+
+// Bounded channels for go blocks.
+//
+// The buffer is a lock-free bounded MPMC ring (Vyukov): each cell carries a
+// sequence number saying whether it is free for the sender at a position
+// or full for the receiver at it, so senders and receivers only contend on
+// their own index. The lock is taken only to park or wake fibers when the
+// buffer is full or empty.
+//
+// A fiber that cannot proceed registers as a waiter, then looks at the
+// buffer again before parking; the other side publishes its change before
+// checking for waiters. Either the waiter sees the change or the other side
+// sees the waiter, so no wakeup is lost. Threads outside go blocks run
+// other tasks while they wait instead of parking.
+
+typedef struct ChanCell {
+    atomic_size_t seq;
+    Value value;
+} ChanCell;
+
+// Lives on the parked fiber's stack
+typedef struct ChanWaiter {
+    RtFiber *fiber;
+    struct ChanWaiter *next;
+} ChanWaiter;
+
+typedef struct ChanWaiters {
+    atomic_int count;
+    ChanWaiter *head;
+    ChanWaiter *tail;
+} ChanWaiters;
+
+typedef struct RuntimeChan {
+    RuntimeObject header;
+    ChanCell *cells;
+    size_t mask;
+    _Alignas(64) atomic_size_t send_pos;
+    _Alignas(64) atomic_size_t recv_pos;
+    _Alignas(64) atomic_int closed;
+    pthread_mutex_t lock;
+    ChanWaiters senders;
+    ChanWaiters receivers;
+} RuntimeChan;
+
+static RuntimeChan *as_chan(Value v, const char *builtin) {
+    if (value_has_tag(v, VALUE_TAG_OBJECT)) {
+        RuntimeObject *obj = value_as_pointer(v);
+        if (obj->type == OBJECT_TYPE_CHAN) {
+            return (RuntimeChan *)obj;
+        }
+    }
+    fprintf(stderr, "Error: %s requires a channel\n", builtin);
+    exit(1);
+}
+
+// Capacity is rounded up to a power of two, at least 2: with a single
+// cell a full cell's sequence number would equal the next send position
+Value chan_new(double capacity) {
+    size_t size = 2;
+    while (size < (size_t)capacity) {
+        size <<= 1;
+    }
+
+    RuntimeChan *ch;
+    if (posix_memalign((void **)&ch, 64, sizeof(RuntimeChan)) != 0) {
+        fprintf(stderr, "Error: Could not allocate a channel\n");
+        exit(1);
+    }
+    ch->header.type = OBJECT_TYPE_CHAN;
+    ch->cells = malloc(size * sizeof(ChanCell));
+    ch->mask = size - 1;
+    for (size_t i = 0; i < size; i++) {
+        atomic_init(&ch->cells[i].seq, i);
+    }
+    atomic_init(&ch->send_pos, 0);
+    atomic_init(&ch->recv_pos, 0);
+    atomic_init(&ch->closed, 0);
+    pthread_mutex_init(&ch->lock, NULL);
+    atomic_init(&ch->senders.count, 0);
+    ch->senders.head = ch->senders.tail = NULL;
+    atomic_init(&ch->receivers.count, 0);
+    ch->receivers.head = ch->receivers.tail = NULL;
+    return value_box(VALUE_TAG_OBJECT, ch);
+}
+
+static int try_push(RuntimeChan *ch, Value value) {
+    size_t pos = atomic_load_explicit(&ch->send_pos, memory_order_relaxed);
+    for (;;) {
+        ChanCell *cell = &ch->cells[pos & ch->mask];
+        size_t seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&ch->send_pos, &pos, pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                cell->value = value;
+                atomic_store_explicit(&cell->seq, pos + 1, memory_order_release);
+                return 1;
+            }
+        } else if (diff < 0) {
+            return 0;  // Full
+        } else {
+            pos = atomic_load_explicit(&ch->send_pos, memory_order_relaxed);
+        }
+    }
+}
+
+static int try_pop(RuntimeChan *ch, Value *value) {
+    size_t pos = atomic_load_explicit(&ch->recv_pos, memory_order_relaxed);
+    for (;;) {
+        ChanCell *cell = &ch->cells[pos & ch->mask];
+        size_t seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&ch->recv_pos, &pos, pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                *value = cell->value;
+                atomic_store_explicit(&cell->seq, pos + ch->mask + 1, memory_order_release);
+                return 1;
+            }
+        } else if (diff < 0) {
+            return 0;  // Empty
+        } else {
+            pos = atomic_load_explicit(&ch->recv_pos, memory_order_relaxed);
+        }
+    }
+}
+
+// Peeks without claiming: only used to decide whether to park
+static int can_send(RuntimeChan *ch) {
+    size_t pos = atomic_load_explicit(&ch->send_pos, memory_order_relaxed);
+    size_t seq = atomic_load_explicit(&ch->cells[pos & ch->mask].seq, memory_order_acquire);
+    return (intptr_t)seq - (intptr_t)pos >= 0 ||
+           atomic_load_explicit(&ch->closed, memory_order_relaxed);
+}
+
+static int can_recv(RuntimeChan *ch) {
+    size_t pos = atomic_load_explicit(&ch->recv_pos, memory_order_relaxed);
+    size_t seq = atomic_load_explicit(&ch->cells[pos & ch->mask].seq, memory_order_acquire);
+    return (intptr_t)seq - (intptr_t)(pos + 1) >= 0 ||
+           atomic_load_explicit(&ch->closed, memory_order_relaxed);
+}
+
+// Parks the current fiber on `waiters` unless the channel became ready
+// while it registered. Either way the caller retries.
+static void park(RuntimeChan *ch, RtFiber *self, ChanWaiters *waiters,
+                 int (*ready)(RuntimeChan *)) {
+    ChanWaiter waiter = {self, NULL};
+
+    pthread_mutex_lock(&ch->lock);
+    atomic_fetch_add(&waiters->count, 1);
+    atomic_thread_fence(memory_order_seq_cst);
+    if (ready(ch)) {
+        atomic_fetch_sub(&waiters->count, 1);
+        pthread_mutex_unlock(&ch->lock);
+        return;
+    }
+
+    if (waiters->tail) {
+        waiters->tail->next = &waiter;
+    } else {
+        waiters->head = &waiter;
+    }
+    waiters->tail = &waiter;
+    rt_park(&ch->lock);
+}
+
+static ChanWaiter *pop_waiter(ChanWaiters *waiters) {
+    ChanWaiter *waiter = waiters->head;
+    if (waiter) {
+        waiters->head = waiter->next;
+        if (!waiters->head) {
+            waiters->tail = NULL;
+        }
+        atomic_fetch_sub(&waiters->count, 1);
+    }
+    return waiter;
+}
+
+// Called after publishing a change to the buffer
+static void wake_one(RuntimeChan *ch, ChanWaiters *waiters) {
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&waiters->count, memory_order_relaxed) == 0) {
+        return;
+    }
+
+    pthread_mutex_lock(&ch->lock);
+    ChanWaiter *waiter = pop_waiter(waiters);
+    pthread_mutex_unlock(&ch->lock);
+    if (waiter) {
+        rt_unpark(waiter->fiber);
+    }
+}
+
+static void wake_all(RuntimeChan *ch, ChanWaiters *waiters) {
+    pthread_mutex_lock(&ch->lock);
+    ChanWaiter *waiter = waiters->head;
+    waiters->head = waiters->tail = NULL;
+    atomic_store(&waiters->count, 0);
+    pthread_mutex_unlock(&ch->lock);
+
+    while (waiter) {
+        // Read before unparking: the waiter lives on the fiber's stack
+        ChanWaiter *next = waiter->next;
+        rt_unpark(waiter->fiber);
+        waiter = next;
+    }
+}
+
+// Returns 1.0 once the value is buffered, 0.0 if the channel is closed
+double chan_send(Value ref, Value value) {
+    RuntimeChan *ch = as_chan(ref, ">!");
+    RtFiber *self = rt_current_fiber();
+
+    for (;;) {
+        if (atomic_load_explicit(&ch->closed, memory_order_acquire)) {
+            return 0.0;
+        }
+        if (try_push(ch, value)) {
+            wake_one(ch, &ch->receivers);
+            return 1.0;
+        }
+        if (self) {
+            park(ch, self, &ch->senders, can_send);
+        } else {
+            rt_help();
+        }
+    }
+}
+
+// Returns not_found once the channel is closed and drained
+Value chan_recv(Value ref, Value not_found) {
+    RuntimeChan *ch = as_chan(ref, "<!");
+    RtFiber *self = rt_current_fiber();
+
+    for (;;) {
+        Value value;
+        if (try_pop(ch, &value)) {
+            wake_one(ch, &ch->senders);
+            return value;
+        }
+        if (atomic_load_explicit(&ch->closed, memory_order_acquire)) {
+            // A send may have landed just before the close
+            if (try_pop(ch, &value)) {
+                return value;
+            }
+            return not_found;
+        }
+        if (self) {
+            park(ch, self, &ch->receivers, can_recv);
+        } else {
+            rt_help();
+        }
+    }
+}
+
+Value chan_close(Value ref) {
+    RuntimeChan *ch = as_chan(ref, "close!");
+    atomic_store(&ch->closed, 1);
+    wake_all(ch, &ch->senders);
+    wake_all(ch, &ch->receivers);
+    return ref;
+}
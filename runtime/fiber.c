@@ -0,0 +1,217 @@
+#define _DEFAULT_SOURCE
+#define _DARWIN_C_SOURCE
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "runtime.h"
+
+// Green threads for go blocks.
+//
+// A fiber runs on its own stack and is scheduled as a task on the
+// work-stealing pool: running the task switches onto the fiber's stack
+// until the fiber finishes or parks on a channel. Whoever wakes a parked
+// fiber spawns it again, so it may resume on another worker.
+//
+// Compiled code never touches thread-local storage, so fibers can migrate
+// between OS threads. Runtime code must not keep a thread-local address
+// across rt_park.
+
+// Reserved, not committed: pages are touched on demand as on a main thread
+#define FIBER_STACK_SIZE (8 << 20)
+
+struct RtFiber {
+    RtTask task;
+    void *sp;         // Fiber's stack pointer while switched out
+    void *caller_sp;  // Worker's stack pointer while the fiber runs
+    char *stack;
+    pthread_mutex_t *park_lock;
+    int finished;
+    void *code;
+    int argc;
+    double args[8];
+    Value result;
+    Scratch scratch;
+};
+
+static _Thread_local RtFiber *current_fiber;
+static _Thread_local Scratch thread_scratch;
+
+// Saves the callee-saved registers on the current stack, stores the stack
+// pointer in *save_sp, then restores the registers saved on load_sp and
+// returns into that context
+void rt_context_switch(void **save_sp, void *load_sp);
+
+#if defined(__APPLE__)
+#define ASM_NAME(name) "_" name
+#else
+#define ASM_NAME(name) name
+#endif
+
+#if defined(__aarch64__)
+// x19-x30 and d8-d15: 160 bytes, x30 (the return address) at offset 88
+#define SWITCH_FRAME_SIZE 160
+#define SWITCH_FRAME_RETURN_SLOT 11
+__asm__(
+    ".text\n"
+    ".globl " ASM_NAME("rt_context_switch") "\n"
+    ".p2align 2\n"
+    ASM_NAME("rt_context_switch") ":\n"
+    "    sub sp, sp, #160\n"
+    "    stp x19, x20, [sp, #0]\n"
+    "    stp x21, x22, [sp, #16]\n"
+    "    stp x23, x24, [sp, #32]\n"
+    "    stp x25, x26, [sp, #48]\n"
+    "    stp x27, x28, [sp, #64]\n"
+    "    stp x29, x30, [sp, #80]\n"
+    "    stp d8, d9, [sp, #96]\n"
+    "    stp d10, d11, [sp, #112]\n"
+    "    stp d12, d13, [sp, #128]\n"
+    "    stp d14, d15, [sp, #144]\n"
+    "    mov x2, sp\n"
+    "    str x2, [x0]\n"
+    "    mov sp, x1\n"
+    "    ldp x19, x20, [sp, #0]\n"
+    "    ldp x21, x22, [sp, #16]\n"
+    "    ldp x23, x24, [sp, #32]\n"
+    "    ldp x25, x26, [sp, #48]\n"
+    "    ldp x27, x28, [sp, #64]\n"
+    "    ldp x29, x30, [sp, #80]\n"
+    "    ldp d8, d9, [sp, #96]\n"
+    "    ldp d10, d11, [sp, #112]\n"
+    "    ldp d12, d13, [sp, #128]\n"
+    "    ldp d14, d15, [sp, #144]\n"
+    "    add sp, sp, #160\n"
+    "    ret\n");
+#elif defined(__x86_64__)
+// rbp, rbx, r12-r15, then the return address pushed by the call
+#define SWITCH_FRAME_SIZE 64
+#define SWITCH_FRAME_RETURN_SLOT 6
+__asm__(
+    ".text\n"
+    ".globl " ASM_NAME("rt_context_switch") "\n"
+    ".p2align 4\n"
+    ASM_NAME("rt_context_switch") ":\n"
+    "    pushq %rbp\n"
+    "    pushq %rbx\n"
+    "    pushq %r12\n"
+    "    pushq %r13\n"
+    "    pushq %r14\n"
+    "    pushq %r15\n"
+    "    movq %rsp, (%rdi)\n"
+    "    movq %rsi, %rsp\n"
+    "    popq %r15\n"
+    "    popq %r14\n"
+    "    popq %r13\n"
+    "    popq %r12\n"
+    "    popq %rbx\n"
+    "    popq %rbp\n"
+    "    ret\n");
+#else
+#error "go blocks need a context switch for this architecture"
+#endif
+
+typedef double (*NativeFn0)(void);
+typedef double (*NativeFn8)(double, double, double, double, double, double, double, double);
+
+static void fiber_entry(void) {
+    RtFiber *fiber = current_fiber;
+    double *a = fiber->args;
+    double result;
+    if (fiber->argc == 0) {
+        result = ((NativeFn0)fiber->code)();
+    } else {
+        result = ((NativeFn8)fiber->code)(a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7]);
+    }
+    chan_send(fiber->result, value_from_bits(result));
+    chan_close(fiber->result);
+
+    fiber->finished = 1;
+    rt_context_switch(&fiber->sp, fiber->caller_sp);
+}
+
+// The first switch into a fiber "returns" into fiber_entry at the top of
+// its stack with zeroed callee-saved registers
+static void fiber_prepare(RtFiber *fiber) {
+    uintptr_t top = ((uintptr_t)fiber->stack + FIBER_STACK_SIZE) & ~(uintptr_t)15;
+    void **frame = (void **)(top - SWITCH_FRAME_SIZE);
+    memset(frame, 0, SWITCH_FRAME_SIZE);
+    frame[SWITCH_FRAME_RETURN_SLOT] = (void *)fiber_entry;
+    fiber->sp = frame;
+}
+
+static void run_fiber(RtTask *task) {
+    RtFiber *fiber = (RtFiber *)task;
+    RtFiber *outer = current_fiber;
+    current_fiber = fiber;
+    rt_context_switch(&fiber->caller_sp, fiber->sp);
+    current_fiber = outer;
+
+    if (fiber->finished) {
+        rt_scratch_free(&fiber->scratch);
+        munmap(fiber->stack, FIBER_STACK_SIZE);
+        free(fiber);
+        return;
+    }
+
+    // Parked: its waker needs this lock, so it cannot respawn the fiber
+    // before its context was saved above
+    pthread_mutex_t *lock = fiber->park_lock;
+    fiber->park_lock = NULL;
+    pthread_mutex_unlock(lock);
+}
+
+RtFiber *rt_current_fiber(void) {
+    return current_fiber;
+}
+
+// A go block keeps its own region so it can park and resume elsewhere
+Scratch *rt_current_scratch(void) {
+    return current_fiber ? &current_fiber->scratch : &thread_scratch;
+}
+
+// Called by a fiber holding `lock` after registering itself as a waiter;
+// the lock is released once the fiber is switched out
+void rt_park(pthread_mutex_t *lock) {
+    RtFiber *fiber = current_fiber;
+    fiber->park_lock = lock;
+    rt_context_switch(&fiber->sp, fiber->caller_sp);
+}
+
+void rt_unpark(RtFiber *fiber) {
+    rt_spawn(&fiber->task);
+}
+
+// `code` is a function the compiler lifted out of a (go ...) body, taking
+// the body's captured locals as arguments. The returned channel receives
+// the body's value and is then closed.
+Value go_spawn(void *code, long argc, double a0, double a1, double a2, double a3,
+               double a4, double a5, double a6, double a7) {
+    RtFiber *fiber = calloc(1, sizeof(RtFiber));
+    fiber->stack = mmap(NULL, FIBER_STACK_SIZE, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (fiber->stack == MAP_FAILED) {
+        fprintf(stderr, "Error: Could not allocate a go block stack\n");
+        exit(1);
+    }
+    // Guard page: overflowing the stack faults instead of corrupting memory
+    mprotect(fiber->stack, (size_t)sysconf(_SC_PAGESIZE), PROT_NONE);
+
+    fiber->task.run = run_fiber;
+    fiber->task.detached = 1;
+    fiber->code = code;
+    fiber->argc = (int)argc;
+    double args[8] = {a0, a1, a2, a3, a4, a5, a6, a7};
+    for (int i = 0; i < 8; i++) {
+        fiber->args[i] = args[i];
+    }
+    fiber->result = chan_new(1);
+    fiber_prepare(fiber);
+
+    Value result = fiber->result;
+    rt_spawn(&fiber->task);
+    return result;
+}
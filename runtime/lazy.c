@@ -0,0 +1,417 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include "runtime.h"
+
+// Lazy sequences.
+//
+// A LazySeq is a position in a chain of chunks produced by a generator.
+// `first` and `rest` force the chain one chunk at a time and cache it, so
+// every seq derived from the same head shares the realized elements and the
+// generator always sits exactly at the end of the chain.
+//
+// Consumers (`list-count`, the list kernels, printing, equality) use a
+// SeqCursor instead: it reads whatever is already realized, then clones the
+// generator and runs the copy into a private buffer without extending the
+// chain. Generators read their own source through a cursor, so a pipeline
+// like (list-sum (map f (filter p (range 1000000)))) holds one chunk per
+// stage rather than any intermediate list.
+//
+// Seqs may be shared between threads. Each shared generator has a lock
+// held while it extends its chain or is cloned; readers follow the chain
+// through `next_realized`, published with release/acquire.
+
+struct LazyChunk {
+    Value values[LAZY_CHUNK_SIZE];
+    int count;
+    atomic_int next_realized;
+    LazyChunk *next;
+};
+
+typedef enum {
+    GEN_RANGE,
+    GEN_ITERATE,
+    GEN_MAP,
+    GEN_FILTER,
+    GEN_TAKE,
+    GEN_DROP
+} GenKind;
+
+struct LazyGen {
+    GenKind kind;
+    RuntimeFunction *fn;
+    double start;       // range
+    double end;
+    double step;
+    long index;
+    long bounded;
+    Value current;      // iterate
+    int started;
+    SeqCursor source;   // map, filter, take, drop
+    long remaining;     // take, drop
+    pthread_mutex_t lock;
+};
+
+LazySeq *rt_as_lazy_seq(Value v) {
+    if (value_has_tag(v, VALUE_TAG_OBJECT)) {
+        RuntimeObject *obj = value_as_pointer(v);
+        if (obj->type == OBJECT_TYPE_LAZY_SEQ) {
+            return (LazySeq *)obj;
+        }
+    }
+    return NULL;
+}
+
+int rt_is_seq(Value v) {
+    return rt_as_list(v) != NULL || rt_as_lazy_seq(v) != NULL;
+}
+
+static Value box_seq(LazyGen *gen, LazyChunk *chunk, int offset, int forced) {
+    LazySeq *seq = malloc(sizeof(LazySeq));
+    seq->header.type = OBJECT_TYPE_LAZY_SEQ;
+    seq->gen = gen;
+    seq->chunk = chunk;
+    seq->offset = offset;
+    seq->forced = forced;
+    return value_box(VALUE_TAG_OBJECT, seq);
+}
+
+// Cursors
+
+static int gen_fill(LazyGen *gen, Value *out, int max);
+static LazyGen *gen_clone(const LazyGen *gen);
+
+static void cursor_clone(SeqCursor *dst, const SeqCursor *src) {
+    *dst = *src;
+    if (src->state == CURSOR_PRIVATE) {
+        dst->gen = gen_clone(src->gen);
+        dst->buffer = malloc(LAZY_CHUNK_SIZE * sizeof(Value));
+        memcpy(dst->buffer, src->buffer, src->count * sizeof(Value));
+        dst->values = dst->buffer;
+    }
+}
+
+static void cursor_go_private(SeqCursor *cursor, const LazyGen *gen) {
+    cursor->state = CURSOR_PRIVATE;
+    cursor->gen = gen_clone(gen);
+    cursor->buffer = malloc(LAZY_CHUNK_SIZE * sizeof(Value));
+    cursor->values = cursor->buffer;
+    cursor->count = 0;
+    cursor->pos = 0;
+}
+
+void rt_cursor_init(SeqCursor *cursor, Value coll) {
+    memset(cursor, 0, sizeof(SeqCursor));
+
+    RuntimeList *list = rt_as_list(coll);
+    if (list) {
+        cursor->state = CURSOR_LIST;
+        cursor->values = list->elements;
+        cursor->count = list->count;
+        return;
+    }
+
+    LazySeq *seq = rt_as_lazy_seq(coll);
+    if (!seq) {
+        cursor->state = CURSOR_DONE;
+        return;
+    }
+
+    pthread_mutex_lock(&seq->gen->lock);
+    if (!seq->forced) {
+        cursor_go_private(cursor, seq->gen);
+    } else if (!seq->chunk) {
+        cursor->state = CURSOR_DONE;
+    } else {
+        cursor->state = CURSOR_CHAIN;
+        cursor->chunk = seq->chunk;
+        cursor->gen = seq->gen;
+        cursor->values = seq->chunk->values;
+        cursor->count = seq->chunk->count;
+        cursor->pos = seq->offset;
+    }
+    pthread_mutex_unlock(&seq->gen->lock);
+}
+
+// Makes sure at least one value is buffered, returns 0 at the end
+static int cursor_fill(SeqCursor *cursor) {
+    while (cursor->pos >= cursor->count) {
+        switch (cursor->state) {
+            case CURSOR_CHAIN:
+                if (!atomic_load_explicit(&cursor->chunk->next_realized, memory_order_acquire)) {
+                    LazyGen *shared = cursor->gen;
+                    pthread_mutex_lock(&shared->lock);
+                    int realized = atomic_load_explicit(&cursor->chunk->next_realized,
+                                                        memory_order_relaxed);
+                    if (!realized) {
+                        cursor_go_private(cursor, shared);
+                    }
+                    pthread_mutex_unlock(&shared->lock);
+                    if (!realized) break;
+                }
+                cursor->chunk = cursor->chunk->next;
+                if (!cursor->chunk) {
+                    cursor->state = CURSOR_DONE;
+                    return 0;
+                }
+                cursor->values = cursor->chunk->values;
+                cursor->count = cursor->chunk->count;
+                cursor->pos = 0;
+                break;
+            case CURSOR_PRIVATE:
+                cursor->count = gen_fill(cursor->gen, cursor->buffer, LAZY_CHUNK_SIZE);
+                cursor->pos = 0;
+                if (cursor->count == 0) {
+                    cursor->state = CURSOR_DONE;
+                    return 0;
+                }
+                break;
+            default:
+                cursor->state = CURSOR_DONE;
+                return 0;
+        }
+    }
+    return 1;
+}
+
+int rt_cursor_next(SeqCursor *cursor, Value *out) {
+    if (!cursor_fill(cursor)) {
+        return 0;
+    }
+    *out = cursor->values[cursor->pos++];
+    return 1;
+}
+
+// Consumes up to `max` contiguous values, computing more only when none
+// are buffered
+int rt_cursor_span(SeqCursor *cursor, const Value **span, int max) {
+    if (!cursor_fill(cursor)) {
+        return 0;
+    }
+    int n = cursor->count - cursor->pos;
+    if (n > max) n = max;
+    *span = cursor->values + cursor->pos;
+    cursor->pos += n;
+    return n;
+}
+
+// Generators
+
+static LazyGen *alloc_gen(GenKind kind) {
+    LazyGen *gen = calloc(1, sizeof(LazyGen));
+    gen->kind = kind;
+    pthread_mutex_init(&gen->lock, NULL);
+    return gen;
+}
+
+// The caller holds the lock of a shared generator
+static LazyGen *gen_clone(const LazyGen *gen) {
+    LazyGen *copy = malloc(sizeof(LazyGen));
+    *copy = *gen;
+    pthread_mutex_init(&copy->lock, NULL);
+    cursor_clone(&copy->source, &gen->source);
+    return copy;
+}
+
+static int range_has(LazyGen *gen, double x) {
+    if (!gen->bounded) return 1;
+    return gen->step < 0 ? x > gen->end : x < gen->end;
+}
+
+// Stages that read a source only take what it has buffered, so a sparse
+// filter upstream is never pushed further than the consumer asked for
+static int gen_fill(LazyGen *gen, Value *out, int max) {
+    const Value *span = NULL;
+    int n = 0;
+
+    switch (gen->kind) {
+        case GEN_RANGE:
+            while (n < max) {
+                // Multiplying keeps long float ranges from drifting
+                double x = gen->start + (double)gen->index * gen->step;
+                if (!range_has(gen, x)) break;
+                out[n++] = value_from_double(x);
+                gen->index++;
+            }
+            return n;
+
+        case GEN_ITERATE:
+            while (n < max) {
+                if (gen->started) {
+                    gen->current = rt_call1(gen->fn, gen->current);
+                    rt_share(gen->current);
+                }
+                gen->started = 1;
+                out[n++] = gen->current;
+            }
+            return n;
+
+        case GEN_MAP:
+            n = rt_cursor_span(&gen->source, &span, max);
+            for (int i = 0; i < n; i++) {
+                out[i] = rt_call1(gen->fn, span[i]);
+                rt_share(out[i]);
+            }
+            return n;
+
+        case GEN_FILTER:
+            for (;;) {
+                int taken = rt_cursor_span(&gen->source, &span, max);
+                if (taken == 0) return 0;
+                for (int i = 0; i < taken; i++) {
+                    if (rt_truthy(rt_call1(gen->fn, span[i]))) {
+                        out[n++] = span[i];
+                    }
+                }
+                if (n > 0) return n;
+            }
+
+        case GEN_TAKE:
+            if (gen->remaining <= 0) return 0;
+            if (max > gen->remaining) max = (int)gen->remaining;
+            n = rt_cursor_span(&gen->source, &span, max);
+            memcpy(out, span, n * sizeof(Value));
+            gen->remaining -= n;
+            return n;
+
+        case GEN_DROP:
+            while (gen->remaining > 0) {
+                int skipped = rt_cursor_span(&gen->source, &span,
+                                             gen->remaining < max ? (int)gen->remaining : max);
+                if (skipped == 0) return 0;
+                gen->remaining -= skipped;
+            }
+            n = rt_cursor_span(&gen->source, &span, max);
+            memcpy(out, span, n * sizeof(Value));
+            return n;
+    }
+    return 0;
+}
+
+static LazyChunk *gen_pull(LazyGen *gen) {
+    LazyChunk *chunk = malloc(sizeof(LazyChunk));
+    chunk->count = gen_fill(gen, chunk->values, LAZY_CHUNK_SIZE);
+    atomic_init(&chunk->next_realized, 0);
+    chunk->next = NULL;
+    if (chunk->count == 0) {
+        free(chunk);
+        return NULL;
+    }
+    return chunk;
+}
+
+// The caller holds the generator's lock
+static LazyChunk *chunk_next(LazyChunk *chunk, LazyGen *gen) {
+    if (!atomic_load_explicit(&chunk->next_realized, memory_order_relaxed)) {
+        chunk->next = gen_pull(gen);
+        atomic_store_explicit(&chunk->next_realized, 1, memory_order_release);
+    }
+    return chunk->next;
+}
+
+// Realizes the chunk holding the seq's first element and returns where it
+// is. Moving past a chunk boundary does not change which element the seq
+// starts at.
+static LazyChunk *force(LazySeq *seq, int *offset) {
+    pthread_mutex_lock(&seq->gen->lock);
+    if (!seq->forced) {
+        seq->chunk = gen_pull(seq->gen);
+        seq->offset = 0;
+        seq->forced = 1;
+    }
+    while (seq->chunk && seq->offset >= seq->chunk->count) {
+        seq->chunk = chunk_next(seq->chunk, seq->gen);
+        seq->offset = 0;
+    }
+    LazyChunk *chunk = seq->chunk;
+    *offset = seq->offset;
+    pthread_mutex_unlock(&seq->gen->lock);
+    return chunk;
+}
+
+Value rt_lazy_first(LazySeq *seq) {
+    int offset;
+    LazyChunk *chunk = force(seq, &offset);
+    if (!chunk) {
+        return value_from_double(0.0);
+    }
+    return chunk->values[offset];
+}
+
+// O(1): the next chunk is only realized when the result is forced
+Value rt_lazy_rest(LazySeq *seq) {
+    int offset;
+    LazyChunk *chunk = force(seq, &offset);
+    if (!chunk) {
+        return value_box(VALUE_TAG_OBJECT, seq);
+    }
+    return box_seq(seq->gen, chunk, offset + 1, 1);
+}
+
+// Builtins
+
+Value range_seq(long bounded, double start, double end, double step) {
+    LazyGen *gen = alloc_gen(GEN_RANGE);
+    gen->bounded = bounded;
+    gen->start = start;
+    gen->end = end;
+    gen->step = step;
+    return box_seq(gen, NULL, 0, 0);
+}
+
+Value iterate_seq(Value fn, Value init) {
+    LazyGen *gen = alloc_gen(GEN_ITERATE);
+    gen->fn = rt_as_function(fn, "iterate");
+    gen->current = init;
+    rt_share(init);
+    return box_seq(gen, NULL, 0, 0);
+}
+
+Value map_seq(Value fn, Value coll) {
+    LazyGen *gen = alloc_gen(GEN_MAP);
+    gen->fn = rt_as_function(fn, "map");
+    rt_cursor_init(&gen->source, coll);
+    return box_seq(gen, NULL, 0, 0);
+}
+
+Value filter_seq(Value fn, Value coll) {
+    LazyGen *gen = alloc_gen(GEN_FILTER);
+    gen->fn = rt_as_function(fn, "filter");
+    rt_cursor_init(&gen->source, coll);
+    return box_seq(gen, NULL, 0, 0);
+}
+
+Value take_seq(double n, Value coll) {
+    LazyGen *gen = alloc_gen(GEN_TAKE);
+    gen->remaining = n > 0 ? (long)n : 0;
+    rt_cursor_init(&gen->source, coll);
+    return box_seq(gen, NULL, 0, 0);
+}
+
+Value drop_seq(double n, Value coll) {
+    LazyGen *gen = alloc_gen(GEN_DROP);
+    gen->remaining = n > 0 ? (long)n : 0;
+    rt_cursor_init(&gen->source, coll);
+    return box_seq(gen, NULL, 0, 0);
+}
+
+// For consumers that need random access, such as pmap
+RuntimeList *rt_realize(Value coll) {
+    RuntimeList *list = rt_as_list(coll);
+    if (list) {
+        return list;
+    }
+
+    SeqCursor cursor;
+    const Value *span;
+    int n;
+    list = rt_alloc_list(LAZY_CHUNK_SIZE);
+    rt_cursor_init(&cursor, coll);
+    while ((n = rt_cursor_span(&cursor, &span, LAZY_CHUNK_SIZE)) > 0) {
+        rt_list_reserve(list, n);
+        memcpy(list->elements + list->count, span, n * sizeof(Value));
+        list->count += n;
+    }
+    return list;
+}
@@ -0,0 +1,415 @@
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "runtime.h"
+
+// Bulk numeric list builtins.
+//
+// A list of numbers is a contiguous array of unboxed doubles, so these
+// kernels run straight over `elements` with NEON, AVX or SSE2 and finish
+// the tail with scalar code. Boxed elements are NaNs: they poison sums and
+// element-wise results (which are canonicalized so no tag survives) and
+// are skipped by min/max, which report an error when no number is left.
+//
+// Sums, products and dot products accumulate in vector lanes, so the
+// operations happen in a different order than a left-to-right reduce and
+// the last bits of an inexact result can differ from it.
+//
+// Lazy seqs are streamed through a SeqCursor, which hands out contiguous
+// spans (a whole list at once, a chunk at a time otherwise), so the same
+// loops run over both without realizing anything.
+
+#if defined(__AVX__)
+#include <immintrin.h>
+
+#define VLANES 4
+typedef __m256d vdouble;
+
+static inline vdouble v_load(const Value *p) { return _mm256_loadu_pd((const double *)p); }
+static inline void v_store(Value *p, vdouble v) { _mm256_storeu_pd((double *)p, v); }
+static inline vdouble v_splat(double d) { return _mm256_set1_pd(d); }
+static inline vdouble v_add(vdouble a, vdouble b) { return _mm256_add_pd(a, b); }
+static inline vdouble v_sub(vdouble a, vdouble b) { return _mm256_sub_pd(a, b); }
+static inline vdouble v_mul(vdouble a, vdouble b) { return _mm256_mul_pd(a, b); }
+// minpd/maxpd return the second operand when either is NaN
+static inline vdouble v_min(vdouble x, vdouble acc) { return _mm256_min_pd(x, acc); }
+static inline vdouble v_max(vdouble x, vdouble acc) { return _mm256_max_pd(x, acc); }
+
+static inline vdouble v_canonicalize(vdouble v) {
+    vdouble nan_mask = _mm256_cmp_pd(v, v, _CMP_UNORD_Q);
+    return _mm256_blendv_pd(v, v_splat(NAN), nan_mask);
+}
+
+static inline double v_lane(vdouble v, int lane) {
+    double lanes[VLANES];
+    _mm256_storeu_pd(lanes, v);
+    return lanes[lane];
+}
+
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+
+#define VLANES 2
+typedef __m128d vdouble;
+
+static inline vdouble v_load(const Value *p) { return _mm_loadu_pd((const double *)p); }
+static inline void v_store(Value *p, vdouble v) { _mm_storeu_pd((double *)p, v); }
+static inline vdouble v_splat(double d) { return _mm_set1_pd(d); }
+static inline vdouble v_add(vdouble a, vdouble b) { return _mm_add_pd(a, b); }
+static inline vdouble v_sub(vdouble a, vdouble b) { return _mm_sub_pd(a, b); }
+static inline vdouble v_mul(vdouble a, vdouble b) { return _mm_mul_pd(a, b); }
+static inline vdouble v_min(vdouble x, vdouble acc) { return _mm_min_pd(x, acc); }
+static inline vdouble v_max(vdouble x, vdouble acc) { return _mm_max_pd(x, acc); }
+
+static inline vdouble v_canonicalize(vdouble v) {
+    vdouble nan_mask = _mm_cmpunord_pd(v, v);
+    return _mm_or_pd(_mm_andnot_pd(nan_mask, v), _mm_and_pd(nan_mask, v_splat(NAN)));
+}
+
+static inline double v_lane(vdouble v, int lane) {
+    double lanes[VLANES];
+    _mm_storeu_pd(lanes, v);
+    return lanes[lane];
+}
+
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+
+#define VLANES 2
+typedef float64x2_t vdouble;
+
+static inline vdouble v_load(const Value *p) { return vld1q_f64((const double *)p); }
+static inline void v_store(Value *p, vdouble v) { vst1q_f64((double *)p, v); }
+static inline vdouble v_splat(double d) { return vdupq_n_f64(d); }
+static inline vdouble v_add(vdouble a, vdouble b) { return vaddq_f64(a, b); }
+static inline vdouble v_sub(vdouble a, vdouble b) { return vsubq_f64(a, b); }
+static inline vdouble v_mul(vdouble a, vdouble b) { return vmulq_f64(a, b); }
+// fminnm/fmaxnm ignore a NaN operand
+static inline vdouble v_min(vdouble x, vdouble acc) { return vminnmq_f64(x, acc); }
+static inline vdouble v_max(vdouble x, vdouble acc) { return vmaxnmq_f64(x, acc); }
+
+static inline vdouble v_canonicalize(vdouble v) {
+    uint64x2_t ordered = vceqq_f64(v, v);
+    return vbslq_f64(ordered, v, v_splat(NAN));
+}
+
+static inline double v_lane(vdouble v, int lane) {
+    return lane == 0 ? vgetq_lane_f64(v, 0) : vgetq_lane_f64(v, 1);
+}
+
+#else
+
+#define VLANES 1
+typedef double vdouble;
+
+static inline vdouble v_load(const Value *p) { return value_as_double(*p); }
+static inline void v_store(Value *p, vdouble v) { *p = value_from_double(v); }
+static inline vdouble v_splat(double d) { return d; }
+static inline vdouble v_add(vdouble a, vdouble b) { return a + b; }
+static inline vdouble v_sub(vdouble a, vdouble b) { return a - b; }
+static inline vdouble v_mul(vdouble a, vdouble b) { return a * b; }
+static inline vdouble v_min(vdouble x, vdouble acc) { return fmin(x, acc); }
+static inline vdouble v_max(vdouble x, vdouble acc) { return fmax(x, acc); }
+static inline vdouble v_canonicalize(vdouble v) { return v; }
+static inline double v_lane(vdouble v, int lane) { (void)lane; return v; }
+
+#endif
+
+// A NaN result may carry a boxed operand's payload; never hand that back
+static double canonical(double d) {
+    return value_as_double(value_from_double(d));
+}
+
+static double horizontal_sum(vdouble v) {
+    double sum = 0.0;
+    for (int i = 0; i < VLANES; i++) {
+        sum += v_lane(v, i);
+    }
+    return sum;
+}
+
+static double sum_span(const Value *xs, int n) {
+    int i = 0;
+
+    // Two accumulators hide the latency of the dependent adds
+    vdouble acc0 = v_splat(0.0);
+    vdouble acc1 = v_splat(0.0);
+    for (; i + 2 * VLANES <= n; i += 2 * VLANES) {
+        acc0 = v_add(acc0, v_load(xs + i));
+        acc1 = v_add(acc1, v_load(xs + i + VLANES));
+    }
+    double sum = horizontal_sum(v_add(acc0, acc1));
+    for (; i < n; i++) {
+        sum += value_as_double(xs[i]);
+    }
+    return sum;
+}
+
+static double product_span(const Value *xs, int n) {
+    int i = 0;
+
+    vdouble acc = v_splat(1.0);
+    for (; i + VLANES <= n; i += VLANES) {
+        acc = v_mul(acc, v_load(xs + i));
+    }
+    double product = 1.0;
+    for (int lane = 0; lane < VLANES; lane++) {
+        product *= v_lane(acc, lane);
+    }
+    for (; i < n; i++) {
+        product *= value_as_double(xs[i]);
+    }
+    return product;
+}
+
+static double dot_span(const Value *xs, const Value *ys, int n) {
+    int i = 0;
+
+    vdouble acc0 = v_splat(0.0);
+    vdouble acc1 = v_splat(0.0);
+    for (; i + 2 * VLANES <= n; i += 2 * VLANES) {
+        acc0 = v_add(acc0, v_mul(v_load(xs + i), v_load(ys + i)));
+        acc1 = v_add(acc1, v_mul(v_load(xs + i + VLANES), v_load(ys + i + VLANES)));
+    }
+    double sum = horizontal_sum(v_add(acc0, acc1));
+    for (; i < n; i++) {
+        sum += value_as_double(xs[i]) * value_as_double(ys[i]);
+    }
+    return sum;
+}
+
+static double min_span(const Value *xs, int n, double result) {
+    int i = 0;
+
+    vdouble acc = v_splat(result);
+    for (; i + VLANES <= n; i += VLANES) {
+        acc = v_min(v_load(xs + i), acc);
+    }
+    for (int lane = 0; lane < VLANES; lane++) {
+        result = fmin(v_lane(acc, lane), result);
+    }
+    for (; i < n; i++) {
+        result = fmin(value_as_double(xs[i]), result);
+    }
+    return result;
+}
+
+static double max_span(const Value *xs, int n, double result) {
+    int i = 0;
+
+    vdouble acc = v_splat(result);
+    for (; i + VLANES <= n; i += VLANES) {
+        acc = v_max(v_load(xs + i), acc);
+    }
+    for (int lane = 0; lane < VLANES; lane++) {
+        result = fmax(v_lane(acc, lane), result);
+    }
+    for (; i < n; i++) {
+        result = fmax(value_as_double(xs[i]), result);
+    }
+    return result;
+}
+
+double list_sum(Value lst) {
+    SeqCursor cursor;
+    const Value *span;
+    int n;
+    double sum = 0.0;
+    rt_cursor_init(&cursor, lst);
+    while ((n = rt_cursor_span(&cursor, &span, INT_MAX)) > 0) {
+        sum += sum_span(span, n);
+    }
+    return canonical(sum);
+}
+
+double list_product(Value lst) {
+    SeqCursor cursor;
+    const Value *span;
+    int n;
+    double product = 1.0;
+    rt_cursor_init(&cursor, lst);
+    while ((n = rt_cursor_span(&cursor, &span, INT_MAX)) > 0) {
+        product *= product_span(span, n);
+    }
+    return canonical(product);
+}
+
+// Steps two cursors in lockstep over spans of equal length, stopping at
+// the end of the shorter sequence
+typedef struct SpanPair {
+    SeqCursor a, b;
+    const Value *xs, *ys;
+    int nx, ny;
+} SpanPair;
+
+static void pair_init(SpanPair *pair, Value a, Value b) {
+    rt_cursor_init(&pair->a, a);
+    rt_cursor_init(&pair->b, b);
+    pair->nx = 0;
+    pair->ny = 0;
+}
+
+static int pair_next(SpanPair *pair, const Value **xs, const Value **ys) {
+    if (pair->nx == 0 && (pair->nx = rt_cursor_span(&pair->a, &pair->xs, INT_MAX)) == 0) {
+        return 0;
+    }
+    if (pair->ny == 0 && (pair->ny = rt_cursor_span(&pair->b, &pair->ys, INT_MAX)) == 0) {
+        return 0;
+    }
+    int n = pair->nx < pair->ny ? pair->nx : pair->ny;
+    *xs = pair->xs;
+    *ys = pair->ys;
+    pair->xs += n;
+    pair->ys += n;
+    pair->nx -= n;
+    pair->ny -= n;
+    return n;
+}
+
+// Pairs up elements to the length of the shorter list
+double list_dot(Value a, Value b) {
+    SpanPair pair;
+    const Value *xs, *ys;
+    int n;
+    double sum = 0.0;
+    pair_init(&pair, a, b);
+    while ((n = pair_next(&pair, &xs, &ys)) > 0) {
+        sum += dot_span(xs, ys, n);
+    }
+    return canonical(sum);
+}
+
+// min_span and max_span skip boxed elements, so a result still at its
+// infinite seed can mean the spans held no number at all
+static int has_number(const Value *xs, int n) {
+    for (int i = 0; i < n; i++) {
+        if (value_is_number(xs[i])) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void require_number(int seen, const char *builtin) {
+    if (!seen) {
+        fprintf(stderr, "Error: %s requires a list with at least one number\n", builtin);
+        exit(1);
+    }
+}
+
+double list_min(Value lst) {
+    SeqCursor cursor;
+    const Value *span;
+    int n;
+    int seen = 0;
+    double result = INFINITY;
+    rt_cursor_init(&cursor, lst);
+    while ((n = rt_cursor_span(&cursor, &span, INT_MAX)) > 0) {
+        result = min_span(span, n, result);
+        seen = seen || result != INFINITY || has_number(span, n);
+    }
+    require_number(seen, "list-min");
+    return canonical(result);
+}
+
+double list_max(Value lst) {
+    SeqCursor cursor;
+    const Value *span;
+    int n;
+    int seen = 0;
+    double result = -INFINITY;
+    rt_cursor_init(&cursor, lst);
+    while ((n = rt_cursor_span(&cursor, &span, INT_MAX)) > 0) {
+        result = max_span(span, n, result);
+        seen = seen || result != -INFINITY || has_number(span, n);
+    }
+    require_number(seen, "list-max");
+    return canonical(result);
+}
+
+static RuntimeList *alloc_result(Value like) {
+    RuntimeList *list = rt_as_list(like);
+    return rt_alloc_list(list ? list->count : LAZY_CHUNK_SIZE);
+}
+
+Value list_scale(Value lst, double k) {
+    RuntimeList *out = alloc_result(lst);
+    SeqCursor cursor;
+    const Value *xs;
+    int n;
+    vdouble factor = v_splat(k);
+    rt_cursor_init(&cursor, lst);
+    while ((n = rt_cursor_span(&cursor, &xs, INT_MAX)) > 0) {
+        rt_list_reserve(out, n);
+        Value *dst = out->elements + out->count;
+        int i = 0;
+        for (; i + VLANES <= n; i += VLANES) {
+            v_store(dst + i, v_canonicalize(v_mul(v_load(xs + i), factor)));
+        }
+        for (; i < n; i++) {
+            dst[i] = value_from_double(value_as_double(xs[i]) * k);
+        }
+        out->count += n;
+    }
+    return value_box(VALUE_TAG_LIST, out);
+}
+
+typedef enum {
+    ELEMENTWISE_ADD,
+    ELEMENTWISE_SUB,
+    ELEMENTWISE_MUL
+} ElementwiseOp;
+
+static void elementwise_span(Value *dst, const Value *xs, const Value *ys, int n,
+                             ElementwiseOp op) {
+    int i = 0;
+    for (; i + VLANES <= n; i += VLANES) {
+        vdouble x = v_load(xs + i);
+        vdouble y = v_load(ys + i);
+        vdouble r;
+        switch (op) {
+            case ELEMENTWISE_ADD: r = v_add(x, y); break;
+            case ELEMENTWISE_SUB: r = v_sub(x, y); break;
+            default: r = v_mul(x, y); break;
+        }
+        v_store(dst + i, v_canonicalize(r));
+    }
+    for (; i < n; i++) {
+        double x = value_as_double(xs[i]);
+        double y = value_as_double(ys[i]);
+        double r;
+        switch (op) {
+            case ELEMENTWISE_ADD: r = x + y; break;
+            case ELEMENTWISE_SUB: r = x - y; break;
+            default: r = x * y; break;
+        }
+        dst[i] = value_from_double(r);
+    }
+}
+
+static Value elementwise(Value a, Value b, ElementwiseOp op) {
+    RuntimeList *out = alloc_result(a);
+    SpanPair pair;
+    const Value *xs, *ys;
+    int n;
+    pair_init(&pair, a, b);
+    while ((n = pair_next(&pair, &xs, &ys)) > 0) {
+        rt_list_reserve(out, n);
+        elementwise_span(out->elements + out->count, xs, ys, n, op);
+        out->count += n;
+    }
+    return value_box(VALUE_TAG_LIST, out);
+}
+
+Value list_add(Value a, Value b) {
+    return elementwise(a, b, ELEMENTWISE_ADD);
+}
+
+Value list_sub(Value a, Value b) {
+    return elementwise(a, b, ELEMENTWISE_SUB);
+}
+
+Value list_mul(Value a, Value b) {
+    return elementwise(a, b, ELEMENTWISE_MUL);
+}
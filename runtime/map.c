@@ -0,0 +1,488 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "runtime.h"
+
+// Persistent hash map: a hash array mapped trie in the CHAMP layout.
+//
+// Each node consumes 5 bits of the 32-bit key hash. `datamap` marks slots
+// holding an inline key/value pair, `nodemap` marks slots holding a child
+// node. Inline pairs are packed first in `slots`, children after them.
+// Updates copy the path from the root, so every map value is immutable.
+// Once the hash is exhausted, keys with identical hashes share a
+// collision node that is searched linearly.
+
+#define HAMT_BITS 5
+#define HAMT_MASK 31
+#define HAMT_MAX_SHIFT 30
+
+struct HamtNode {
+    uint32_t datamap;
+    uint32_t nodemap;
+    uint32_t collisions;  // Entry count for collision nodes, 0 otherwise
+    Value slots[];
+};
+
+static int popcount(uint32_t x) {
+    return __builtin_popcount(x);
+}
+
+static uint32_t bitpos(uint32_t hash, int shift) {
+    return 1u << ((hash >> shift) & HAMT_MASK);
+}
+
+static int bit_index(uint32_t bitmap, uint32_t bit) {
+    return popcount(bitmap & (bit - 1));
+}
+
+static int data_count(HamtNode *node) {
+    return node->collisions ? (int)node->collisions : popcount(node->datamap);
+}
+
+static int child_count(HamtNode *node) {
+    return popcount(node->nodemap);
+}
+
+static HamtNode *get_child(HamtNode *node, int index) {
+    return (HamtNode *)(uintptr_t)node->slots[2 * data_count(node) + index];
+}
+
+static void set_child(HamtNode *node, int index, HamtNode *child) {
+    node->slots[2 * data_count(node) + index] = (Value)(uintptr_t)child;
+}
+
+static HamtNode *alloc_node(uint32_t datamap, uint32_t nodemap, uint32_t collisions) {
+    int pairs = collisions ? (int)collisions : popcount(datamap);
+    int slots = 2 * pairs + popcount(nodemap);
+    HamtNode *node = malloc(sizeof(HamtNode) + slots * sizeof(Value));
+    rt_stats_alloc(sizeof(HamtNode) + slots * sizeof(Value));
+    node->datamap = datamap;
+    node->nodemap = nodemap;
+    node->collisions = collisions;
+    return node;
+}
+
+static HamtNode *copy_node(HamtNode *node) {
+    int slots = 2 * data_count(node) + child_count(node);
+    HamtNode *copy = alloc_node(node->datamap, node->nodemap, node->collisions);
+    memcpy(copy->slots, node->slots, slots * sizeof(Value));
+    return copy;
+}
+
+static RuntimeMap *alloc_map(HamtNode *root, int count) {
+    RuntimeMap *map = malloc(sizeof(RuntimeMap));
+    rt_stats_alloc(sizeof(RuntimeMap));
+    map->root = root;
+    map->count = count;
+    return map;
+}
+
+RuntimeMap *rt_as_map(Value v) {
+    if (value_has_tag(v, VALUE_TAG_MAP)) {
+        return value_as_pointer(v);
+    }
+    return NULL;
+}
+
+uint32_t rt_value_hash(Value v) {
+    if (value_is_number(v)) {
+        return value_hash_number(value_as_double(v));
+    }
+
+    switch (value_tag(v)) {
+        case VALUE_TAG_STRING:
+        case VALUE_TAG_SYMBOL:
+            return value_hash_bytes(value_as_pointer(v));
+        case VALUE_TAG_LIST:
+        case VALUE_TAG_VECTOR:
+        case VALUE_TAG_OBJECT: {
+            if (!rt_is_seq(v)) {
+                return value_hash_mix64(v);
+            }
+            // Equal seqs hash alike whether lazy or realized
+            SeqCursor cursor;
+            Value elem;
+            uint32_t h = 1;
+            rt_cursor_init(&cursor, v);
+            while (rt_cursor_next(&cursor, &elem)) {
+                h = 31 * h + rt_value_hash(elem);
+            }
+            return h;
+        }
+        case VALUE_TAG_KEYWORD:
+            return (uint32_t)((RuntimeKeyword *)value_as_pointer(v))->hash;
+        case VALUE_TAG_MAP:
+            // Order independent, but cheap: maps are rarely keys
+            return value_hash_mix64((uint64_t)((RuntimeMap *)value_as_pointer(v))->count);
+        default:
+            return value_hash_mix64(v);
+    }
+}
+
+// Node holding two entries whose hashes first differ at or below `shift`
+static HamtNode *merge_pairs(Value k1, Value v1, uint32_t h1,
+                             Value k2, Value v2, uint32_t h2, int shift) {
+    if (shift > HAMT_MAX_SHIFT) {
+        HamtNode *node = alloc_node(0, 0, 2);
+        node->slots[0] = k1;
+        node->slots[1] = v1;
+        node->slots[2] = k2;
+        node->slots[3] = v2;
+        return node;
+    }
+
+    uint32_t b1 = bitpos(h1, shift);
+    uint32_t b2 = bitpos(h2, shift);
+
+    if (b1 == b2) {
+        HamtNode *node = alloc_node(0, b1, 0);
+        set_child(node, 0, merge_pairs(k1, v1, h1, k2, v2, h2, shift + HAMT_BITS));
+        return node;
+    }
+
+    HamtNode *node = alloc_node(b1 | b2, 0, 0);
+    int first = b1 < b2 ? 0 : 1;
+    node->slots[2 * first] = k1;
+    node->slots[2 * first + 1] = v1;
+    node->slots[2 * (1 - first)] = k2;
+    node->slots[2 * (1 - first) + 1] = v2;
+    return node;
+}
+
+static int node_find(HamtNode *node, Value key, uint32_t hash, int shift, Value *out) {
+    while (node) {
+        if (node->collisions) {
+            for (uint32_t i = 0; i < node->collisions; i++) {
+                if (value_equals(node->slots[2 * i], key)) {
+                    *out = node->slots[2 * i + 1];
+                    return 1;
+                }
+            }
+            return 0;
+        }
+
+        uint32_t bit = bitpos(hash, shift);
+        if (node->datamap & bit) {
+            int idx = bit_index(node->datamap, bit);
+            if (value_equals(node->slots[2 * idx], key)) {
+                *out = node->slots[2 * idx + 1];
+                return 1;
+            }
+            return 0;
+        }
+        if (!(node->nodemap & bit)) {
+            return 0;
+        }
+        node = get_child(node, bit_index(node->nodemap, bit));
+        shift += HAMT_BITS;
+    }
+    return 0;
+}
+
+static HamtNode *node_assoc(HamtNode *node, Value key, Value val, uint32_t hash,
+                            int shift, int *added) {
+    if (!node) {
+        HamtNode *leaf = alloc_node(bitpos(hash, shift), 0, 0);
+        leaf->slots[0] = key;
+        leaf->slots[1] = val;
+        *added = 1;
+        return leaf;
+    }
+
+    if (node->collisions) {
+        for (uint32_t i = 0; i < node->collisions; i++) {
+            if (value_equals(node->slots[2 * i], key)) {
+                HamtNode *copy = copy_node(node);
+                copy->slots[2 * i + 1] = val;
+                return copy;
+            }
+        }
+        HamtNode *grown = alloc_node(0, 0, node->collisions + 1);
+        memcpy(grown->slots, node->slots, 2 * node->collisions * sizeof(Value));
+        grown->slots[2 * node->collisions] = key;
+        grown->slots[2 * node->collisions + 1] = val;
+        *added = 1;
+        return grown;
+    }
+
+    uint32_t bit = bitpos(hash, shift);
+
+    if (node->datamap & bit) {
+        int idx = bit_index(node->datamap, bit);
+        Value existing = node->slots[2 * idx];
+
+        if (value_equals(existing, key)) {
+            if (node->slots[2 * idx + 1] == val) {
+                return node;
+            }
+            HamtNode *copy = copy_node(node);
+            copy->slots[2 * idx + 1] = val;
+            return copy;
+        }
+
+        // Push both entries one level down
+        HamtNode *child = merge_pairs(existing, node->slots[2 * idx + 1],
+                                      rt_value_hash(existing),
+                                      key, val, hash, shift + HAMT_BITS);
+        HamtNode *copy = alloc_node(node->datamap & ~bit, node->nodemap | bit, 0);
+        int old_pairs = popcount(node->datamap);
+        int old_children = child_count(node);
+        int child_idx = bit_index(node->nodemap, bit);
+
+        memcpy(copy->slots, node->slots, 2 * idx * sizeof(Value));
+        memcpy(copy->slots + 2 * idx, node->slots + 2 * (idx + 1),
+               2 * (old_pairs - idx - 1) * sizeof(Value));
+        for (int i = 0, j = 0; i <= old_children; i++) {
+            if (i == child_idx) {
+                set_child(copy, i, child);
+            } else {
+                set_child(copy, i, get_child(node, j++));
+            }
+        }
+        *added = 1;
+        return copy;
+    }
+
+    if (node->nodemap & bit) {
+        int child_idx = bit_index(node->nodemap, bit);
+        HamtNode *child = get_child(node, child_idx);
+        HamtNode *updated = node_assoc(child, key, val, hash, shift + HAMT_BITS, added);
+        if (updated == child) {
+            return node;
+        }
+        HamtNode *copy = copy_node(node);
+        set_child(copy, child_idx, updated);
+        return copy;
+    }
+
+    // Free slot: insert the pair inline
+    int idx = bit_index(node->datamap, bit);
+    int old_pairs = popcount(node->datamap);
+    HamtNode *copy = alloc_node(node->datamap | bit, node->nodemap, 0);
+    memcpy(copy->slots, node->slots, 2 * idx * sizeof(Value));
+    copy->slots[2 * idx] = key;
+    copy->slots[2 * idx + 1] = val;
+    memcpy(copy->slots + 2 * (idx + 1), node->slots + 2 * idx,
+           (2 * (old_pairs - idx) + child_count(node)) * sizeof(Value));
+    *added = 1;
+    return copy;
+}
+
+// Returns the node unchanged when the key is absent, NULL when it empties
+static HamtNode *node_dissoc(HamtNode *node, Value key, uint32_t hash, int shift, int *removed) {
+    if (node->collisions) {
+        for (uint32_t i = 0; i < node->collisions; i++) {
+            if (value_equals(node->slots[2 * i], key)) {
+                *removed = 1;
+                if (node->collisions == 1) {
+                    return NULL;
+                }
+                HamtNode *shrunk = alloc_node(0, 0, node->collisions - 1);
+                memcpy(shrunk->slots, node->slots, 2 * i * sizeof(Value));
+                memcpy(shrunk->slots + 2 * i, node->slots + 2 * (i + 1),
+                       2 * (node->collisions - i - 1) * sizeof(Value));
+                return shrunk;
+            }
+        }
+        return node;
+    }
+
+    uint32_t bit = bitpos(hash, shift);
+
+    if (node->datamap & bit) {
+        int idx = bit_index(node->datamap, bit);
+        if (!value_equals(node->slots[2 * idx], key)) {
+            return node;
+        }
+        *removed = 1;
+        if (node->datamap == bit && node->nodemap == 0) {
+            return NULL;
+        }
+        int old_pairs = popcount(node->datamap);
+        HamtNode *copy = alloc_node(node->datamap & ~bit, node->nodemap, 0);
+        memcpy(copy->slots, node->slots, 2 * idx * sizeof(Value));
+        memcpy(copy->slots + 2 * idx, node->slots + 2 * (idx + 1),
+               (2 * (old_pairs - idx - 1) + child_count(node)) * sizeof(Value));
+        return copy;
+    }
+
+    if (!(node->nodemap & bit)) {
+        return node;
+    }
+
+    int child_idx = bit_index(node->nodemap, bit);
+    HamtNode *child = get_child(node, child_idx);
+    HamtNode *updated = node_dissoc(child, key, hash, shift + HAMT_BITS, removed);
+    if (updated == child) {
+        return node;
+    }
+
+    int old_pairs = popcount(node->datamap);
+    int old_children = child_count(node);
+
+    if (!updated) {
+        if (old_pairs == 0 && old_children == 1) {
+            return NULL;
+        }
+        HamtNode *copy = alloc_node(node->datamap, node->nodemap & ~bit, 0);
+        memcpy(copy->slots, node->slots, 2 * old_pairs * sizeof(Value));
+        for (int i = 0, j = 0; i < old_children; i++) {
+            if (i != child_idx) {
+                set_child(copy, j++, get_child(node, i));
+            }
+        }
+        return copy;
+    }
+
+    // A child left with a single pair is pulled back inline
+    if (!updated->collisions && updated->nodemap == 0 && popcount(updated->datamap) == 1) {
+        int idx = bit_index(node->datamap, bit);
+        HamtNode *copy = alloc_node(node->datamap | bit, node->nodemap & ~bit, 0);
+        memcpy(copy->slots, node->slots, 2 * idx * sizeof(Value));
+        copy->slots[2 * idx] = updated->slots[0];
+        copy->slots[2 * idx + 1] = updated->slots[1];
+        memcpy(copy->slots + 2 * (idx + 1), node->slots + 2 * idx,
+               2 * (old_pairs - idx) * sizeof(Value));
+        for (int i = 0, j = 0; i < old_children; i++) {
+            if (i != child_idx) {
+                set_child(copy, j++, get_child(node, i));
+            }
+        }
+        return copy;
+    }
+
+    HamtNode *copy = copy_node(node);
+    set_child(copy, child_idx, updated);
+    return copy;
+}
+
+Value create_map(void) {
+    return value_box(VALUE_TAG_MAP, alloc_map(NULL, 0));
+}
+
+Value map_assoc_hashed(Value map, Value key, Value val, uint32_t hash) {
+    RT_STATS_SCOPE(RT_STAT_MAP_ASSOC);
+    rt_share(key);
+    rt_share(val);
+    RuntimeMap *m = rt_as_map(map);
+    HamtNode *root = m ? m->root : NULL;
+    int count = m ? m->count : 0;
+    int added = 0;
+
+    HamtNode *updated = node_assoc(root, key, val, hash, 0, &added);
+    if (m && updated == root) {
+        return map;
+    }
+    return value_box(VALUE_TAG_MAP, alloc_map(updated, count + added));
+}
+
+Value map_assoc(Value map, Value key, Value val) {
+    return map_assoc_hashed(map, key, val, rt_value_hash(key));
+}
+
+Value map_dissoc_hashed(Value map, Value key, uint32_t hash) {
+    RT_STATS_SCOPE(RT_STAT_MAP_DISSOC);
+    RuntimeMap *m = rt_as_map(map);
+    if (!m || !m->root) {
+        return map;
+    }
+
+    int removed = 0;
+    HamtNode *updated = node_dissoc(m->root, key, hash, 0, &removed);
+    if (!removed) {
+        return map;
+    }
+    return value_box(VALUE_TAG_MAP, alloc_map(updated, m->count - 1));
+}
+
+Value map_dissoc(Value map, Value key) {
+    return map_dissoc_hashed(map, key, rt_value_hash(key));
+}
+
+Value map_get_hashed(Value map, Value key, Value not_found, uint32_t hash) {
+    RT_STATS_SCOPE(RT_STAT_MAP_GET);
+    RuntimeMap *m = rt_as_map(map);
+    Value out;
+    if (m && node_find(m->root, key, hash, 0, &out)) {
+        return out;
+    }
+    return not_found;
+}
+
+Value map_get(Value map, Value key, Value not_found) {
+    return map_get_hashed(map, key, not_found, rt_value_hash(key));
+}
+
+double map_contains_hashed(Value map, Value key, uint32_t hash) {
+    RuntimeMap *m = rt_as_map(map);
+    Value out;
+    return (m && node_find(m->root, key, hash, 0, &out)) ? 1.0 : 0.0;
+}
+
+double map_contains(Value map, Value key) {
+    return map_contains_hashed(map, key, rt_value_hash(key));
+}
+
+typedef void (*EntryVisitor)(Value key, Value val, void *ctx);
+
+static void node_visit(HamtNode *node, EntryVisitor visit, void *ctx) {
+    if (!node) {
+        return;
+    }
+    int pairs = data_count(node);
+    for (int i = 0; i < pairs; i++) {
+        visit(node->slots[2 * i], node->slots[2 * i + 1], ctx);
+    }
+    int children = child_count(node);
+    for (int i = 0; i < children; i++) {
+        node_visit(get_child(node, i), visit, ctx);
+    }
+}
+
+typedef struct {
+    RuntimeMap *other;
+    int equal;
+} EqualsState;
+
+static void check_entry(Value key, Value val, void *ctx) {
+    EqualsState *state = ctx;
+    Value out;
+    if (!state->equal) {
+        return;
+    }
+    if (!node_find(state->other->root, key, rt_value_hash(key), 0, &out) ||
+        !value_equals(out, val)) {
+        state->equal = 0;
+    }
+}
+
+long rt_map_equals(RuntimeMap *a, RuntimeMap *b) {
+    if (a->count != b->count) {
+        return 0;
+    }
+    EqualsState state = { b, 1 };
+    node_visit(a->root, check_entry, &state);
+    return state.equal;
+}
+
+typedef struct {
+    FILE *out;
+    int written;
+} WriteState;
+
+static void write_entry(Value key, Value val, void *ctx) {
+    WriteState *state = ctx;
+    if (state->written++ > 0) {
+        fputs(", ", state->out);
+    }
+    rt_write_value(state->out, key);
+    fputc(' ', state->out);
+    rt_write_value(state->out, val);
+}
+
+void rt_write_map(FILE *out, RuntimeMap *map) {
+    WriteState state = { out, 0 };
+    fputc('{', out);
+    node_visit(map->root, write_entry, &state);
+    fputc('}', out);
+}
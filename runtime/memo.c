@@ -0,0 +1,216 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include "runtime.h"
+
+// Result caches for defn-memo functions.
+//
+// Each function has an open-addressing table keyed by its argument tuple,
+// compared bit for bit, so collections are keyed by identity. Slots are
+// flat runs of words: a header (hash plus flags), the result, then the
+// arguments. Probing is linear, and deleting shifts the rest of a probe
+// run back instead of leaving tombstones.
+//
+// The table starts small and doubles until it holds max_entries at half
+// load. Once full, an insert first evicts: CLOCK gives every entry that
+// was hit since the hand last passed a second chance, CLEAR drops them all.
+//
+// Compiled code passes its frame pointer: generate_function saves
+// parameter i at x29 - 16 * (i + 1).
+
+#define MEMO_INITIAL_SLOTS 64
+
+#define SLOT_USED (1ULL << 63)
+#define SLOT_REFERENCED (1ULL << 62)
+#define SLOT_HASH_MASK (SLOT_REFERENCED - 1)
+
+struct MemoTable {
+    pthread_mutex_t lock;
+    int argc;
+    int stride;  // Words per slot
+    size_t mask;
+    size_t count;
+    size_t max_entries;
+    size_t max_slots;
+    size_t hand;
+    int evict;
+    uint64_t *slots;
+};
+
+static inline Value frame_arg(const Value *frame, int i) {
+    return frame[-2 * (i + 1)];
+}
+
+static uint64_t hash_args(const Value *frame, int argc) {
+    uint64_t h = (uint64_t)argc;
+    for (int i = 0; i < argc; i++) {
+        h = (h ^ frame_arg(frame, i)) * 0x9E3779B97F4A7C15ULL;
+        h ^= h >> 32;
+    }
+    return h & SLOT_HASH_MASK;
+}
+
+static inline uint64_t *slot_at(MemoTable *t, size_t i) {
+    return &t->slots[i * t->stride];
+}
+
+static int slot_matches(MemoTable *t, uint64_t *slot, uint64_t hash, const Value *frame) {
+    if ((slot[0] & SLOT_HASH_MASK) != hash) {
+        return 0;
+    }
+    for (int i = 0; i < t->argc; i++) {
+        if (slot[2 + i] != frame_arg(frame, i)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Slot holding the arguments, or the free slot ending their probe run
+static uint64_t *probe(MemoTable *t, uint64_t hash, const Value *frame) {
+    for (size_t i = hash & t->mask;; i = (i + 1) & t->mask) {
+        uint64_t *slot = slot_at(t, i);
+        if (!(slot[0] & SLOT_USED) || slot_matches(t, slot, hash, frame)) {
+            return slot;
+        }
+    }
+}
+
+static void alloc_slots(MemoTable *t, size_t count) {
+    t->slots = calloc(count * t->stride, sizeof(uint64_t));
+    t->mask = count - 1;
+    t->hand = 0;
+}
+
+static void grow(MemoTable *t) {
+    uint64_t *old = t->slots;
+    size_t old_count = t->mask + 1;
+    alloc_slots(t, old_count * 2);
+    for (size_t i = 0; i < old_count; i++) {
+        uint64_t *from = &old[i * t->stride];
+        if (from[0] & SLOT_USED) {
+            size_t j = from[0] & t->mask;
+            while (slot_at(t, j)[0] & SLOT_USED) {
+                j = (j + 1) & t->mask;
+            }
+            memcpy(slot_at(t, j), from, t->stride * sizeof(uint64_t));
+        }
+    }
+    free(old);
+}
+
+// Backward-shift deletion: later entries of the probe run move up so
+// every entry stays reachable from its home slot
+static void delete_slot(MemoTable *t, size_t i) {
+    for (size_t j = (i + 1) & t->mask;; j = (j + 1) & t->mask) {
+        uint64_t *slot = slot_at(t, j);
+        if (!(slot[0] & SLOT_USED)) {
+            break;
+        }
+        size_t home = slot[0] & t->mask;
+        int stays = i <= j ? (i < home && home <= j) : (i < home || home <= j);
+        if (!stays) {
+            memcpy(slot_at(t, i), slot, t->stride * sizeof(uint64_t));
+            i = j;
+        }
+    }
+    slot_at(t, i)[0] = 0;
+    t->count--;
+}
+
+static void evict(MemoTable *t) {
+    if (t->evict == MEMO_EVICT_CLEAR) {
+        memset(t->slots, 0, (t->mask + 1) * t->stride * sizeof(uint64_t));
+        t->count = 0;
+        return;
+    }
+    for (;;) {
+        size_t i = t->hand;
+        t->hand = (t->hand + 1) & t->mask;
+        uint64_t *slot = slot_at(t, i);
+        if (slot[0] & SLOT_REFERENCED) {
+            slot[0] &= ~SLOT_REFERENCED;
+        } else if (slot[0] & SLOT_USED) {
+            delete_slot(t, i);
+            return;
+        }
+    }
+}
+
+static MemoTable *table_for(MemoCache *cache, long argc) {
+    MemoTable *t = atomic_load_explicit(&cache->table, memory_order_acquire);
+    if (t) {
+        return t;
+    }
+
+    t = malloc(sizeof(MemoTable));
+    pthread_mutex_init(&t->lock, NULL);
+    t->argc = (int)argc;
+    t->stride = (int)argc + 2;
+    t->count = 0;
+    t->max_entries = cache->max_entries > 0 ? (size_t)cache->max_entries : 1;
+    t->max_slots = MEMO_INITIAL_SLOTS;
+    while (t->max_slots < 2 * t->max_entries) {
+        t->max_slots <<= 1;
+    }
+    t->evict = (int)cache->evict;
+    alloc_slots(t, MEMO_INITIAL_SLOTS);
+
+    MemoTable *expected = NULL;
+    if (!atomic_compare_exchange_strong(&cache->table, &expected, t)) {
+        free(t->slots);
+        pthread_mutex_destroy(&t->lock);
+        free(t);
+        return expected;
+    }
+    return t;
+}
+
+// Returns 1 and stores the cached result in *out on a hit
+long memo_lookup(MemoCache *cache, const Value *frame, long argc, Value *out) {
+    MemoTable *t = table_for(cache, argc);
+    uint64_t hash = hash_args(frame, t->argc);
+
+    pthread_mutex_lock(&t->lock);
+    uint64_t *slot = probe(t, hash, frame);
+    int hit = (slot[0] & SLOT_USED) != 0;
+    if (hit) {
+        slot[0] |= SLOT_REFERENCED;
+        *out = slot[1];
+    }
+    pthread_mutex_unlock(&t->lock);
+    return hit;
+}
+
+// Caches the result computed for the arguments and returns it
+double memo_store(MemoCache *cache, const Value *frame, long argc, double result) {
+    MemoTable *t = table_for(cache, argc);
+    uint64_t hash = hash_args(frame, t->argc);
+    Value value = value_from_bits(result);
+    // The table keeps a reference to the result and the arguments
+    rt_share(value);
+    for (int i = 0; i < t->argc; i++) {
+        rt_share(frame_arg(frame, i));
+    }
+
+    pthread_mutex_lock(&t->lock);
+    uint64_t *slot = probe(t, hash, frame);
+    if (!(slot[0] & SLOT_USED)) {
+        // Another thread may have stored it meanwhile, otherwise insert
+        if (t->count >= t->max_entries) {
+            evict(t);
+        } else if (2 * (t->count + 1) > t->mask + 1 && t->mask + 1 < t->max_slots) {
+            grow(t);
+        }
+        slot = probe(t, hash, frame);
+        slot[0] = hash | SLOT_USED;
+        for (int i = 0; i < t->argc; i++) {
+            slot[2 + i] = frame_arg(frame, i);
+        }
+        t->count++;
+    }
+    slot[1] = value;
+    pthread_mutex_unlock(&t->lock);
+    return result;
+}
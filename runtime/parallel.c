@@ -0,0 +1,165 @@
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include "runtime.h"
+
+// Parallel builtins on top of the work-stealing scheduler.
+//
+// pmap and preduce split the contiguous elements of a list into a few
+// chunks per worker, spawn one task per chunk and run the first chunk on
+// the calling thread while the rest are stolen.
+
+#define CHUNKS_PER_WORKER 4
+
+typedef struct ChunkTask {
+    RtTask task;
+    RuntimeFunction *fn;
+    const Value *in;
+    Value *out;
+    int lo;
+    int hi;
+    Value partial;  // preduce
+} ChunkTask;
+
+static int chunk_count(int n) {
+    int chunks = rt_worker_count() * CHUNKS_PER_WORKER;
+    return chunks < n ? chunks : n;
+}
+
+// Spawns every chunk but the first, runs that one here, then waits
+static void run_chunks(ChunkTask *tasks, int chunks, void (*run)(RtTask *)) {
+    for (int i = 0; i < chunks; i++) {
+        tasks[i].task.run = run;
+        tasks[i].task.detached = 0;
+    }
+    for (int i = chunks - 1; i > 0; i--) {
+        rt_spawn(&tasks[i].task);
+    }
+    run(&tasks[0].task);
+    for (int i = 1; i < chunks; i++) {
+        rt_wait(&tasks[i].task);
+    }
+}
+
+static void split(ChunkTask *tasks, int chunks, int n, RuntimeFunction *fn,
+                  const Value *in, Value *out) {
+    for (int i = 0; i < chunks; i++) {
+        tasks[i].fn = fn;
+        tasks[i].in = in;
+        tasks[i].out = out;
+        tasks[i].lo = (int)((long)n * i / chunks);
+        tasks[i].hi = (int)((long)n * (i + 1) / chunks);
+    }
+}
+
+static void map_chunk(RtTask *task) {
+    ChunkTask *chunk = (ChunkTask *)task;
+    for (int i = chunk->lo; i < chunk->hi; i++) {
+        chunk->out[i] = rt_call1(chunk->fn, chunk->in[i]);
+        rt_share(chunk->out[i]);
+    }
+}
+
+Value pmap(Value fn, Value coll) {
+    RuntimeFunction *f = rt_as_function(fn, "pmap");
+    RuntimeList *in = rt_realize(coll);
+    int n = in->count;
+    RuntimeList *out = rt_alloc_list(n);
+    out->count = n;
+    if (n == 0) {
+        return value_box(VALUE_TAG_LIST, out);
+    }
+
+    int chunks = chunk_count(n);
+    ChunkTask *tasks = malloc(chunks * sizeof(ChunkTask));
+    split(tasks, chunks, n, f, in->elements, out->elements);
+    run_chunks(tasks, chunks, map_chunk);
+    free(tasks);
+    return value_box(VALUE_TAG_LIST, out);
+}
+
+static void reduce_chunk(RtTask *task) {
+    ChunkTask *chunk = (ChunkTask *)task;
+    Value acc = chunk->in[chunk->lo];
+    for (int i = chunk->lo + 1; i < chunk->hi; i++) {
+        acc = rt_call2(chunk->fn, acc, chunk->in[i]);
+    }
+    chunk->partial = acc;
+}
+
+// Each chunk folds its own elements, then the partials are folded onto
+// init in order: correct for any associative f, whether or not init is
+// its identity
+Value preduce(Value fn, Value init, Value coll) {
+    RuntimeFunction *f = rt_as_function(fn, "preduce");
+    RuntimeList *in = rt_realize(coll);
+    int n = in->count;
+    if (n == 0) {
+        return init;
+    }
+
+    int chunks = chunk_count(n);
+    ChunkTask *tasks = malloc(chunks * sizeof(ChunkTask));
+    split(tasks, chunks, n, f, in->elements, NULL);
+    run_chunks(tasks, chunks, reduce_chunk);
+
+    Value acc = init;
+    for (int i = 0; i < chunks; i++) {
+        acc = rt_call2(f, acc, tasks[i].partial);
+    }
+    free(tasks);
+    return acc;
+}
+
+typedef double (*NativeFn0)(void);
+typedef double (*NativeFn8)(double, double, double, double, double, double, double, double);
+
+static void run_future(RtTask *task) {
+    RuntimeFuture *future = (RuntimeFuture *)((char *)task - offsetof(RuntimeFuture, task));
+    double *a = future->args;
+    double result;
+    // Unused trailing argument registers are ignored by the callee
+    if (future->argc == 0) {
+        result = ((NativeFn0)future->code)();
+    } else {
+        result = ((NativeFn8)future->code)(a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7]);
+    }
+    // Every deref returns the same value
+    future->result = value_from_bits(result);
+    rt_share(future->result);
+}
+
+// `code` is a function the compiler lifted out of a (future ...) body,
+// taking the body's captured locals as arguments
+Value future_spawn(void *code, long argc, double a0, double a1, double a2, double a3,
+                   double a4, double a5, double a6, double a7) {
+    RuntimeFuture *future = malloc(sizeof(RuntimeFuture));
+    future->header.type = OBJECT_TYPE_FUTURE;
+    future->task.run = run_future;
+    future->task.detached = 0;
+    future->code = code;
+    future->argc = (int)argc;
+    double args[8] = {a0, a1, a2, a3, a4, a5, a6, a7};
+    for (int i = 0; i < 8; i++) {
+        future->args[i] = args[i];
+    }
+    future->result = value_from_double(0.0);
+    rt_spawn(&future->task);
+    return value_box(VALUE_TAG_OBJECT, future);
+}
+
+Value deref(Value ref) {
+    if (value_has_tag(ref, VALUE_TAG_OBJECT)) {
+        RuntimeObject *obj = value_as_pointer(ref);
+        if (obj->type == OBJECT_TYPE_FUTURE) {
+            RuntimeFuture *future = (RuntimeFuture *)obj;
+            rt_wait(&future->task);
+            return future->result;
+        }
+        if (obj->type == OBJECT_TYPE_ATOM) {
+            return rt_atom_load((RuntimeAtom *)obj);
+        }
+    }
+    fprintf(stderr, "Error: deref requires a future or an atom\n");
+    exit(1);
+}
@@ -0,0 +1,228 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+#include "runtime.h"
+
+// Hardware counters around top-level forms, for programs compiled with
+// --perf-counters. main calls perf_scope_begin and perf_scope_end around
+// every form it evaluates, and the per-form table is printed to stderr at
+// exit.
+//
+// On Linux the counters are one perf_event_open group, so all of them
+// cover the same instructions. Events the machine or the container does
+// not allow are reported as n/a. When no event opens at all, for example
+// with perf_event_paranoid set or under seccomp, and on macOS, which has
+// no public counter API, only wall time is reported, with the reason.
+// Counts are for the main thread; forms that run futures or go blocks do
+// part of their work on other threads.
+
+#define PERF_MAX_SCOPES 256
+
+typedef enum {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_CACHE_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_EVENT_COUNT
+} PerfEvent;
+
+static const char *event_names[PERF_EVENT_COUNT] = {
+    [PERF_CYCLES] = "cycles",
+    [PERF_INSTRUCTIONS] = "instructions",
+    [PERF_CACHE_MISSES] = "cache-misses",
+    [PERF_BRANCH_MISSES] = "branch-misses",
+};
+
+typedef struct PerfScope {
+    const char *label;
+    int64_t runs;
+    uint64_t wall_ns;
+    uint64_t counts[PERF_EVENT_COUNT];
+} PerfScope;
+
+static PerfScope scopes[PERF_MAX_SCOPES];
+static long scope_count = 0;
+static uint64_t scope_start_ns;
+
+static int initialized = 0;
+static int group_fd = -1;
+static int group_index[PERF_EVENT_COUNT];  // Position in the group read, or -1
+static int group_size = 0;
+static const char *unavailable = NULL;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+#ifdef __linux__
+static const uint64_t event_configs[PERF_EVENT_COUNT] = {
+    [PERF_CYCLES] = PERF_COUNT_HW_CPU_CYCLES,
+    [PERF_INSTRUCTIONS] = PERF_COUNT_HW_INSTRUCTIONS,
+    [PERF_CACHE_MISSES] = PERF_COUNT_HW_CACHE_MISSES,
+    [PERF_BRANCH_MISSES] = PERF_COUNT_HW_BRANCH_MISSES,
+};
+
+static int open_event(PerfEvent event, int leader) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = event_configs[event];
+    attr.disabled = leader < 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0);
+}
+
+static void open_group(void) {
+    int first_errno = 0;
+    for (int i = 0; i < PERF_EVENT_COUNT; i++) {
+        int fd = open_event((PerfEvent)i, group_fd);
+        if (fd < 0) {
+            group_index[i] = -1;
+            if (!first_errno) {
+                first_errno = errno;
+            }
+            continue;
+        }
+        if (group_fd < 0) {
+            group_fd = fd;
+        }
+        group_index[i] = group_size++;
+    }
+    if (group_fd < 0) {
+        unavailable = first_errno == EACCES || first_errno == EPERM
+            ? "perf_event_open not permitted (see /proc/sys/kernel/perf_event_paranoid)"
+            : first_errno == ENOSYS
+            ? "perf_event_open not available in this kernel or container"
+            : "no hardware counters on this machine";
+    }
+}
+
+// Group read layout for PERF_FORMAT_GROUP: nr, then one value per event
+static int read_group(uint64_t *values) {
+    uint64_t buffer[1 + PERF_EVENT_COUNT];
+    ssize_t expected = (ssize_t)((1 + group_size) * sizeof(uint64_t));
+    if (read(group_fd, buffer, sizeof(buffer)) < expected) {
+        return 0;
+    }
+    for (int i = 0; i < PERF_EVENT_COUNT; i++) {
+        values[i] = group_index[i] >= 0 ? buffer[1 + group_index[i]] : 0;
+    }
+    return 1;
+}
+#else
+static void open_group(void) {
+    for (int i = 0; i < PERF_EVENT_COUNT; i++) {
+        group_index[i] = -1;
+    }
+    unavailable = "no user-space counter API on this platform";
+}
+#endif
+
+static void print_count(FILE *out, const PerfScope *scope, int event) {
+    if (group_index[event] < 0) {
+        fprintf(out, " %14s", "n/a");
+    } else {
+        fprintf(out, " %14llu", (unsigned long long)scope->counts[event]);
+    }
+}
+
+static void print_scopes(void) {
+    FILE *out = stderr;
+    fprintf(out, "\n%-32s %6s %12s", "top-level form", "runs", "wall us");
+    if (!unavailable) {
+        for (int i = 0; i < PERF_EVENT_COUNT; i++) {
+            fprintf(out, " %14s", event_names[i]);
+        }
+        fprintf(out, " %6s", "IPC");
+    }
+    fprintf(out, "\n");
+
+    for (long i = 0; i < scope_count; i++) {
+        const PerfScope *scope = &scopes[i];
+        if (!scope->label) {
+            continue;
+        }
+        fprintf(out, "%-32.32s %6lld %12.1f", scope->label, (long long)scope->runs,
+                (double)scope->wall_ns / 1e3);
+        if (!unavailable) {
+            for (int e = 0; e < PERF_EVENT_COUNT; e++) {
+                print_count(out, scope, e);
+            }
+            if (group_index[PERF_CYCLES] >= 0 && group_index[PERF_INSTRUCTIONS] >= 0 &&
+                scope->counts[PERF_CYCLES]) {
+                fprintf(out, " %6.2f", (double)scope->counts[PERF_INSTRUCTIONS] /
+                        (double)scope->counts[PERF_CYCLES]);
+            } else {
+                fprintf(out, " %6s", "-");
+            }
+        }
+        fprintf(out, "\n");
+    }
+    if (unavailable) {
+        fprintf(out, "hardware counters unavailable: %s; wall time only\n", unavailable);
+    }
+}
+
+static void initialize(void) {
+    initialized = 1;
+    open_group();
+    atexit(print_scopes);
+}
+
+// index is the position of the form in the program, label a short
+// description of it; both are constants in the generated code
+void perf_scope_begin(long index, const char *label) {
+    if (!initialized) {
+        initialize();
+    }
+    if (index < 0 || index >= PERF_MAX_SCOPES) {
+        return;
+    }
+    scopes[index].label = label;
+    if (index >= scope_count) {
+        scope_count = index + 1;
+    }
+#ifdef __linux__
+    if (group_fd >= 0) {
+        ioctl(group_fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(group_fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+#endif
+    scope_start_ns = now_ns();
+}
+
+void perf_scope_end(long index) {
+    uint64_t elapsed = now_ns() - scope_start_ns;
+    if (index < 0 || index >= PERF_MAX_SCOPES) {
+        return;
+    }
+    PerfScope *scope = &scopes[index];
+#ifdef __linux__
+    if (group_fd >= 0) {
+        ioctl(group_fd, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+        uint64_t values[PERF_EVENT_COUNT];
+        if (read_group(values)) {
+            for (int i = 0; i < PERF_EVENT_COUNT; i++) {
+                scope->counts[i] += values[i];
+            }
+        }
+    }
+#endif
+    scope->runs++;
+    scope->wall_ns += elapsed;
+}
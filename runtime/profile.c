@@ -0,0 +1,42 @@
+#include <stdlib.h>
+#include "runtime.h"
+
+// Profile output of programs compiled with --profile-generate, read back
+// by the compiler's --profile-use (format in include/profile.h). The
+// counters live in the program's data section; this only writes them out
+// when the program exits. A run overwrites the file, so point
+// CLJC_PROFILE at a fresh path per run to keep several; the compiler adds
+// up records it sees twice.
+
+static const RtProfile *profile = NULL;
+
+static void write_profile(void) {
+    const char *path = getenv("CLJC_PROFILE");
+    if (!path || !*path) {
+        path = profile->path;
+    }
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        fprintf(stderr, "Warning: Could not write profile to %s\n", path);
+        return;
+    }
+
+    fprintf(f, "cljc-profile 1\n");
+    for (int64_t i = 0; i < profile->functions->count; i++) {
+        fprintf(f, "function %s %lld\n", profile->functions->counters[i].name,
+                (long long)*profile->functions->counters[i].calls);
+    }
+    for (int64_t i = 0; i < profile->branch_count; i++) {
+        const RtBranchCounter *branch = &profile->branches[i];
+        fprintf(f, "branch %lld:%lld %lld %lld\n", (long long)branch->line,
+                (long long)branch->column, (long long)branch->counts[0],
+                (long long)branch->counts[1]);
+    }
+    fclose(f);
+}
+
+// Called first thing in main by programs compiled with --profile-generate
+void rt_profile_start(const RtProfile *p) {
+    profile = p;
+    atexit(write_profile);
+}
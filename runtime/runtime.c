@@ -1,146 +1,460 @@
+#include <stddef.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include "runtime.h"
 
-// Forward declaration
-typedef struct RuntimeList RuntimeList;
+RuntimeList *rt_as_list(Value v) {
+    if (value_has_tag(v, VALUE_TAG_LIST) || value_has_tag(v, VALUE_TAG_VECTOR)) {
+        return value_as_pointer(v);
+    }
+    return NULL;
+}
+
+const char *rt_as_string(Value v) {
+    if (value_has_tag(v, VALUE_TAG_STRING) || value_has_tag(v, VALUE_TAG_SYMBOL)) {
+        return value_as_pointer(v);
+    }
+    return "";
+}
+
+// Symbols are plain C strings, strings know their length
+long rt_string_length(Value v) {
+    if (value_has_tag(v, VALUE_TAG_STRING)) {
+        const char *chars = value_as_pointer(v);
+        return (long)((const RuntimeString *)(chars - offsetof(RuntimeString, chars)))->length;
+    }
+    return (long)strlen(rt_as_string(v));
+}
+
+// Returns the characters of a new string of `length` bytes plus the NUL
+char *rt_alloc_string(size_t length) {
+    rt_stats_alloc(sizeof(RuntimeString) + length + 1);
+    RuntimeString *s = malloc(sizeof(RuntimeString) + length + 1);
+    s->length = (int64_t)length;
+    s->chars[length] = '\0';
+    return s->chars;
+}
+
+static void rt_write_object(FILE *out, RuntimeObject *obj) {
+    switch (obj->type) {
+        case OBJECT_TYPE_FUNCTION:
+            fprintf(out, "#<fn>");
+            break;
+        case OBJECT_TYPE_FUTURE:
+            fprintf(out, "#<future>");
+            break;
+        case OBJECT_TYPE_CHAN:
+            fprintf(out, "#<chan>");
+            break;
+        case OBJECT_TYPE_ATOM:
+            fprintf(out, "#<atom ");
+            rt_write_value(out, rt_atom_load((RuntimeAtom *)obj));
+            fputc('>', out);
+            break;
+        default:
+            fprintf(out, "#<object %llu>", (unsigned long long)obj->type);
+            break;
+    }
+}
+
+void rt_write_value(FILE *out, Value v) {
+    if (value_is_number(v)) {
+        fprintf(out, "%g", value_as_double(v));
+        return;
+    }
+
+    switch (value_tag(v)) {
+        case VALUE_TAG_STRING:
+            fprintf(out, "\"%s\"", (const char *)value_as_pointer(v));
+            break;
+        case VALUE_TAG_SYMBOL:
+            fprintf(out, "%s", (const char *)value_as_pointer(v));
+            break;
+        case VALUE_TAG_LIST:
+        case VALUE_TAG_VECTOR:
+        case VALUE_TAG_OBJECT: {
+            if (value_has_tag(v, VALUE_TAG_OBJECT) && !rt_is_seq(v)) {
+                rt_write_object(out, value_as_pointer(v));
+                break;
+            }
+            int is_vector = value_has_tag(v, VALUE_TAG_VECTOR);
+            SeqCursor cursor;
+            Value elem;
+            rt_cursor_init(&cursor, v);
+            fputc(is_vector ? '[' : '(', out);
+            for (int i = 0; rt_cursor_next(&cursor, &elem); i++) {
+                if (i > 0) fputc(' ', out);
+                rt_write_value(out, elem);
+            }
+            fputc(is_vector ? ']' : ')', out);
+            break;
+        }
+        case VALUE_TAG_MAP:
+            rt_write_map(out, value_as_pointer(v));
+            break;
+        case VALUE_TAG_KEYWORD:
+            fprintf(out, ":%s", ((RuntimeKeyword *)value_as_pointer(v))->name);
+            break;
+        default:
+            fprintf(out, "#<unknown %04x>", value_tag(v));
+            break;
+    }
+}
+
+// Function values
+RuntimeFunction *rt_as_function(Value v, const char *builtin) {
+    if (value_has_tag(v, VALUE_TAG_OBJECT)) {
+        RuntimeObject *obj = value_as_pointer(v);
+        if (obj->type == OBJECT_TYPE_FUNCTION) {
+            return (RuntimeFunction *)obj;
+        }
+    }
+    fprintf(stderr, "Error: %s requires a function\n", builtin);
+    exit(1);
+}
+
+typedef double (*NativeFn1)(double);
+typedef double (*NativeFn2)(double, double);
+
+Value rt_call1(RuntimeFunction *fn, Value arg) {
+    return value_from_bits(((NativeFn1)fn->code)(value_as_double(arg)));
+}
+
+Value rt_call2(RuntimeFunction *fn, Value a, Value b) {
+    return value_from_bits(((NativeFn2)fn->code)(value_as_double(a), value_as_double(b)));
+}
+
+int rt_truthy(Value v) {
+    return value_as_double(v) != 0.0;
+}
+
+static double add2(double a, double b) {
+    return a + b;
+}
+
+static double mul2(double a, double b) {
+    return a * b;
+}
+
+// + and * as values, for builtins such as preduce
+const RuntimeFunction rt_add_function = {{OBJECT_TYPE_FUNCTION}, (void *)add2, 2};
+const RuntimeFunction rt_mul_function = {{OBJECT_TYPE_FUNCTION}, (void *)mul2, 2};
 
 void print_double(double value) {
     printf("Result: %f\n", value);
 }
 
-void print_list(RuntimeList *lst);  // Forward declare, define later
+void print_value(Value v) {
+    if (value_is_number(v)) {
+        print_double(value_as_double(v));
+        return;
+    }
+    printf("Result: ");
+    rt_write_value(stdout, v);
+    printf("\n");
+}
+
+void print_list(Value lst) {
+    if (!rt_is_seq(lst)) {
+        printf("Result: ()\n");
+        return;
+    }
+    print_value(lst);
+}
 
 // String runtime functions
-double str_length(const char *s) {
-    return (double)strlen(s);
+// str-length and str-char-at are inlined by the compiler for strings;
+// these handle everything else
+double str_length(Value s) {
+    RT_STATS_SCOPE(RT_STAT_STR_LENGTH);
+    return (double)rt_string_length(s);
 }
 
-double str_char_at(const char *s, double index) {
-    int idx = (int)index;
-    if (idx < 0 || idx >= (int)strlen(s)) {
+double str_char_at(Value s, double index) {
+    RT_STATS_SCOPE(RT_STAT_STR_CHAR_AT);
+    const char *str = rt_as_string(s);
+    long idx = (long)index;
+    if (idx < 0 || idx >= rt_string_length(s)) {
         return 0.0;
     }
-    return (double)s[idx];
+    // Signed on every target, like the inline ldrsb in codegen
+    return (double)(signed char)str[idx];
 }
 
-char* str_concat(const char *s1, const char *s2) {
-    size_t len1 = strlen(s1);
-    size_t len2 = strlen(s2);
-    char *result = malloc(len1 + len2 + 1);
-    strcpy(result, s1);
-    strcat(result, s2);
-    return result;
+Value str_concat(Value s1, Value s2) {
+    RT_STATS_SCOPE(RT_STAT_STR_CONCAT);
+    const char *a = rt_as_string(s1);
+    const char *b = rt_as_string(s2);
+    size_t len1 = (size_t)rt_string_length(s1);
+    size_t len2 = (size_t)rt_string_length(s2);
+    char *result = rt_alloc_string(len1 + len2);
+    memcpy(result, a, len1);
+    memcpy(result + len1, b, len2);
+    return value_box(VALUE_TAG_STRING, result);
 }
 
-char* substring(const char *s, double start, double end) {
+Value substring(Value s, double start, double end) {
+    RT_STATS_SCOPE(RT_STAT_SUBSTRING);
+    const char *str = rt_as_string(s);
     int st = (int)start;
     int en = (int)end;
-    int len = (int)strlen(s);
+    int len = (int)rt_string_length(s);
 
     if (st < 0) st = 0;
     if (en > len) en = len;
     if (st >= en) {
-        char *empty = malloc(1);
-        empty[0] = '\0';
-        return empty;
+        return value_box(VALUE_TAG_STRING, rt_alloc_string(0));
     }
 
     int result_len = en - st;
-    char *result = malloc(result_len + 1);
-    strncpy(result, s + st, result_len);
-    result[result_len] = '\0';
-    return result;
+    char *result = rt_alloc_string(result_len);
+    memcpy(result, str + st, result_len);
+    return value_box(VALUE_TAG_STRING, result);
 }
 
-// Simple runtime list structure (for POC - stores doubles)
-struct RuntimeList {
-    double *elements;
-    int count;
-    int capacity;
-};
+RuntimeList *rt_alloc_list(int capacity) {
+    RuntimeList *list = malloc(sizeof(RuntimeList));
+    list->capacity = capacity > 8 ? capacity : 8;
+    list->count = 0;
+    list->shared = 0;
+    list->elements = malloc(list->capacity * sizeof(Value));
+    rt_stats_alloc(sizeof(RuntimeList));
+    rt_stats_alloc(list->capacity * sizeof(Value));
+    return list;
+}
 
-void print_list(RuntimeList *lst) {
-    if (!lst) {
-        printf("Result: ()\n");
-        return;
+static void ensure_capacity(RuntimeList *lst) {
+    if (lst->count >= lst->capacity) {
+        rt_stats_realloc(lst->capacity * sizeof(Value), 2 * lst->capacity * sizeof(Value));
+        lst->capacity *= 2;
+        lst->elements = realloc(lst->elements, lst->capacity * sizeof(Value));
     }
+}
 
-    printf("Result: (");
-    for (int i = 0; i < lst->count; i++) {
-        if (i > 0) printf(" ");
-        printf("%.0f", lst->elements[i]);
+void rt_list_reserve(RuntimeList *list, int extra) {
+    if (list->count + extra > list->capacity) {
+        size_t old_bytes = list->capacity * sizeof(Value);
+        while (list->count + extra > list->capacity) {
+            list->capacity *= 2;
+        }
+        rt_stats_realloc(old_bytes, list->capacity * sizeof(Value));
+        list->elements = realloc(list->elements, list->capacity * sizeof(Value));
     }
-    printf(")\n");
 }
 
-RuntimeList* create_list() {
-    RuntimeList *list = malloc(sizeof(RuntimeList));
-    list->capacity = 8;
-    list->count = 0;
-    list->elements = malloc(list->capacity * sizeof(double));
-    return list;
+// Builtins make their lists here rather than through create_list, so the
+// list counts as theirs in the stats
+static Value new_list(unsigned tag) {
+    return value_box(tag, rt_alloc_list(8));
 }
 
-RuntimeList* cons(double elem, RuntimeList *lst) {
-    if (!lst) {
-        lst = create_list();
-    }
+Value create_list(void) {
+    RT_STATS_SCOPE(RT_STAT_CREATE_LIST);
+    return new_list(VALUE_TAG_LIST);
+}
 
-    if (lst->count >= lst->capacity) {
-        lst->capacity *= 2;
-        lst->elements = realloc(lst->elements, lst->capacity * sizeof(double));
+Value create_vector(void) {
+    RT_STATS_SCOPE(RT_STAT_CREATE_VECTOR);
+    return new_list(VALUE_TAG_VECTOR);
+}
+
+// Copy-on-write: a shared list is copied before an update, a unique one
+// is updated in place
+static Value unshare(Value lst, RuntimeList **out) {
+    RuntimeList *list = rt_as_list(lst);
+    if (!list) {
+        lst = new_list(VALUE_TAG_LIST);
+        list = value_as_pointer(lst);
+    } else if (list->shared) {
+        RuntimeList *copy = rt_alloc_list(list->count + 1);
+        memcpy(copy->elements, list->elements, list->count * sizeof(Value));
+        copy->count = list->count;
+        lst = value_box(value_tag(lst), copy);
+        list = copy;
     }
+    *out = list;
+    return lst;
+}
+
+Value cons(Value elem, Value lst) {
+    RT_STATS_SCOPE(RT_STAT_CONS);
+    RuntimeList *list;
+    lst = unshare(lst, &list);
+    ensure_capacity(list);
+    rt_share(elem);
 
     // Shift all elements right
-    for (int i = lst->count; i > 0; i--) {
-        lst->elements[i] = lst->elements[i-1];
-    }
-    lst->elements[0] = elem;
-    lst->count++;
+    memmove(list->elements + 1, list->elements, list->count * sizeof(Value));
+    list->elements[0] = elem;
+    list->count++;
 
     return lst;
 }
 
-double first(RuntimeList *lst) {
-    if (!lst || lst->count == 0) {
-        return 0.0;
+Value first(Value lst) {
+    RT_STATS_SCOPE(RT_STAT_FIRST);
+    LazySeq *seq = rt_as_lazy_seq(lst);
+    if (seq) {
+        return rt_lazy_first(seq);
+    }
+
+    RuntimeList *list = rt_as_list(lst);
+    if (!list || list->count == 0) {
+        return value_from_double(0.0);
     }
-    return lst->elements[0];
+    return list->elements[0];
 }
 
-RuntimeList* rest(RuntimeList *lst) {
-    if (!lst || lst->count <= 1) {
-        return create_list();
+Value rest(Value lst) {
+    RT_STATS_SCOPE(RT_STAT_REST);
+    LazySeq *seq = rt_as_lazy_seq(lst);
+    if (seq) {
+        return rt_lazy_rest(seq);
     }
 
-    RuntimeList *result = create_list();
-    for (int i = 1; i < lst->count; i++) {
-        if (result->count >= result->capacity) {
-            result->capacity *= 2;
-            result->elements = realloc(result->elements, result->capacity * sizeof(double));
+    RuntimeList *list = rt_as_list(lst);
+    if (list && !list->shared) {
+        // Unique: drop the head in place, keeping the buffer
+        if (list->count > 0) {
+            list->count--;
+            memmove(list->elements, list->elements + 1, list->count * sizeof(Value));
         }
-        result->elements[result->count++] = lst->elements[i];
+        return value_box(VALUE_TAG_LIST, list);
+    }
+
+    Value result = new_list(VALUE_TAG_LIST);
+    if (!list || list->count <= 1) {
+        return result;
+    }
+
+    RuntimeList *out = value_as_pointer(result);
+    for (int i = 1; i < list->count; i++) {
+        ensure_capacity(out);
+        out->elements[out->count++] = list->elements[i];
     }
 
     return result;
 }
 
-RuntimeList* append_elem(RuntimeList *lst, double elem) {
-    if (!lst) {
-        lst = create_list();
+Value append_elem(Value lst, Value elem) {
+    RT_STATS_SCOPE(RT_STAT_APPEND);
+    RuntimeList *list;
+    lst = unshare(lst, &list);
+    ensure_capacity(list);
+    rt_share(elem);
+    list->elements[list->count++] = elem;
+    return lst;
+}
+
+// Out of line rt_share for generated code
+Value share_value(Value v) {
+    rt_share(v);
+    return v;
+}
+
+// `into` fills a copy so the target the caller passed stays unchanged
+Value copy_collection(Value coll) {
+    RT_STATS_SCOPE(RT_STAT_COPY_COLLECTION);
+    RuntimeList *list = rt_as_list(coll);
+    if (!list) {
+        return new_list(VALUE_TAG_VECTOR);
+    }
+    RuntimeList *copy = rt_alloc_list(list->count);
+    memcpy(copy->elements, list->elements, list->count * sizeof(Value));
+    copy->count = list->count;
+    return value_box(value_tag(coll), copy);
+}
+
+// Sizes an `into` target for every element of a list source up front
+Value into_reserve(Value target, Value source) {
+    RuntimeList *dst = rt_as_list(target);
+    RuntimeList *src = rt_as_list(source);
+    if (dst && src) {
+        rt_list_reserve(dst, src->count);
     }
+    return target;
+}
 
-    if (lst->count >= lst->capacity) {
-        lst->capacity *= 2;
-        lst->elements = realloc(lst->elements, lst->capacity * sizeof(double));
+double list_count(Value lst) {
+    RuntimeList *list = rt_as_list(lst);
+    if (list) return (double)list->count;
+
+    // Lazy seqs are counted without being realized
+    SeqCursor cursor;
+    const Value *span;
+    long n = 0;
+    int taken;
+    rt_cursor_init(&cursor, lst);
+    while ((taken = rt_cursor_span(&cursor, &span, LAZY_CHUNK_SIZE)) > 0) {
+        n += taken;
+    }
+    return (double)n;
+}
+
+// Structural equality for `=` once either side is a boxed value
+long value_equals(Value a, Value b) {
+    if (a == b) {
+        return 1;
+    }
+    if (value_is_number(a) || value_is_number(b)) {
+        return value_is_number(a) && value_is_number(b) &&
+               value_as_double(a) == value_as_double(b);
     }
 
-    lst->elements[lst->count++] = elem;
-    return lst;
+    unsigned tag_a = value_tag(a);
+    unsigned tag_b = value_tag(b);
+
+    // Interned, so identity was already checked above
+    if (tag_a == VALUE_TAG_KEYWORD || tag_b == VALUE_TAG_KEYWORD) {
+        return 0;
+    }
+
+    if (tag_a == VALUE_TAG_STRING || tag_a == VALUE_TAG_SYMBOL) {
+        return tag_a == tag_b &&
+               strcmp(value_as_pointer(a), value_as_pointer(b)) == 0;
+    }
+
+    if (tag_a == VALUE_TAG_MAP || tag_b == VALUE_TAG_MAP) {
+        return tag_a == tag_b &&
+               rt_map_equals(value_as_pointer(a), value_as_pointer(b));
+    }
+
+    if (!rt_is_seq(a) || !rt_is_seq(b)) {
+        return 0;
+    }
+
+    RuntimeList *la = rt_as_list(a);
+    RuntimeList *lb = rt_as_list(b);
+    if (la && lb && la->count != lb->count) {
+        return 0;
+    }
+
+    // Lists, vectors and lazy seqs compare element by element
+    SeqCursor ca, cb;
+    Value x, y;
+    rt_cursor_init(&ca, a);
+    rt_cursor_init(&cb, b);
+    for (;;) {
+        int has_x = rt_cursor_next(&ca, &x);
+        int has_y = rt_cursor_next(&cb, &y);
+        if (!has_x || !has_y) {
+            return has_x == has_y;
+        }
+        if (!value_equals(x, y)) {
+            return 0;
+        }
+    }
 }
 
-double list_count(RuntimeList *lst) {
-    if (!lst) return 0.0;
-    return (double)lst->count;
+// Generic count over every collection type
+double count(Value coll) {
+    RT_STATS_SCOPE(RT_STAT_COUNT);
+    if (value_has_tag(coll, VALUE_TAG_MAP)) {
+        return (double)((RuntimeMap *)value_as_pointer(coll))->count;
+    }
+    if (value_has_tag(coll, VALUE_TAG_STRING)) {
+        return (double)strlen(value_as_pointer(coll));
+    }
+    return list_count(coll);
 }
@@ -0,0 +1,281 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "runtime.h"
+
+// Work-stealing scheduler.
+//
+// Every worker owns a Chase-Lev deque: it pushes and pops tasks at the
+// bottom, idle workers steal from the top. The thread that starts the pool
+// (the program's main thread) is worker 0, so tasks it spawns land in its
+// own deque. A thread waiting for a task never blocks while there is work:
+// it runs tasks from its own deque or steals, which also keeps nested
+// parallelism (a future inside a pmap) from deadlocking.
+//
+// CLJC_THREADS overrides the worker count, which defaults to the number of
+// online cores.
+
+#define MAX_WORKERS 256
+#define INITIAL_DEQUE_SIZE 64
+#define IDLE_SPINS 64
+
+typedef struct DequeArray {
+    long mask;
+    _Atomic(RtTask *) slots[];
+} DequeArray;
+
+typedef struct Deque {
+    atomic_long top;
+    atomic_long bottom;
+    _Atomic(DequeArray *) array;
+} Deque;
+
+typedef struct Worker {
+    Deque deque;
+    unsigned seed;
+} Worker;
+
+static Worker workers[MAX_WORKERS];
+static int worker_count;
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+static _Thread_local int current_worker = -1;
+
+static pthread_mutex_t idle_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t idle_cond = PTHREAD_COND_INITIALIZER;
+static atomic_int sleepers;
+static atomic_long work_epoch;
+
+static DequeArray *alloc_deque_array(long size) {
+    DequeArray *a = malloc(sizeof(DequeArray) + size * sizeof(RtTask *));
+    a->mask = size - 1;
+    return a;
+}
+
+static void deque_init(Deque *q) {
+    atomic_init(&q->top, 0);
+    atomic_init(&q->bottom, 0);
+    atomic_init(&q->array, alloc_deque_array(INITIAL_DEQUE_SIZE));
+}
+
+// Old arrays are never freed: a thief may still be reading one
+static DequeArray *deque_grow(Deque *q, DequeArray *a, long top, long bottom) {
+    DequeArray *bigger = alloc_deque_array((a->mask + 1) * 2);
+    for (long i = top; i < bottom; i++) {
+        RtTask *task = atomic_load_explicit(&a->slots[i & a->mask], memory_order_relaxed);
+        atomic_store_explicit(&bigger->slots[i & bigger->mask], task, memory_order_relaxed);
+    }
+    atomic_store_explicit(&q->array, bigger, memory_order_release);
+    return bigger;
+}
+
+// Owner only
+static void deque_push(Deque *q, RtTask *task) {
+    long b = atomic_load_explicit(&q->bottom, memory_order_relaxed);
+    long t = atomic_load_explicit(&q->top, memory_order_acquire);
+    DequeArray *a = atomic_load_explicit(&q->array, memory_order_relaxed);
+    if (b - t > a->mask) {
+        a = deque_grow(q, a, t, b);
+    }
+    atomic_store_explicit(&a->slots[b & a->mask], task, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&q->bottom, b + 1, memory_order_relaxed);
+}
+
+// Owner only
+static RtTask *deque_pop(Deque *q) {
+    long b = atomic_load_explicit(&q->bottom, memory_order_relaxed) - 1;
+    DequeArray *a = atomic_load_explicit(&q->array, memory_order_relaxed);
+    atomic_store_explicit(&q->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    long t = atomic_load_explicit(&q->top, memory_order_relaxed);
+
+    if (t > b) {
+        atomic_store_explicit(&q->bottom, b + 1, memory_order_relaxed);
+        return NULL;
+    }
+
+    RtTask *task = atomic_load_explicit(&a->slots[b & a->mask], memory_order_relaxed);
+    if (t == b) {
+        // Last task: race the thieves for it
+        if (!atomic_compare_exchange_strong_explicit(&q->top, &t, t + 1,
+                                                     memory_order_seq_cst,
+                                                     memory_order_relaxed)) {
+            task = NULL;
+        }
+        atomic_store_explicit(&q->bottom, b + 1, memory_order_relaxed);
+    }
+    return task;
+}
+
+// Any thread
+static RtTask *deque_steal(Deque *q) {
+    long t = atomic_load_explicit(&q->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    long b = atomic_load_explicit(&q->bottom, memory_order_acquire);
+    if (t >= b) {
+        return NULL;
+    }
+
+    DequeArray *a = atomic_load_explicit(&q->array, memory_order_acquire);
+    RtTask *task = atomic_load_explicit(&a->slots[t & a->mask], memory_order_relaxed);
+    if (!atomic_compare_exchange_strong_explicit(&q->top, &t, t + 1,
+                                                 memory_order_seq_cst,
+                                                 memory_order_relaxed)) {
+        return NULL;
+    }
+    return task;
+}
+
+static long deque_size(Deque *q) {
+    return atomic_load_explicit(&q->bottom, memory_order_relaxed) -
+           atomic_load_explicit(&q->top, memory_order_relaxed);
+}
+
+// Sleeps until new work is published. Every push bumps work_epoch before
+// it looks for sleepers, and a sleeper counts itself before it rechecks
+// the epoch, so either the pusher sees the sleeper and signals or the
+// sleeper sees the new epoch and goes back to stealing.
+static void idle_wait(long seen) {
+    pthread_mutex_lock(&idle_lock);
+    atomic_fetch_add(&sleepers, 1);
+    while (atomic_load(&work_epoch) == seen) {
+        pthread_cond_wait(&idle_cond, &idle_lock);
+    }
+    atomic_fetch_sub(&sleepers, 1);
+    pthread_mutex_unlock(&idle_lock);
+}
+
+static void publish_work(void) {
+    atomic_fetch_add(&work_epoch, 1);
+    if (atomic_load(&sleepers) > 0) {
+        pthread_mutex_lock(&idle_lock);
+        pthread_cond_signal(&idle_cond);
+        pthread_mutex_unlock(&idle_lock);
+    }
+}
+
+static RtTask *find_task(int self) {
+    RtTask *task = deque_pop(&workers[self].deque);
+    if (task) {
+        return task;
+    }
+
+    // Start at a random victim so thieves spread out
+    unsigned start = rand_r(&workers[self].seed) % worker_count;
+    for (int i = 0; i < worker_count; i++) {
+        int victim = (int)((start + i) % worker_count);
+        if (victim == self) continue;
+        task = deque_steal(&workers[victim].deque);
+        if (task) {
+            // More left behind: hand it to another sleeper
+            if (deque_size(&workers[victim].deque) > 0) {
+                publish_work();
+            }
+            return task;
+        }
+    }
+    return NULL;
+}
+
+static void run_task(RtTask *task) {
+    // A detached task may be freed or running elsewhere once run returns
+    int detached = task->detached;
+    task->run(task);
+    if (!detached) {
+        atomic_store_explicit(&task->done, 1, memory_order_release);
+    }
+}
+
+static void *worker_main(void *arg) {
+    current_worker = (int)(long)arg;
+    int idle = 0;
+
+    for (;;) {
+        long seen = atomic_load(&work_epoch);
+        RtTask *task = find_task(current_worker);
+        if (task) {
+            run_task(task);
+            idle = 0;
+            continue;
+        }
+
+        if (++idle < IDLE_SPINS) {
+            sched_yield();
+            continue;
+        }
+        idle_wait(seen);
+        idle = 0;
+    }
+    return NULL;
+}
+
+static void start_pool(void) {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    const char *env = getenv("CLJC_THREADS");
+    if (env && atoi(env) > 0) {
+        cores = atoi(env);
+    }
+    if (cores < 1) cores = 1;
+    if (cores > MAX_WORKERS) cores = MAX_WORKERS;
+    worker_count = (int)cores;
+
+    for (int i = 0; i < worker_count; i++) {
+        deque_init(&workers[i].deque);
+        workers[i].seed = (unsigned)i * 2654435761u + 1;
+    }
+    current_worker = 0;
+
+    for (int i = 1; i < worker_count; i++) {
+        pthread_t thread;
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        if (pthread_create(&thread, &attr, worker_main, (void *)(long)i) != 0) {
+            fprintf(stderr, "Error: Could not start worker thread\n");
+            exit(1);
+        }
+        pthread_attr_destroy(&attr);
+    }
+}
+
+int rt_worker_count(void) {
+    pthread_once(&pool_once, start_pool);
+    return worker_count;
+}
+
+void rt_spawn(RtTask *task) {
+    pthread_once(&pool_once, start_pool);
+    if (!task->detached) {
+        atomic_store_explicit(&task->done, 0, memory_order_relaxed);
+    }
+
+    if (current_worker < 0) {
+        // Not a pool thread: nowhere to queue, so run it here
+        run_task(task);
+        return;
+    }
+
+    deque_push(&workers[current_worker].deque, task);
+    publish_work();
+}
+
+// Runs one pending task on the calling thread, or yields if there is none
+int rt_help(void) {
+    RtTask *task = current_worker >= 0 ? find_task(current_worker) : NULL;
+    if (!task) {
+        sched_yield();
+        return 0;
+    }
+    run_task(task);
+    return 1;
+}
+
+void rt_wait(RtTask *task) {
+    while (!atomic_load_explicit(&task->done, memory_order_acquire)) {
+        rt_help();
+    }
+}
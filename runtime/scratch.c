@@ -0,0 +1,90 @@
+#include <stddef.h>
+#include <stdlib.h>
+#include "runtime.h"
+
+// Scratch regions for collections that escape analysis (src/escape.c)
+// proved never outlive the call that built them. A function with such
+// collections takes a mark on entry and releases back to it on return, so
+// they cost a pointer bump instead of two mallocs and are never freed one
+// by one.
+//
+// A region is a stack of blocks. Releasing pops the blocks allocated since
+// the mark and keeps the last one popped as a spare, so a function called
+// in a loop does not allocate a block per call.
+
+#define SCRATCH_BLOCK_SIZE (64 * 1024)
+#define SCRATCH_ALIGN 16
+
+struct ScratchBlock {
+    ScratchBlock *prev;
+    char *limit;
+    _Alignas(SCRATCH_ALIGN) char data[];
+};
+
+static void *scratch_alloc(Scratch *scratch, size_t size) {
+    size = (size + SCRATCH_ALIGN - 1) & ~(size_t)(SCRATCH_ALIGN - 1);
+    if (!scratch->block || (size_t)(scratch->block->limit - scratch->top) < size) {
+        ScratchBlock *block = scratch->spare;
+        if (block && (size_t)(block->limit - block->data) >= size) {
+            scratch->spare = NULL;
+        } else {
+            size_t capacity = size > SCRATCH_BLOCK_SIZE ? size : SCRATCH_BLOCK_SIZE;
+            block = malloc(sizeof(ScratchBlock) + capacity);
+            block->limit = block->data + capacity;
+        }
+        block->prev = scratch->block;
+        scratch->block = block;
+        scratch->top = block->data;
+    }
+
+    void *p = scratch->top;
+    scratch->top += size;
+    return p;
+}
+
+void *scratch_mark(void) {
+    return rt_current_scratch()->top;
+}
+
+void scratch_release(void *mark) {
+    Scratch *scratch = rt_current_scratch();
+    char *top = mark;
+    while (scratch->block && !(top >= scratch->block->data && top <= scratch->block->limit)) {
+        ScratchBlock *block = scratch->block;
+        scratch->block = block->prev;
+        free(scratch->spare);
+        scratch->spare = block;
+    }
+    scratch->top = scratch->block ? top : NULL;
+}
+
+void rt_scratch_free(Scratch *scratch) {
+    while (scratch->block) {
+        ScratchBlock *block = scratch->block;
+        scratch->block = block->prev;
+        free(block);
+    }
+    free(scratch->spare);
+    scratch->spare = NULL;
+    scratch->top = NULL;
+}
+
+// The header and elements share one allocation. `count` is set up front:
+// the compiler stores each element straight into `elements`, sharing it.
+static RuntimeList *scratch_list(long count) {
+    RuntimeList *list = scratch_alloc(rt_current_scratch(),
+                                      sizeof(RuntimeList) + count * sizeof(Value));
+    list->elements = (Value *)(list + 1);
+    list->count = (int)count;
+    list->capacity = (int)count;
+    list->shared = 1;  // Never updated in place: it must not outlive the call
+    return list;
+}
+
+Value create_list_scratch(long count) {
+    return value_box(VALUE_TAG_LIST, scratch_list(count));
+}
+
+Value create_vector_scratch(long count) {
+    return value_box(VALUE_TAG_VECTOR, scratch_list(count));
+}
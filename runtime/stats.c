@@ -0,0 +1,171 @@
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include "runtime.h"
+
+// Runtime statistics, printed to stderr when the program exits.
+//
+// Off unless CLJC_STATS is set (to 1, summary or json) or the program was
+// compiled with --stats, which also counts calls of every defn. Each
+// instrumented builtin marks itself as the thread's current builtin for
+// the duration of the call, and allocations are charged to whichever
+// builtin is current. Heap bytes are what runtime values hold. Lists and
+// strings are never freed, so the peak is normally the final figure.
+// Only list buffer growth changes it along the way.
+
+int rt_stats_enabled = 0;
+
+static int json_format = 0;
+static const RtDefnStats *defn_stats = NULL;
+
+static const char *stat_names[RT_STAT_BUILTIN_COUNT] = {
+    [RT_STAT_OTHER] = "(other)",
+    [RT_STAT_CREATE_LIST] = "create_list",
+    [RT_STAT_CREATE_VECTOR] = "create_vector",
+    [RT_STAT_CONS] = "cons",
+    [RT_STAT_FIRST] = "first",
+    [RT_STAT_REST] = "rest",
+    [RT_STAT_APPEND] = "append_elem",
+    [RT_STAT_COUNT] = "count",
+    [RT_STAT_COPY_COLLECTION] = "copy_collection",
+    [RT_STAT_STR_LENGTH] = "str_length",
+    [RT_STAT_STR_CHAR_AT] = "str_char_at",
+    [RT_STAT_STR_CONCAT] = "str_concat",
+    [RT_STAT_SUBSTRING] = "substring",
+    [RT_STAT_MAP_ASSOC] = "map_assoc",
+    [RT_STAT_MAP_DISSOC] = "map_dissoc",
+    [RT_STAT_MAP_GET] = "map_get",
+};
+
+static _Atomic int64_t calls[RT_STAT_BUILTIN_COUNT];
+static _Atomic int64_t allocs[RT_STAT_BUILTIN_COUNT];
+static _Atomic int64_t bytes[RT_STAT_BUILTIN_COUNT];
+static _Atomic int64_t list_reallocs;
+static _Atomic int64_t heap_bytes;
+static _Atomic int64_t peak_heap_bytes;
+
+static _Thread_local int current_stat = RT_STAT_OTHER;
+
+int rt_stats_enter(RtStat stat) {
+    atomic_fetch_add_explicit(&calls[stat], 1, memory_order_relaxed);
+    int saved = current_stat;
+    current_stat = stat;
+    return saved;
+}
+
+void rt_stats_restore(int saved) {
+    current_stat = saved;
+}
+
+static void add_heap_bytes(int64_t delta) {
+    int64_t now = atomic_fetch_add_explicit(&heap_bytes, delta, memory_order_relaxed) + delta;
+    int64_t peak = atomic_load_explicit(&peak_heap_bytes, memory_order_relaxed);
+    while (now > peak &&
+           !atomic_compare_exchange_weak_explicit(&peak_heap_bytes, &peak, now,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+void rt_stats_record_alloc(size_t size) {
+    atomic_fetch_add_explicit(&allocs[current_stat], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&bytes[current_stat], (int64_t)size, memory_order_relaxed);
+    add_heap_bytes((int64_t)size);
+}
+
+void rt_stats_record_realloc(size_t old_bytes, size_t new_bytes) {
+    atomic_fetch_add_explicit(&list_reallocs, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&allocs[current_stat], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&bytes[current_stat], (int64_t)new_bytes, memory_order_relaxed);
+    add_heap_bytes((int64_t)new_bytes - (int64_t)old_bytes);
+}
+
+static long peak_rss_kb(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;  // Bytes on macOS
+#else
+    return usage.ru_maxrss;
+#endif
+}
+
+static int64_t load(_Atomic int64_t *counter) {
+    return atomic_load_explicit(counter, memory_order_relaxed);
+}
+
+static void print_summary(FILE *out) {
+    fprintf(out, "\n%-20s %12s %12s %14s\n", "builtin", "calls", "allocs", "bytes");
+    for (int i = 0; i < RT_STAT_BUILTIN_COUNT; i++) {
+        if (load(&calls[i]) || load(&allocs[i])) {
+            fprintf(out, "%-20s %12lld %12lld %14lld\n", stat_names[i],
+                    (long long)load(&calls[i]), (long long)load(&allocs[i]),
+                    (long long)load(&bytes[i]));
+        }
+    }
+    fprintf(out, "\nlist reallocations   %12lld\n", (long long)load(&list_reallocs));
+    fprintf(out, "heap bytes           %12lld (peak %lld)\n",
+            (long long)load(&heap_bytes), (long long)load(&peak_heap_bytes));
+    fprintf(out, "peak RSS KB          %12ld\n", peak_rss_kb());
+
+    if (defn_stats) {
+        fprintf(out, "\n%-20s %12s\n", "defn", "calls");
+        for (int64_t i = 0; i < defn_stats->count; i++) {
+            fprintf(out, "%-20s %12lld\n", defn_stats->counters[i].name,
+                    (long long)*defn_stats->counters[i].calls);
+        }
+    }
+}
+
+static void print_json(FILE *out) {
+    fprintf(out, "{\"builtins\": {");
+    int first = 1;
+    for (int i = 0; i < RT_STAT_BUILTIN_COUNT; i++) {
+        if (load(&calls[i]) || load(&allocs[i])) {
+            fprintf(out, "%s\n  \"%s\": {\"calls\": %lld, \"allocs\": %lld, \"bytes\": %lld}",
+                    first ? "" : ",", stat_names[i], (long long)load(&calls[i]),
+                    (long long)load(&allocs[i]), (long long)load(&bytes[i]));
+            first = 0;
+        }
+    }
+    fprintf(out, "\n}, \"list_reallocs\": %lld, \"heap_bytes\": %lld, \"peak_heap_bytes\": %lld, "
+            "\"peak_rss_kb\": %ld, \"defns\": {",
+            (long long)load(&list_reallocs), (long long)load(&heap_bytes),
+            (long long)load(&peak_heap_bytes), peak_rss_kb());
+    for (int64_t i = 0; defn_stats && i < defn_stats->count; i++) {
+        fprintf(out, "%s\n  \"%s\": %lld", i ? "," : "", defn_stats->counters[i].name,
+                (long long)*defn_stats->counters[i].calls);
+    }
+    fprintf(out, "\n}}\n");
+}
+
+static void print_stats(void) {
+    if (json_format) {
+        print_json(stderr);
+    } else {
+        print_summary(stderr);
+    }
+}
+
+static void enable(void) {
+    if (!rt_stats_enabled) {
+        rt_stats_enabled = 1;
+        atexit(print_stats);
+    }
+}
+
+__attribute__((constructor))
+static void stats_from_environment(void) {
+    const char *mode = getenv("CLJC_STATS");
+    if (!mode || !*mode || strcmp(mode, "0") == 0) {
+        return;
+    }
+    json_format = strcmp(mode, "json") == 0;
+    enable();
+}
+
+// Called first thing in main by programs compiled with --stats
+void rt_stats_start(const RtDefnStats *defns) {
+    defn_stats = defns;
+    enable();
+}
@@ -1,4 +1,5 @@
 #include "arm64.h"
+#include "value.h"
 
 void emit_header(FILE *f) {
     fprintf(f, "    .section __TEXT,__text,regular,pure_instructions\n");
@@ -19,11 +20,25 @@ void emit_text_section_start(FILE *f) {
 void emit_function_start(FILE *f, const char *name) {
     fprintf(f, "    .globl %s\n", name);
     fprintf(f, "%s:\n", name);
+    fprintf(f, "    .cfi_startproc\n");
+}
+
+void emit_function_end(FILE *f) {
+    fprintf(f, "    .cfi_endproc\n");
 }
 
 void emit_function_prologue(FILE *f) {
+    emit_function_prologue_above(f, 0);
+}
+
+// Prologue of a function that already moved sp down by `extra` bytes for
+// slots above its frame record; the CFI lets unwinders walk through it
+void emit_function_prologue_above(FILE *f, int extra) {
     fprintf(f, "    stp x29, x30, [sp, #-16]!\n");
     fprintf(f, "    mov x29, sp\n");
+    fprintf(f, "    .cfi_def_cfa w29, %d\n", 16 + extra);
+    fprintf(f, "    .cfi_offset w30, %d\n", -8 - extra);
+    fprintf(f, "    .cfi_offset w29, %d\n", -16 - extra);
 }
 
 void emit_function_epilogue(FILE *f) {
@@ -46,6 +61,25 @@ void emit_pop_double(FILE *f, int dreg) {
     fprintf(f, "    ldr d%d, [sp], #16\n", dreg);
 }
 
+void emit_push_value(FILE *f, int xreg) {
+    fprintf(f, "    str x%d, [sp, #-16]!\n", xreg);
+}
+
+void emit_pop_value(FILE *f, int xreg) {
+    fprintf(f, "    ldr x%d, [sp], #16\n", xreg);
+}
+
+void emit_box_pointer(FILE *f, int xreg, unsigned tag) {
+    fprintf(f, "    movk x%d, #0x%x, lsl #48\n", xreg, tag);
+}
+
+void emit_load_imm32(FILE *f, int wreg, unsigned value) {
+    fprintf(f, "    mov w%d, #0x%x\n", wreg, value & 0xFFFF);
+    if (value >> 16) {
+        fprintf(f, "    movk w%d, #0x%x, lsl #16\n", wreg, value >> 16);
+    }
+}
+
 void emit_fadd(FILE *f) {
     fprintf(f, "    fadd d0, d0, d1\n");
 }
@@ -70,24 +104,150 @@ void emit_return(FILE *f) {
     fprintf(f, "    ret\n");
 }
 
+// Quoted for .file and .asciz, escaping what the assembler would misread
+static void emit_quoted(FILE *f, const char *s) {
+    fputc('"', f);
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') {
+            fputc('\\', f);
+        }
+        fputc(*s, f);
+    }
+    fputc('"', f);
+}
+
+// Source file of the .loc directives. The text bounds use L labels, which
+// stay out of the symbol table, so profilers do not show them as functions.
+void emit_debug_file(FILE *f, const char *dir, const char *name) {
+    fprintf(f, "    .file 1 ");
+    emit_quoted(f, dir);
+    fprintf(f, " ");
+    emit_quoted(f, name);
+    fprintf(f, "\nLtext_begin:\n");
+}
+
+void emit_loc(FILE *f, int line, int column) {
+    fprintf(f, "    .loc 1 %d %d\n", line, column);
+}
+
+// DWARF 4 compile unit covering Ltext_begin..Ltext_end. The assembler
+// writes the line table from the .loc directives; symbolizers find it
+// through this unit's DW_AT_stmt_list.
+void emit_debug_info(FILE *f, const char *dir, const char *name) {
+    fprintf(f, "Ltext_end:\n");
+    fprintf(f, "\n    .section __DWARF,__debug_abbrev,regular,debug\n");
+    fprintf(f, "    .byte 1\n");            // Abbreviation code
+    fprintf(f, "    .byte 0x11\n");         // DW_TAG_compile_unit
+    fprintf(f, "    .byte 0\n");            // DW_CHILDREN_no
+    fprintf(f, "    .byte 0x25, 0x08\n");   // DW_AT_producer, DW_FORM_string
+    fprintf(f, "    .byte 0x13, 0x05\n");   // DW_AT_language, DW_FORM_data2
+    fprintf(f, "    .byte 0x03, 0x08\n");   // DW_AT_name, DW_FORM_string
+    fprintf(f, "    .byte 0x10, 0x17\n");   // DW_AT_stmt_list, DW_FORM_sec_offset
+    fprintf(f, "    .byte 0x1b, 0x08\n");   // DW_AT_comp_dir, DW_FORM_string
+    fprintf(f, "    .byte 0x11, 0x01\n");   // DW_AT_low_pc, DW_FORM_addr
+    fprintf(f, "    .byte 0x12, 0x01\n");   // DW_AT_high_pc, DW_FORM_addr
+    fprintf(f, "    .byte 0, 0\n");
+    fprintf(f, "    .byte 0\n");
+
+    fprintf(f, "\n    .section __DWARF,__debug_info,regular,debug\n");
+    fprintf(f, "Ldebug_info_begin:\n");
+    fprintf(f, "    .long Ldebug_info_end - Ldebug_info_begin - 4\n");
+    fprintf(f, "    .short 4\n");           // DWARF version
+    fprintf(f, "    .long 0\n");            // Abbreviations offset
+    fprintf(f, "    .byte 8\n");            // Address size
+    fprintf(f, "    .byte 1\n");
+    fprintf(f, "    .asciz \"cljc\"\n");
+    fprintf(f, "    .short 0x8001\n");      // DW_LANG_Mips_Assembler, as for -g assembly
+    fprintf(f, "    .asciz ");
+    emit_quoted(f, name);
+    fprintf(f, "\n    .long 0\n");         // The only line table
+    fprintf(f, "    .asciz ");
+    emit_quoted(f, dir);
+    fprintf(f, "\n    .quad Ltext_begin\n");
+    fprintf(f, "    .quad Ltext_end\n");
+    fprintf(f, "Ldebug_info_end:\n");
+}
+
 void emit_comment(FILE *f, const char *comment) {
     fprintf(f, "    // %s\n", comment);
 }
 
 void emit_float_constant(FILE *f, const char *label, double value) {
     fprintf(f, "%s:\n", label);
-    fprintf(f, "    .double %f\n", value);
+    fprintf(f, "    .double %.17g\n", value);  // Round-trips exactly
 }
 
+// RuntimeString: the length word before the characters is computed by the
+// assembler, which also expands the escapes in `value`
 void emit_string_constant(FILE *f, const char *label, const char *value) {
+    fprintf(f, "    .p2align 3\n");
+    fprintf(f, "    .quad %s_end - %s - 1\n", label, label);
     fprintf(f, "%s:\n", label);
     fprintf(f, "    .asciz \"%s\"\n", value);
+    fprintf(f, "%s_end:\n", label);
+}
+
+void emit_keyword_constant(FILE *f, const char *label, const char *name, unsigned hash) {
+    fprintf(f, "    .p2align 3\n");
+    fprintf(f, "%s:\n", label);
+    fprintf(f, "    .quad 0x%x\n", hash);
+    fprintf(f, "    .asciz \"%s\"\n", name);
+}
+
+// Static RuntimeFunction: object header, code pointer, arity
+void emit_function_descriptor(FILE *f, const char *label, const char *code_label, int arity) {
+    fprintf(f, "    .p2align 3\n");
+    fprintf(f, "%s:\n", label);
+    fprintf(f, "    .quad %d\n", OBJECT_TYPE_FUNCTION);
+    fprintf(f, "    .quad %s\n", code_label);
+    fprintf(f, "    .quad %d\n", arity);
+}
+
+// 64-bit call counter at `label` and the function's name at `label`_name
+void emit_call_counter(FILE *f, const char *label, const char *name) {
+    fprintf(f, "    .p2align 3\n");
+    fprintf(f, "%s:\n", label);
+    fprintf(f, "    .quad 0\n");
+    fprintf(f, "%s_name:\n", label);
+    fprintf(f, "    .asciz \"%s\"\n", name);
+}
+
+// Then counter at `label`, else counter at `label`_else, adjacent
+void emit_branch_counter(FILE *f, const char *label) {
+    fprintf(f, "    .p2align 3\n");
+    fprintf(f, "%s:\n", label);
+    fprintf(f, "    .quad 0\n");
+    fprintf(f, "%s_else:\n", label);
+    fprintf(f, "    .quad 0\n");
+}
+
+// Atomic, since futures and go blocks call functions from several threads.
+// Clobbers x9-x11.
+void emit_increment_counter(FILE *f, const char *label) {
+    fprintf(f, "    adrp x9, %s@PAGE\n", label);
+    fprintf(f, "    add x9, x9, %s@PAGEOFF\n", label);
+    fprintf(f, "1:\n");
+    fprintf(f, "    ldxr x10, [x9]\n");
+    fprintf(f, "    add x10, x10, #1\n");
+    fprintf(f, "    stxr w11, x10, [x9]\n");
+    fprintf(f, "    cbnz w11, 1b\n");
+}
+
+// MemoCache: table pointer (created by the runtime), size bound, policy
+void emit_memo_cache(FILE *f, const char *label, long max_entries, int evict) {
+    fprintf(f, "    .p2align 3\n");
+    fprintf(f, "%s:\n", label);
+    fprintf(f, "    .quad 0\n");
+    fprintf(f, "    .quad %ld\n", max_entries);
+    fprintf(f, "    .quad %d\n", evict);
 }
 
 void emit_fcmp(FILE *f) {
     fprintf(f, "    fcmp d0, d1\n");
 }
 
+// Branch targets in functions are named L_..., a prefix Mach-O keeps out of
+// the symbol table, so profilers attribute their code to the function
 void emit_label(FILE *f, const char *label) {
     fprintf(f, "%s:\n", label);
 }
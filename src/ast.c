@@ -1,3 +1,4 @@
+#define _POSIX_C_SOURCE 200809L
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -7,6 +8,10 @@
 
 ASTNode *create_number_node(double value) {
     ASTNode *node = malloc(sizeof(ASTNode));
+    node->cse_slot = -1;
+    node->cse_reuse = 0;
+    node->line = 0;
+    node->column = 0;
     node->type = AST_NUMBER;
     node->as.number = value;
     return node;
@@ -14,29 +19,61 @@ ASTNode *create_number_node(double value) {
 
 ASTNode *create_symbol_node(const char *symbol) {
     ASTNode *node = malloc(sizeof(ASTNode));
+    node->cse_slot = -1;
+    node->cse_reuse = 0;
+    node->line = 0;
+    node->column = 0;
     node->type = AST_SYMBOL;
+    node->last_use = 0;
+    node->consumed = 0;
     node->as.symbol = strdup(symbol);
     return node;
 }
 
 ASTNode *create_string_node(const char *string) {
     ASTNode *node = malloc(sizeof(ASTNode));
+    node->cse_slot = -1;
+    node->cse_reuse = 0;
+    node->line = 0;
+    node->column = 0;
     node->type = AST_STRING;
     node->as.string = strdup(string);
     return node;
 }
 
+ASTNode *create_keyword_node(const char *name) {
+    ASTNode *node = malloc(sizeof(ASTNode));
+    node->cse_slot = -1;
+    node->cse_reuse = 0;
+    node->line = 0;
+    node->column = 0;
+    node->type = AST_KEYWORD;
+    node->as.keyword = strdup(name);
+    return node;
+}
+
 ASTNode *create_list_node(void) {
     ASTNode *node = malloc(sizeof(ASTNode));
+    node->cse_slot = -1;
+    node->cse_reuse = 0;
+    node->line = 0;
+    node->column = 0;
     node->type = AST_LIST;
+    node->scratch = 0;
     node->as.list.capacity = INITIAL_LIST_CAPACITY;
     node->as.list.count = 0;
     node->as.list.elements = malloc(INITIAL_LIST_CAPACITY * sizeof(ASTNode *));
     return node;
 }
 
+ASTNode *create_map_node(void) {
+    ASTNode *node = create_list_node();
+    node->type = AST_MAP;
+    return node;
+}
+
 void add_to_list(ASTNode *list, ASTNode *element) {
-    if (list->type != AST_LIST) {
+    if (list->type != AST_LIST && list->type != AST_MAP) {
         fprintf(stderr, "Error: Trying to add element to non-list node\n");
         return;
     }
@@ -50,6 +87,35 @@ void add_to_list(ASTNode *list, ASTNode *element) {
     list->as.list.elements[list->as.list.count++] = element;
 }
 
+// Deep copy with the source positions; analysis marks are not copied
+ASTNode *copy_ast(ASTNode *node) {
+    ASTNode *copy = NULL;
+    switch (node->type) {
+        case AST_NUMBER:
+            copy = create_number_node(node->as.number);
+            break;
+        case AST_SYMBOL:
+            copy = create_symbol_node(node->as.symbol);
+            break;
+        case AST_STRING:
+            copy = create_string_node(node->as.string);
+            break;
+        case AST_KEYWORD:
+            copy = create_keyword_node(node->as.keyword);
+            break;
+        case AST_LIST:
+        case AST_MAP:
+            copy = node->type == AST_LIST ? create_list_node() : create_map_node();
+            for (int i = 0; i < node->as.list.count; i++) {
+                add_to_list(copy, copy_ast(node->as.list.elements[i]));
+            }
+            break;
+    }
+    copy->line = node->line;
+    copy->column = node->column;
+    return copy;
+}
+
 void free_ast(ASTNode *node) {
     if (!node) return;
 
@@ -60,7 +126,11 @@ void free_ast(ASTNode *node) {
         case AST_STRING:
             free(node->as.string);
             break;
+        case AST_KEYWORD:
+            free(node->as.keyword);
+            break;
         case AST_LIST:
+        case AST_MAP:
             for (int i = 0; i < node->as.list.count; i++) {
                 free_ast(node->as.list.elements[i]);
             }
@@ -73,40 +143,53 @@ void free_ast(ASTNode *node) {
     free(node);
 }
 
-static void print_indent(int indent) {
+static void print_indent(FILE *f, int indent) {
     for (int i = 0; i < indent; i++) {
-        printf("  ");
+        fprintf(f, "  ");
     }
 }
 
-void print_ast(ASTNode *node, int indent) {
+void print_ast(FILE *f, ASTNode *node, int indent) {
     if (!node) {
-        print_indent(indent);
-        printf("(null)\n");
+        print_indent(f, indent);
+        fprintf(f, "(null)\n");
         return;
     }
 
     switch (node->type) {
         case AST_NUMBER:
-            print_indent(indent);
-            printf("Number: %.2f\n", node->as.number);
+            print_indent(f, indent);
+            fprintf(f, "Number: %.2f\n", node->as.number);
             break;
 
         case AST_SYMBOL:
-            print_indent(indent);
-            printf("Symbol: %s\n", node->as.symbol);
+            print_indent(f, indent);
+            fprintf(f, "Symbol: %s\n", node->as.symbol);
             break;
 
         case AST_STRING:
-            print_indent(indent);
-            printf("String: \"%s\"\n", node->as.string);
+            print_indent(f, indent);
+            fprintf(f, "String: \"%s\"\n", node->as.string);
+            break;
+
+        case AST_KEYWORD:
+            print_indent(f, indent);
+            fprintf(f, "Keyword: :%s\n", node->as.keyword);
             break;
 
         case AST_LIST:
-            print_indent(indent);
-            printf("List (%d elements):\n", node->as.list.count);
+            print_indent(f, indent);
+            fprintf(f, "List (%d elements):\n", node->as.list.count);
+            for (int i = 0; i < node->as.list.count; i++) {
+                print_ast(f, node->as.list.elements[i], indent + 1);
+            }
+            break;
+
+        case AST_MAP:
+            print_indent(f, indent);
+            fprintf(f, "Map (%d entries):\n", node->as.list.count / 2);
             for (int i = 0; i < node->as.list.count; i++) {
-                print_ast(node->as.list.elements[i], indent + 1);
+                print_ast(f, node->as.list.elements[i], indent + 1);
             }
             break;
     }
@@ -1,30 +1,51 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include "codegen.h"
 #include "arm64.h"
+#include "cse.h"
+#include "escape.h"
+#include "inline.h"
+#include "partial_eval.h"
+#include "reachability.h"
+#include "time_report.h"
+#include "uniqueness.h"
+#include "value.h"
+#include "runtime.h"
 
 #define INITIAL_FLOAT_CAPACITY 16
 #define INITIAL_STRING_CAPACITY 16
+#define INITIAL_KEYWORD_CAPACITY 16
 #define INITIAL_VAR_CAPACITY 16
+#define INITIAL_BRANCH_CAPACITY 16
+#define COLD_RATIO 16  // An if arm taken under 1/16 as often as the other is cold
 
-static void init_codegen(CodeGen *cg, const char *output_file) {
-    cg->output = fopen(output_file, "w");
-    if (!cg->output) {
-        fprintf(stderr, "Error: Could not open output file: %s\n", output_file);
-        exit(1);
-    }
+static void init_codegen(CodeGen *cg, FILE *output, const CodegenOptions *options) {
+    cg->output = output;
+    cg->options = options;
     cg->symbols = create_symbol_table();
     cg->label_counter = 0;
+    cg->functions_emitted = 0;
+    cg->loc_line = 0;
+    cg->loc_column = 0;
     cg->float_capacity = INITIAL_FLOAT_CAPACITY;
     cg->float_count = 0;
     cg->float_constants = malloc(INITIAL_FLOAT_CAPACITY * sizeof(FloatConstant *));
     cg->string_capacity = INITIAL_STRING_CAPACITY;
     cg->string_count = 0;
     cg->string_constants = malloc(INITIAL_STRING_CAPACITY * sizeof(StringConstant *));
+    cg->keyword_capacity = INITIAL_KEYWORD_CAPACITY;
+    cg->keyword_count = 0;
+    cg->keyword_constants = malloc(INITIAL_KEYWORD_CAPACITY * sizeof(KeywordConstant *));
     cg->var_capacity = INITIAL_VAR_CAPACITY;
     cg->var_count = 0;
     cg->variables = malloc(INITIAL_VAR_CAPACITY * sizeof(Variable *));
+    cg->branch_capacity = INITIAL_BRANCH_CAPACITY;
+    cg->branch_count = 0;
+    cg->branch_counters = malloc(INITIAL_BRANCH_CAPACITY * sizeof(BranchCounter *));
+    cg->cold_output = NULL;
 }
 
 static void cleanup_codegen(CodeGen *cg) {
@@ -39,14 +60,24 @@ static void cleanup_codegen(CodeGen *cg) {
         free(cg->string_constants[i]);
     }
     free(cg->string_constants);
+    for (int i = 0; i < cg->keyword_count; i++) {
+        free(cg->keyword_constants[i]->name);
+        free(cg->keyword_constants[i]->label);
+        free(cg->keyword_constants[i]);
+    }
+    free(cg->keyword_constants);
     for (int i = 0; i < cg->var_count; i++) {
         free(cg->variables[i]->name);
         free(cg->variables[i]->label);
         free(cg->variables[i]);
     }
     free(cg->variables);
+    for (int i = 0; i < cg->branch_count; i++) {
+        free(cg->branch_counters[i]->label);
+        free(cg->branch_counters[i]);
+    }
+    free(cg->branch_counters);
     free_symbol_table(cg->symbols);
-    fclose(cg->output);
 }
 
 static const char* add_float_constant(CodeGen *cg, double value) {
@@ -93,7 +124,32 @@ static const char* add_string_constant(CodeGen *cg, const char *value) {
     return sc->label;
 }
 
-static void add_variable(CodeGen *cg, const char *name, double value) {
+// Keywords are interned here: one static record per distinct name, so the
+// runtime can compare them by pointer and read their hash without hashing.
+static KeywordConstant* add_keyword_constant(CodeGen *cg, const char *name) {
+    for (int i = 0; i < cg->keyword_count; i++) {
+        if (strcmp(cg->keyword_constants[i]->name, name) == 0) {
+            return cg->keyword_constants[i];
+        }
+    }
+
+    if (cg->keyword_count >= cg->keyword_capacity) {
+        cg->keyword_capacity *= 2;
+        cg->keyword_constants = realloc(cg->keyword_constants,
+                                        cg->keyword_capacity * sizeof(KeywordConstant *));
+    }
+
+    KeywordConstant *kc = malloc(sizeof(KeywordConstant));
+    kc->name = strdup(name);
+    kc->hash = value_hash_keyword(name);
+    kc->label = malloc(32);
+    sprintf(kc->label, ".L_kw_%d", cg->label_counter++);
+
+    cg->keyword_constants[cg->keyword_count++] = kc;
+    return kc;
+}
+
+static Variable *add_variable(CodeGen *cg, const char *name, double value) {
     if (cg->var_count >= cg->var_capacity) {
         cg->var_capacity *= 2;
         cg->variables = realloc(cg->variables,
@@ -105,8 +161,10 @@ static void add_variable(CodeGen *cg, const char *name, double value) {
     var->value = value;
     var->label = malloc(32);
     sprintf(var->label, ".L_var_%s", name);
+    var->init = NULL;
 
     cg->variables[cg->var_count++] = var;
+    return var;
 }
 
 static Variable* lookup_variable(CodeGen *cg, const char *name) {
@@ -118,8 +176,106 @@ static Variable* lookup_variable(CodeGen *cg, const char *name) {
     return NULL;
 }
 
+// Descriptor that makes a defn usable as a value, e.g. by map or filter
+static void function_value_label(FunctionInfo *func, char *buf, size_t size) {
+    snprintf(buf, size, ".L_fn%s", func->label);
+}
+
+// Per-function MemoCache of a defn-memo
+static void memo_cache_label(FunctionInfo *func, char *buf, size_t size) {
+    snprintf(buf, size, ".L_memo%s", func->label);
+}
+
+// Per-function call counter for --stats and --profile-generate, and its
+// name for the report
+static void call_counter_label(FunctionInfo *func, char *buf, size_t size) {
+    snprintf(buf, size, ".L_calls%s", func->label);
+}
+
+static int counts_calls(CodeGen *cg) {
+    return cg->options->stats || cg->options->profile_generate;
+}
+
+// Then and else counters of the if at node's position
+static const char *add_branch_counter(CodeGen *cg, ASTNode *node) {
+    if (cg->branch_count >= cg->branch_capacity) {
+        cg->branch_capacity *= 2;
+        cg->branch_counters = realloc(cg->branch_counters,
+                                      cg->branch_capacity * sizeof(BranchCounter *));
+    }
+
+    BranchCounter *bc = malloc(sizeof(BranchCounter));
+    bc->line = node->line;
+    bc->column = node->column;
+    bc->label = malloc(32);
+    sprintf(bc->label, ".L_branch_%d", cg->label_counter++);
+
+    cg->branch_counters[cg->branch_count++] = bc;
+    return bc->label;
+}
+
+static int has_function_data(CodeGen *cg) {
+    if (counts_calls(cg)) {
+        return 1;
+    }
+    for (int i = 0; i < cg->symbols->function_count; i++) {
+        FunctionInfo *func = cg->symbols->functions[i];
+        if (func->reachable && (func->used_as_value || func->memo)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// RtDefnStats table (runtime.h) of the emitted functions for rt_stats_start
+static void emit_defn_stats(CodeGen *cg) {
+    int emitted = 0;
+    for (int i = 0; i < cg->symbols->function_count; i++) {
+        FunctionInfo *func = cg->symbols->functions[i];
+        if (func->reachable) {
+            char label[256];
+            call_counter_label(func, label, sizeof(label));
+            emit_call_counter(cg->output, label, func->name);
+            emitted++;
+        }
+    }
+
+    fprintf(cg->output, "    .p2align 3\n");
+    emit_label(cg->output, ".L_defn_stats");
+    fprintf(cg->output, "    .quad %d\n", emitted);
+    for (int i = 0; i < cg->symbols->function_count; i++) {
+        FunctionInfo *func = cg->symbols->functions[i];
+        if (func->reachable) {
+            char label[256];
+            call_counter_label(func, label, sizeof(label));
+            fprintf(cg->output, "    .quad %s_name\n", label);
+            fprintf(cg->output, "    .quad %s\n", label);
+        }
+    }
+}
+
+// RtProfile table (runtime.h) for rt_profile_start
+static void emit_profile(CodeGen *cg) {
+    for (int i = 0; i < cg->branch_count; i++) {
+        emit_branch_counter(cg->output, cg->branch_counters[i]->label);
+    }
+
+    const char *path = add_string_constant(cg, cg->options->profile_generate);
+    fprintf(cg->output, "    .p2align 3\n");
+    emit_label(cg->output, ".L_profile");
+    fprintf(cg->output, "    .quad %s\n", path);
+    fprintf(cg->output, "    .quad .L_defn_stats\n");
+    fprintf(cg->output, "    .quad %d\n", cg->branch_count);
+    for (int i = 0; i < cg->branch_count; i++) {
+        fprintf(cg->output, "    .quad %d\n", cg->branch_counters[i]->line);
+        fprintf(cg->output, "    .quad %d\n", cg->branch_counters[i]->column);
+        fprintf(cg->output, "    .quad %s\n", cg->branch_counters[i]->label);
+    }
+}
+
 static void emit_data_section(CodeGen *cg) {
-    if (cg->float_count > 0 || cg->var_count > 0 || cg->string_count > 0) {
+    if (cg->float_count > 0 || cg->var_count > 0 || cg->string_count > 0 ||
+        cg->keyword_count > 0 || has_function_data(cg)) {
         emit_data_section_start(cg->output);
         for (int i = 0; i < cg->float_count; i++) {
             emit_float_constant(cg->output,
@@ -131,6 +287,31 @@ static void emit_data_section(CodeGen *cg) {
                               cg->variables[i]->label,
                               cg->variables[i]->value);
         }
+        for (int i = 0; i < cg->keyword_count; i++) {
+            emit_keyword_constant(cg->output,
+                                cg->keyword_constants[i]->label,
+                                cg->keyword_constants[i]->name,
+                                cg->keyword_constants[i]->hash);
+        }
+        for (int i = 0; i < cg->symbols->function_count; i++) {
+            FunctionInfo *func = cg->symbols->functions[i];
+            if (func->used_as_value) {
+                char label[256];
+                function_value_label(func, label, sizeof(label));
+                emit_function_descriptor(cg->output, label, func->label, func->arity);
+            }
+            if (func->memo && func->reachable) {
+                char label[256];
+                memo_cache_label(func, label, sizeof(label));
+                emit_memo_cache(cg->output, label, func->memo_max_entries, func->memo_evict);
+            }
+        }
+        if (counts_calls(cg)) {
+            emit_defn_stats(cg);
+        }
+        if (cg->options->profile_generate) {
+            emit_profile(cg);
+        }
         for (int i = 0; i < cg->string_count; i++) {
             emit_string_constant(cg->output,
                                cg->string_constants[i]->label,
@@ -143,6 +324,7 @@ typedef struct LocalContext {
     char **param_names;
     int param_count;
     char **let_names;
+    int *let_numbers;  // Whether each let binding is known to hold a number
     int let_count;
     int let_frame_offset;  // Offset from frame pointer to first let binding
     struct LocalContext *parent;
@@ -151,6 +333,8 @@ typedef struct LocalContext {
 static LocalContext *current_context = NULL;
 
 static void generate_expr(CodeGen *cg, ASTNode *node);
+static void set_source_loc(CodeGen *cg, int line, int column);
+static void generate_symbol(CodeGen *cg, const char *symbol);
 
 static int find_local_index(const char *name, int *is_let, int *frame_offset) {
     if (!current_context) return -1;
@@ -185,6 +369,33 @@ static int find_local_index(const char *name, int *is_let, int *frame_offset) {
     return -1;
 }
 
+// Params and let bindings, as opposed to variables and function names
+static int is_local(CodeGen *cg, const char *symbol) {
+    int is_let = 0;
+    int frame_offset = 0;
+    return !lookup_variable(cg, symbol) && find_local_index(symbol, &is_let, &frame_offset) >= 0;
+}
+
+// Resolves like generate_symbol; parameters may hold anything
+static int local_is_number(CodeGen *cg, const char *name) {
+    if (lookup_variable(cg, name)) {
+        return 0;
+    }
+    for (LocalContext *ctx = current_context; ctx; ctx = ctx->parent) {
+        for (int i = 0; i < ctx->let_count; i++) {
+            if (strcmp(ctx->let_names[i], name) == 0) {
+                return ctx->let_numbers && ctx->let_numbers[i];
+            }
+        }
+        for (int i = 0; i < ctx->param_count; i++) {
+            if (strcmp(ctx->param_names[i], name) == 0) {
+                return 0;
+            }
+        }
+    }
+    return 0;
+}
+
 static void generate_number(CodeGen *cg, double value) {
     const char *label = add_float_constant(cg, value);
     emit_comment(cg->output, "Load number");
@@ -197,8 +408,43 @@ static void generate_string(CodeGen *cg, const char *value) {
     emit_comment(cg->output, "Load string");
     fprintf(cg->output, "    adrp x0, %s@PAGE\n", label);
     fprintf(cg->output, "    add x0, x0, %s@PAGEOFF\n", label);
-    // Push the pointer (treating it as data on stack)
-    fprintf(cg->output, "    str x0, [sp, #-16]!\n");
+    emit_box_pointer(cg->output, 0, VALUE_TAG_STRING);
+    emit_push_value(cg->output, 0);
+}
+
+static void generate_keyword(CodeGen *cg, const char *name) {
+    KeywordConstant *kc = add_keyword_constant(cg, name);
+    emit_comment(cg->output, "Load keyword");
+    fprintf(cg->output, "    adrp x0, %s@PAGE\n", kc->label);
+    fprintf(cg->output, "    add x0, x0, %s@PAGEOFF\n", kc->label);
+    emit_box_pointer(cg->output, 0, VALUE_TAG_KEYWORD);
+    emit_push_value(cg->output, 0);
+}
+
+static void generate_function_value(CodeGen *cg, FunctionInfo *func) {
+    char label[256];
+    function_value_label(func, label, sizeof(label));
+    func->used_as_value = 1;
+    emit_comment(cg->output, "Load function value");
+    fprintf(cg->output, "    adrp x0, %s@PAGE\n", label);
+    fprintf(cg->output, "    add x0, x0, %s@PAGEOFF\n", label);
+    emit_box_pointer(cg->output, 0, VALUE_TAG_OBJECT);
+    emit_push_value(cg->output, 0);
+}
+
+static void generate_quote(CodeGen *cg, ASTNode **args, int arg_count) {
+    if (arg_count != 1 || args[0]->type != AST_SYMBOL) {
+        fprintf(stderr, "Error: quote requires exactly 1 symbol argument\n");
+        exit(1);
+    }
+
+    // Symbols share the string pool, so equal symbols get the same address
+    const char *label = add_string_constant(cg, args[0]->as.symbol);
+    emit_comment(cg->output, "Load symbol");
+    fprintf(cg->output, "    adrp x0, %s@PAGE\n", label);
+    fprintf(cg->output, "    add x0, x0, %s@PAGEOFF\n", label);
+    emit_box_pointer(cg->output, 0, VALUE_TAG_SYMBOL);
+    emit_push_value(cg->output, 0);
 }
 
 static int is_operator(const char *symbol) {
@@ -230,6 +476,8 @@ static int is_list_function(const char *symbol) {
            strcmp(symbol, "append") == 0 ||
            strcmp(symbol, "list-count") == 0 ||
            strcmp(symbol, "empty-list") == 0 ||
+           strcmp(symbol, "list") == 0 ||
+           strcmp(symbol, "vector") == 0 ||
            strcmp(symbol, "print-list") == 0;
 }
 
@@ -266,6 +514,42 @@ static void generate_operator(CodeGen *cg, const char *op, ASTNode **args, int a
     emit_push_double(cg->output, 0);
 }
 
+// `=` on two NaN-boxed values. Two numbers compare ordered and stay inline;
+// an unordered result means at least one side is boxed (or NaN), which is
+// handed to the runtime for structural equality.
+static void generate_equality(CodeGen *cg) {
+    char num_label[32];
+    char done_label[32];
+    sprintf(num_label, "L_eq_num_%d", cg->label_counter);
+    sprintf(done_label, "L_eq_done_%d", cg->label_counter);
+    cg->label_counter++;
+
+    emit_pop_value(cg->output, 1);
+    emit_pop_value(cg->output, 0);
+    fprintf(cg->output, "    fmov d0, x0\n");
+    fprintf(cg->output, "    fmov d1, x1\n");
+    emit_fcmp(cg->output);
+    fprintf(cg->output, "    b.vc %s\n", num_label);
+    emit_call(cg->output, "_value_equals");
+    emit_branch(cg->output, done_label);
+    emit_label(cg->output, num_label);
+    emit_cset(cg->output, 0, "eq");
+    emit_label(cg->output, done_label);
+    fprintf(cg->output, "    ucvtf d0, x0\n");
+    emit_push_double(cg->output, 0);
+}
+
+// `=` against a keyword literal: keywords are interned, so identity is
+// equality and a single integer compare decides it
+static void generate_identity_equality(CodeGen *cg) {
+    emit_pop_value(cg->output, 1);
+    emit_pop_value(cg->output, 0);
+    fprintf(cg->output, "    cmp x0, x1\n");
+    emit_cset(cg->output, 0, "eq");
+    fprintf(cg->output, "    ucvtf d0, x0\n");
+    emit_push_double(cg->output, 0);
+}
+
 static void generate_comparison(CodeGen *cg, const char *op, ASTNode **args, int arg_count) {
     if (arg_count != 2) {
         fprintf(stderr, "Error: Comparison operator %s requires exactly 2 arguments\n", op);
@@ -279,6 +563,15 @@ static void generate_comparison(CodeGen *cg, const char *op, ASTNode **args, int
     generate_expr(cg, args[0]);
     generate_expr(cg, args[1]);
 
+    if (strcmp(op, "=") == 0) {
+        if (args[0]->type == AST_KEYWORD || args[1]->type == AST_KEYWORD) {
+            generate_identity_equality(cg);
+        } else {
+            generate_equality(cg);
+        }
+        return;
+    }
+
     emit_pop_double(cg->output, 1);
     emit_pop_double(cg->output, 0);
 
@@ -305,6 +598,88 @@ static void generate_comparison(CodeGen *cg, const char *op, ASTNode **args, int
     emit_push_double(cg->output, 0);
 }
 
+// Branches to `label` unless x0 holds a list or vector. Clobbers x9, x10.
+static void emit_branch_unless_list(CodeGen *cg, const char *label) {
+    fprintf(cg->output, "    lsr x9, x0, #%d\n", VALUE_TAG_SHIFT);
+    fprintf(cg->output, "    mov x10, #0x%x\n", VALUE_TAG_LIST);
+    fprintf(cg->output, "    sub x9, x9, x10\n");
+    fprintf(cg->output, "    cmp x9, #%d\n", VALUE_TAG_VECTOR - VALUE_TAG_LIST);
+    fprintf(cg->output, "    b.hi %s\n", label);
+}
+
+// Branches to `label` unless x0 holds a string. Clobbers x9, x10.
+static void emit_branch_unless_string(CodeGen *cg, const char *label) {
+    fprintf(cg->output, "    lsr x9, x0, #%d\n", VALUE_TAG_SHIFT);
+    fprintf(cg->output, "    mov x10, #0x%x\n", VALUE_TAG_STRING);
+    fprintf(cg->output, "    cmp x9, x10\n");
+    fprintf(cg->output, "    b.ne %s\n", label);
+}
+
+// Inline builtins: the common case is a tag check and a load through the
+// layouts in runtime.h, anything else (lazy seqs, symbols, non-collections)
+// goes to the runtime function. The argument is in x0 (and d0), the
+// result is left in x0 or d0.
+typedef enum {
+    INLINE_FIRST,
+    INLINE_LIST_COUNT,
+    INLINE_STR_LENGTH,
+    INLINE_STR_CHAR_AT
+} InlineBuiltin;
+
+static void emit_inline_builtin(CodeGen *cg, InlineBuiltin builtin, const char *fallback) {
+    if (cg->options->stats) {
+        // Every call reaches the runtime, so the stats count it
+        emit_call(cg->output, fallback);
+        return;
+    }
+
+    char slow_label[32];
+    char done_label[32];
+    int id = cg->label_counter++;
+    sprintf(slow_label, "L_inline_slow_%d", id);
+    sprintf(done_label, "L_inline_done_%d", id);
+    int string_chars = (int)offsetof(RuntimeString, chars);
+
+    switch (builtin) {
+        case INLINE_FIRST:
+            emit_branch_unless_list(cg, slow_label);
+            fprintf(cg->output, "    and x9, x0, #0x%llx\n", (unsigned long long)VALUE_PAYLOAD_MASK);
+            fprintf(cg->output, "    ldr w10, [x9, #%d]\n", (int)offsetof(RuntimeList, count));
+            fprintf(cg->output, "    mov x0, #0\n");  // 0.0 for an empty list
+            fprintf(cg->output, "    cbz w10, %s\n", done_label);
+            fprintf(cg->output, "    ldr x9, [x9, #%d]\n", (int)offsetof(RuntimeList, elements));
+            fprintf(cg->output, "    ldr x0, [x9]\n");
+            break;
+        case INLINE_LIST_COUNT:
+            emit_branch_unless_list(cg, slow_label);
+            fprintf(cg->output, "    and x9, x0, #0x%llx\n", (unsigned long long)VALUE_PAYLOAD_MASK);
+            fprintf(cg->output, "    ldr w10, [x9, #%d]\n", (int)offsetof(RuntimeList, count));
+            fprintf(cg->output, "    scvtf d0, w10\n");
+            break;
+        case INLINE_STR_LENGTH:
+            emit_branch_unless_string(cg, slow_label);
+            fprintf(cg->output, "    and x9, x0, #0x%llx\n", (unsigned long long)VALUE_PAYLOAD_MASK);
+            fprintf(cg->output, "    ldur x10, [x9, #-%d]\n", string_chars);
+            fprintf(cg->output, "    scvtf d0, x10\n");
+            break;
+        case INLINE_STR_CHAR_AT:
+            emit_branch_unless_string(cg, slow_label);
+            fprintf(cg->output, "    and x9, x0, #0x%llx\n", (unsigned long long)VALUE_PAYLOAD_MASK);
+            fprintf(cg->output, "    ldur x10, [x9, #-%d]\n", string_chars);
+            fprintf(cg->output, "    fcvtzs x11, d0\n");
+            fprintf(cg->output, "    fmov d0, xzr\n");  // 0.0 out of range
+            fprintf(cg->output, "    cmp x11, x10\n");  // Unsigned, so negative is out too
+            fprintf(cg->output, "    b.hs %s\n", done_label);
+            fprintf(cg->output, "    ldrsb w12, [x9, x11]\n");  // Signed, as str_char_at
+            fprintf(cg->output, "    scvtf d0, w12\n");
+            break;
+    }
+    emit_branch(cg->output, done_label);
+    emit_label(cg->output, slow_label);
+    emit_call(cg->output, fallback);
+    emit_label(cg->output, done_label);
+}
+
 static void generate_string_function(CodeGen *cg, const char *func, ASTNode **args, int arg_count) {
     char comment[64];
     snprintf(comment, sizeof(comment), "String function: %s", func);
@@ -316,8 +691,8 @@ static void generate_string_function(CodeGen *cg, const char *func, ASTNode **ar
             exit(1);
         }
         generate_expr(cg, args[0]);
-        fprintf(cg->output, "    ldr x0, [sp], #16\n");  // Pop string pointer
-        emit_call(cg->output, "_str_length");
+        emit_pop_value(cg->output, 0);  // Pop string
+        emit_inline_builtin(cg, INLINE_STR_LENGTH, "_str_length");
         emit_push_double(cg->output, 0);
     } else if (strcmp(func, "str-char-at") == 0) {
         if (arg_count != 2) {
@@ -326,9 +701,9 @@ static void generate_string_function(CodeGen *cg, const char *func, ASTNode **ar
         }
         generate_expr(cg, args[0]);  // String
         generate_expr(cg, args[1]);  // Index
-        emit_pop_double(cg->output, 1);  // Pop index into d1
-        fprintf(cg->output, "    ldr x0, [sp], #16\n");  // Pop string pointer
-        emit_call(cg->output, "_str_char_at");
+        emit_pop_double(cg->output, 0);  // Pop index into d0
+        emit_pop_value(cg->output, 0);  // Pop string into x0
+        emit_inline_builtin(cg, INLINE_STR_CHAR_AT, "_str_char_at");
         emit_push_double(cg->output, 0);
     } else if (strcmp(func, "str-concat") == 0) {
         if (arg_count != 2) {
@@ -337,10 +712,10 @@ static void generate_string_function(CodeGen *cg, const char *func, ASTNode **ar
         }
         generate_expr(cg, args[0]);  // First string
         generate_expr(cg, args[1]);  // Second string
-        fprintf(cg->output, "    ldr x1, [sp], #16\n");  // Pop second string
-        fprintf(cg->output, "    ldr x0, [sp], #16\n");  // Pop first string
+        emit_pop_value(cg->output, 1);  // Pop second string
+        emit_pop_value(cg->output, 0);  // Pop first string
         emit_call(cg->output, "_str_concat");
-        fprintf(cg->output, "    str x0, [sp, #-16]!\n");  // Push result
+        emit_push_value(cg->output, 0);  // Push result
     } else if (strcmp(func, "substring") == 0) {
         if (arg_count != 3) {
             fprintf(stderr, "Error: substring requires exactly 3 arguments\n");
@@ -349,11 +724,82 @@ static void generate_string_function(CodeGen *cg, const char *func, ASTNode **ar
         generate_expr(cg, args[0]);  // String
         generate_expr(cg, args[1]);  // Start
         generate_expr(cg, args[2]);  // End
-        emit_pop_double(cg->output, 2);  // Pop end into d2
-        emit_pop_double(cg->output, 1);  // Pop start into d1
-        fprintf(cg->output, "    ldr x0, [sp], #16\n");  // Pop string
+        emit_pop_double(cg->output, 1);  // Pop end into d1
+        emit_pop_double(cg->output, 0);  // Pop start into d0
+        emit_pop_value(cg->output, 0);  // Pop string into x0
         emit_call(cg->output, "_substring");
-        fprintf(cg->output, "    str x0, [sp, #-16]!\n");  // Push result
+        emit_push_value(cg->output, 0);  // Push result
+    }
+}
+
+// Expressions that always evaluate to a number, which never needs sharing
+static int is_number_expr(CodeGen *cg, ASTNode *node) {
+    if (node->type == AST_NUMBER) {
+        return 1;
+    }
+    if (node->type == AST_SYMBOL) {
+        return local_is_number(cg, node->as.symbol);
+    }
+    if (node->type != AST_LIST || node->as.list.count == 0 ||
+        node->as.list.elements[0]->type != AST_SYMBOL) {
+        return 0;
+    }
+    const char *head = node->as.list.elements[0]->as.symbol;
+    return is_operator(head) || is_comparison(head) ||
+           strcmp(head, "list-count") == 0 || strcmp(head, "str-length") == 0 ||
+           strcmp(head, "list-sum") == 0 || strcmp(head, "list-product") == 0 ||
+           strcmp(head, "list-dot") == 0 || strcmp(head, "list-min") == 0 ||
+           strcmp(head, "list-max") == 0;
+}
+
+// Marks the collection on top of the stack as shared, so later updates
+// through either reference copy it (rt_share in runtime.h, inlined)
+static void emit_share_top(CodeGen *cg) {
+    char skip_label[32];
+    sprintf(skip_label, "L_share_%d", cg->label_counter++);
+
+    fprintf(cg->output, "    ldr x0, [sp]\n");
+    emit_branch_unless_list(cg, skip_label);
+    fprintf(cg->output, "    and x9, x0, #0x%llx\n", (unsigned long long)VALUE_PAYLOAD_MASK);
+    fprintf(cg->output, "    mov w10, #1\n");
+    fprintf(cg->output, "    str w10, [x9, #%d]\n", (int)offsetof(RuntimeList, shared));
+    emit_label(cg->output, skip_label);
+}
+
+// (list a b ...) / (vector a b ...): allocate, then append each element.
+// The collection stays on top of the stack while elements are evaluated.
+static void generate_collection_literal(CodeGen *cg, const char *constructor,
+                                        ASTNode **args, int arg_count) {
+    emit_call(cg->output, constructor);
+    emit_push_value(cg->output, 0);
+
+    for (int i = 0; i < arg_count; i++) {
+        generate_expr(cg, args[i]);
+        emit_pop_value(cg->output, 1);  // Element
+        fprintf(cg->output, "    ldr x0, [sp]\n");  // Collection
+        emit_call(cg->output, "_append_elem");
+        fprintf(cg->output, "    str x0, [sp]\n");
+    }
+}
+
+// A literal escape analysis proved call-local: allocated in the call's
+// scratch region with its final count, elements stored in place
+static void generate_scratch_literal(CodeGen *cg, const char *func, ASTNode **args, int arg_count) {
+    emit_comment(cg->output, strcmp(func, "list") == 0 ? "Scratch list" : "Scratch vector");
+    fprintf(cg->output, "    mov x0, #%d\n", arg_count);
+    emit_call(cg->output, strcmp(func, "list") == 0 ? "_create_list_scratch" : "_create_vector_scratch");
+    emit_push_value(cg->output, 0);
+
+    for (int i = 0; i < arg_count; i++) {
+        generate_expr(cg, args[i]);
+        if (!is_number_expr(cg, args[i])) {
+            emit_share_top(cg);
+        }
+        emit_pop_value(cg->output, 1);
+        fprintf(cg->output, "    ldr x0, [sp]\n");
+        fprintf(cg->output, "    and x0, x0, #0x%llx\n", (unsigned long long)VALUE_PAYLOAD_MASK);
+        fprintf(cg->output, "    ldr x0, [x0, #%d]\n", (int)offsetof(RuntimeList, elements));
+        fprintf(cg->output, "    str x1, [x0, #%d]\n", i * 8);
     }
 }
 
@@ -368,7 +814,11 @@ static void generate_list_function(CodeGen *cg, const char *func, ASTNode **args
             exit(1);
         }
         emit_call(cg->output, "_create_list");
-        fprintf(cg->output, "    str x0, [sp, #-16]!\n");  // Push list pointer
+        emit_push_value(cg->output, 0);  // Push list
+    } else if (strcmp(func, "list") == 0) {
+        generate_collection_literal(cg, "_create_list", args, arg_count);
+    } else if (strcmp(func, "vector") == 0) {
+        generate_collection_literal(cg, "_create_vector", args, arg_count);
     } else if (strcmp(func, "cons") == 0) {
         if (arg_count != 2) {
             fprintf(stderr, "Error: cons requires exactly 2 arguments\n");
@@ -376,28 +826,28 @@ static void generate_list_function(CodeGen *cg, const char *func, ASTNode **args
         }
         generate_expr(cg, args[0]);  // Element
         generate_expr(cg, args[1]);  // List
-        fprintf(cg->output, "    ldr x1, [sp], #16\n");  // Pop list pointer into x1
-        emit_pop_double(cg->output, 0);  // Pop element into d0
+        emit_pop_value(cg->output, 1);  // Pop list into x1
+        emit_pop_value(cg->output, 0);  // Pop element into x0
         emit_call(cg->output, "_cons");
-        fprintf(cg->output, "    str x0, [sp, #-16]!\n");  // Push result list
+        emit_push_value(cg->output, 0);  // Push result list
     } else if (strcmp(func, "first") == 0) {
         if (arg_count != 1) {
             fprintf(stderr, "Error: first requires exactly 1 argument\n");
             exit(1);
         }
         generate_expr(cg, args[0]);
-        fprintf(cg->output, "    ldr x0, [sp], #16\n");  // Pop list pointer
-        emit_call(cg->output, "_first");
-        emit_push_double(cg->output, 0);
+        emit_pop_value(cg->output, 0);  // Pop list
+        emit_inline_builtin(cg, INLINE_FIRST, "_first");
+        emit_push_value(cg->output, 0);  // Element may be any value
     } else if (strcmp(func, "rest") == 0) {
         if (arg_count != 1) {
             fprintf(stderr, "Error: rest requires exactly 1 argument\n");
             exit(1);
         }
         generate_expr(cg, args[0]);
-        fprintf(cg->output, "    ldr x0, [sp], #16\n");  // Pop list pointer
+        emit_pop_value(cg->output, 0);  // Pop list
         emit_call(cg->output, "_rest");
-        fprintf(cg->output, "    str x0, [sp, #-16]!\n");  // Push result list
+        emit_push_value(cg->output, 0);  // Push result list
     } else if (strcmp(func, "append") == 0) {
         if (arg_count != 2) {
             fprintf(stderr, "Error: append requires exactly 2 arguments\n");
@@ -405,18 +855,18 @@ static void generate_list_function(CodeGen *cg, const char *func, ASTNode **args
         }
         generate_expr(cg, args[0]);  // List
         generate_expr(cg, args[1]);  // Element
-        emit_pop_double(cg->output, 1);  // Pop element into d1
-        fprintf(cg->output, "    ldr x0, [sp], #16\n");  // Pop list pointer
+        emit_pop_value(cg->output, 1);  // Pop element into x1
+        emit_pop_value(cg->output, 0);  // Pop list into x0
         emit_call(cg->output, "_append_elem");
-        fprintf(cg->output, "    str x0, [sp, #-16]!\n");  // Push result list
+        emit_push_value(cg->output, 0);  // Push result list
     } else if (strcmp(func, "list-count") == 0) {
         if (arg_count != 1) {
             fprintf(stderr, "Error: list-count requires exactly 1 argument\n");
             exit(1);
         }
         generate_expr(cg, args[0]);
-        fprintf(cg->output, "    ldr x0, [sp], #16\n");  // Pop list pointer
-        emit_call(cg->output, "_list_count");
+        emit_pop_value(cg->output, 0);  // Pop list
+        emit_inline_builtin(cg, INLINE_LIST_COUNT, "_list_count");
         emit_push_double(cg->output, 0);
     } else if (strcmp(func, "print-list") == 0) {
         if (arg_count != 1) {
@@ -424,7 +874,7 @@ static void generate_list_function(CodeGen *cg, const char *func, ASTNode **args
             exit(1);
         }
         generate_expr(cg, args[0]);
-        fprintf(cg->output, "    ldr x0, [sp], #16\n");  // Pop list pointer
+        emit_pop_value(cg->output, 0);  // Pop list
         emit_call(cg->output, "_print_list");
         // print-list returns void, push 0 as placeholder
         fprintf(cg->output, "    fmov d0, #0.0\n");
@@ -432,97 +882,1068 @@ static void generate_list_function(CodeGen *cg, const char *func, ASTNode **args
     }
 }
 
-static void generate_let(CodeGen *cg, ASTNode **args, int arg_count) {
-    if (arg_count != 2) {
-        fprintf(stderr, "Error: let requires exactly 2 arguments (bindings body)\n");
-        exit(1);
-    }
+static int is_list_kernel(const char *symbol) {
+    return strcmp(symbol, "list-sum") == 0 ||
+           strcmp(symbol, "list-product") == 0 ||
+           strcmp(symbol, "list-dot") == 0 ||
+           strcmp(symbol, "list-min") == 0 ||
+           strcmp(symbol, "list-max") == 0 ||
+           strcmp(symbol, "list-scale") == 0 ||
+           strcmp(symbol, "list-add") == 0 ||
+           strcmp(symbol, "list-sub") == 0 ||
+           strcmp(symbol, "list-mul") == 0;
+}
 
-    ASTNode *bindings = args[0];
-    ASTNode *body = args[1];
+// Vectorized kernels in runtime/list_kernels.c: reductions return a
+// double, element-wise operations return a new list
+static void generate_list_kernel(CodeGen *cg, const char *func, ASTNode **args, int arg_count) {
+    char comment[64];
+    snprintf(comment, sizeof(comment), "List kernel: %s", func);
+    emit_comment(cg->output, comment);
 
-    if (bindings->type != AST_LIST) {
-        fprintf(stderr, "Error: let bindings must be a vector/list\n");
-        exit(1);
+    char label[32];
+    snprintf(label, sizeof(label), "_%s", func);
+    for (char *p = label; *p; p++) {
+        if (*p == '-') *p = '_';
     }
 
-    if (bindings->as.list.count % 2 != 0) {
-        fprintf(stderr, "Error: let bindings must have even number of elements\n");
-        exit(1);
+    if (strcmp(func, "list-scale") == 0) {
+        if (arg_count != 2) {
+            fprintf(stderr, "Error: list-scale requires exactly 2 arguments\n");
+            exit(1);
+        }
+        generate_expr(cg, args[0]);  // List
+        generate_expr(cg, args[1]);  // Factor
+        emit_pop_double(cg->output, 0);
+        emit_pop_value(cg->output, 0);
+        emit_call(cg->output, label);
+        emit_push_value(cg->output, 0);
+    } else if (strcmp(func, "list-dot") == 0 || strcmp(func, "list-add") == 0 ||
+               strcmp(func, "list-sub") == 0 || strcmp(func, "list-mul") == 0) {
+        if (arg_count != 2) {
+            fprintf(stderr, "Error: %s requires exactly 2 arguments\n", func);
+            exit(1);
+        }
+        generate_expr(cg, args[0]);
+        generate_expr(cg, args[1]);
+        emit_pop_value(cg->output, 1);
+        emit_pop_value(cg->output, 0);
+        emit_call(cg->output, label);
+        if (strcmp(func, "list-dot") == 0) {
+            emit_push_double(cg->output, 0);
+        } else {
+            emit_push_value(cg->output, 0);
+        }
+    } else {
+        if (arg_count != 1) {
+            fprintf(stderr, "Error: %s requires exactly 1 argument\n", func);
+            exit(1);
+        }
+        generate_expr(cg, args[0]);
+        emit_pop_value(cg->output, 0);
+        emit_call(cg->output, label);
+        emit_push_double(cg->output, 0);
     }
+}
 
-    int binding_count = bindings->as.list.count / 2;
-    char **binding_names = malloc(binding_count * sizeof(char *));
-
-    emit_comment(cg->output, "Let: evaluate bindings");
+static int is_seq_function(const char *symbol) {
+    return strcmp(symbol, "range") == 0 ||
+           strcmp(symbol, "iterate") == 0 ||
+           strcmp(symbol, "filter") == 0 ||
+           strcmp(symbol, "take") == 0 ||
+           strcmp(symbol, "drop") == 0;
+}
 
-    // Calculate where bindings will be stored relative to frame pointer
-    // Account for parent context's bindings AND parameters
-    int parent_bindings = 0;
-    if (current_context) {
-        parent_bindings = current_context->param_count + current_context->let_count;
+// A function argument naming a defn is checked against the arity the
+// builtin calls it with; any other expression is checked at runtime
+static void generate_function_arg(CodeGen *cg, ASTNode *node, int arity, const char *builtin) {
+    if (node->type == AST_SYMBOL && !lookup_variable(cg, node->as.symbol)) {
+        int is_let = 0;
+        int frame_offset = 0;
+        FunctionInfo *func = lookup_function(cg->symbols, node->as.symbol);
+        if (func && find_local_index(node->as.symbol, &is_let, &frame_offset) < 0 &&
+            func->arity != arity) {
+            fprintf(stderr, "Error: %s calls its function with %d argument(s), but %s expects %d\n",
+                    builtin, arity, func->name, func->arity);
+            exit(1);
+        }
     }
-    int let_frame_offset = parent_bindings;
+    generate_expr(cg, node);
+}
 
-    // Evaluate each binding and push to stack
-    for (int i = 0; i < binding_count; i++) {
-        ASTNode *name_node = bindings->as.list.elements[i * 2];
-        ASTNode *value_node = bindings->as.list.elements[i * 2 + 1];
+// Lazy sequence builtins in runtime/lazy.c
+static void generate_seq_function(CodeGen *cg, const char *func, ASTNode **args, int arg_count) {
+    char comment[64];
+    snprintf(comment, sizeof(comment), "Lazy seq: %s", func);
+    emit_comment(cg->output, comment);
 
-        if (name_node->type != AST_SYMBOL) {
-            fprintf(stderr, "Error: let binding name must be a symbol\n");
-            free(binding_names);
+    if (strcmp(func, "range") == 0) {
+        // (range), (range end), (range start end), (range start end step)
+        if (arg_count > 3) {
+            fprintf(stderr, "Error: range requires at most 3 arguments\n");
+            exit(1);
+        }
+        if (arg_count >= 2) {
+            generate_expr(cg, args[0]);
+        } else {
+            generate_number(cg, 0.0);
+        }
+        if (arg_count >= 1) {
+            generate_expr(cg, args[arg_count >= 2 ? 1 : 0]);
+        } else {
+            generate_number(cg, 0.0);
+        }
+        if (arg_count == 3) {
+            generate_expr(cg, args[2]);
+        } else {
+            generate_number(cg, 1.0);
+        }
+        emit_pop_double(cg->output, 2);  // Step
+        emit_pop_double(cg->output, 1);  // End
+        emit_pop_double(cg->output, 0);  // Start
+        fprintf(cg->output, "    mov x0, #%d\n", arg_count > 0);  // Bounded
+        emit_call(cg->output, "_range_seq");
+    } else if (strcmp(func, "take") == 0 || strcmp(func, "drop") == 0) {
+        if (arg_count != 2) {
+            fprintf(stderr, "Error: %s requires exactly 2 arguments\n", func);
+            exit(1);
+        }
+        generate_expr(cg, args[0]);  // Count
+        generate_expr(cg, args[1]);  // Collection
+        emit_pop_value(cg->output, 0);
+        emit_pop_double(cg->output, 0);
+        emit_call(cg->output, strcmp(func, "take") == 0 ? "_take_seq" : "_drop_seq");
+    } else {
+        // (iterate f x), (map f coll), (filter pred coll)
+        if (arg_count != 2) {
+            fprintf(stderr, "Error: %s requires exactly 2 arguments\n", func);
             exit(1);
         }
+        generate_function_arg(cg, args[0], 1, func);
+        generate_expr(cg, args[1]);
+        emit_pop_value(cg->output, 1);
+        emit_pop_value(cg->output, 0);
+        char label[32];
+        snprintf(label, sizeof(label), "_%s_seq", func);
+        emit_call(cg->output, label);
+    }
+    emit_push_value(cg->output, 0);
+}
 
-        binding_names[i] = name_node->as.symbol;
+// (map op xs ys) over an arithmetic operator lowers to the element-wise kernel
+static void generate_map(CodeGen *cg, ASTNode **args, int arg_count) {
+    if (arg_count == 3 && args[0]->type == AST_SYMBOL && is_operator(args[0]->as.symbol) &&
+        strcmp(args[0]->as.symbol, "/") != 0) {
+        const char *op = args[0]->as.symbol;
+        const char *kernel = strcmp(op, "+") == 0 ? "list-add" :
+                             strcmp(op, "-") == 0 ? "list-sub" : "list-mul";
+        generate_list_kernel(cg, kernel, &args[1], 2);
+        return;
+    }
 
-        // Evaluate the value expression
-        generate_expr(cg, value_node);
+    if (arg_count == 2) {
+        generate_seq_function(cg, "map", args, arg_count);
+        return;
     }
 
-    // Create new context with let bindings
-    LocalContext let_ctx;
-    let_ctx.param_names = current_context ? current_context->param_names : NULL;
-    let_ctx.param_count = current_context ? current_context->param_count : 0;
-    let_ctx.let_names = binding_names;
-    let_ctx.let_count = binding_count;
-    let_ctx.let_frame_offset = let_frame_offset;
-    let_ctx.parent = current_context;
+    fprintf(stderr, "Error: map supports (map f coll), (map + xs ys), (map - xs ys) and (map * xs ys)\n");
+    exit(1);
+}
 
-    LocalContext *saved_context = current_context;
-    current_context = &let_ctx;
+// transduce / into / reduce with a defn: the xform is fused at compile
+// time into a single loop over the source. Elements stream through a
+// SeqCursor span by span, every step runs in registers and the reducer
+// updates its accumulator in place, so no intermediate collection exists.
+
+typedef enum {
+    XFORM_MAP,
+    XFORM_FILTER,
+    XFORM_TAKE,
+    XFORM_DROP
+} XformKind;
+
+typedef struct XformStep {
+    XformKind kind;
+    FunctionInfo *func;  // map, filter
+    ASTNode *count;      // take, drop
+    int slot;            // Stack slot holding the remaining count
+} XformStep;
+
+#define MAX_XFORM_STEPS 16
+
+typedef enum {
+    REDUCER_ADD,
+    REDUCER_MUL,
+    REDUCER_CONJ,
+    REDUCER_CALL
+} ReducerKind;
+
+static FunctionInfo *lookup_step_function(CodeGen *cg, ASTNode *node, int arity,
+                                          const char *context) {
+    FunctionInfo *func = NULL;
+    if (node->type == AST_SYMBOL) {
+        func = lookup_function(cg->symbols, node->as.symbol);
+    }
+    if (!func) {
+        fprintf(stderr, "Error: %s requires the name of a defn\n", context);
+        exit(1);
+    }
+    if (func->arity != arity) {
+        fprintf(stderr, "Error: %s calls %s with %d argument(s), but it expects %d\n",
+                context, func->name, arity, func->arity);
+        exit(1);
+    }
+    return func;
+}
 
-    emit_comment(cg->output, "Let: evaluate body");
-    generate_expr(cg, body);
+// Flattens (comp (map f) (filter p) (take n) ...) into steps, outermost first
+static int collect_xform(CodeGen *cg, ASTNode *node, XformStep *steps, int count) {
+    if (node->type != AST_LIST || node->as.list.count == 0 ||
+        node->as.list.elements[0]->type != AST_SYMBOL) {
+        fprintf(stderr, "Error: xform must be built from comp, map, filter, take and drop\n");
+        exit(1);
+    }
 
-    current_context = saved_context;
+    const char *head = node->as.list.elements[0]->as.symbol;
+    ASTNode **args = &node->as.list.elements[1];
+    int arg_count = node->as.list.count - 1;
 
-    emit_comment(cg->output, "Let: cleanup bindings");
-    // Pop the result into d0 first
-    emit_pop_double(cg->output, 0);
+    if (strcmp(head, "comp") == 0) {
+        for (int i = 0; i < arg_count; i++) {
+            count = collect_xform(cg, args[i], steps, count);
+        }
+        return count;
+    }
 
-    // Pop all the let bindings
-    if (binding_count > 0) {
-        fprintf(cg->output, "    add sp, sp, #%d\n", binding_count * 16);
+    if (count >= MAX_XFORM_STEPS) {
+        fprintf(stderr, "Error: xform has more than %d steps\n", MAX_XFORM_STEPS);
+        exit(1);
+    }
+    if (arg_count != 1) {
+        fprintf(stderr, "Error: (%s ...) in an xform takes exactly 1 argument\n", head);
+        exit(1);
     }
 
-    // Push the result back
-    emit_push_double(cg->output, 0);
+    XformStep *step = &steps[count];
+    step->func = NULL;
+    step->count = NULL;
+    step->slot = -1;
+    if (strcmp(head, "map") == 0) {
+        step->kind = XFORM_MAP;
+        step->func = lookup_step_function(cg, args[0], 1, "map");
+    } else if (strcmp(head, "filter") == 0) {
+        step->kind = XFORM_FILTER;
+        step->func = lookup_step_function(cg, args[0], 1, "filter");
+    } else if (strcmp(head, "take") == 0) {
+        step->kind = XFORM_TAKE;
+        step->count = args[0];
+    } else if (strcmp(head, "drop") == 0) {
+        step->kind = XFORM_DROP;
+        step->count = args[0];
+    } else {
+        fprintf(stderr, "Error: Unknown xform step: %s\n", head);
+        exit(1);
+    }
+    return count + 1;
+}
 
-    free(binding_names);
+static ReducerKind reducer_kind(CodeGen *cg, ASTNode *node, FunctionInfo **func) {
+    *func = NULL;
+    if (node->type == AST_SYMBOL) {
+        if (strcmp(node->as.symbol, "+") == 0) return REDUCER_ADD;
+        if (strcmp(node->as.symbol, "*") == 0) return REDUCER_MUL;
+        if (strcmp(node->as.symbol, "conj") == 0) return REDUCER_CONJ;
+    }
+    *func = lookup_step_function(cg, node, 2, "reducing function");
+    return REDUCER_CALL;
 }
 
-static void generate_if(CodeGen *cg, ASTNode **args, int arg_count) {
-    if (arg_count != 3) {
-        fprintf(stderr, "Error: if requires exactly 3 arguments (condition then else)\n");
-        exit(1);
+// The accumulator must already be pushed. Leaves the final accumulator
+// on the stack in its place.
+static void generate_fused_loop(CodeGen *cg, XformStep *steps, int step_count,
+                                ReducerKind reducer, FunctionInfo *reduce_fn, ASTNode *coll) {
+    FILE *out = cg->output;
+    int id = cg->label_counter++;
+    char span_label[32];
+    char elem_label[32];
+    char done_label[32];
+    sprintf(span_label, "L_xf_span_%d", id);
+    sprintf(elem_label, "L_xf_elem_%d", id);
+    sprintf(done_label, "L_xf_done_%d", id);
+
+    // Slot 0 is the accumulator, slot 1 the source, then take/drop counters
+    emit_comment(out, "Fused loop: source");
+    generate_expr(cg, coll);
+    int slot_count = 2;
+    for (int i = 0; i < step_count; i++) {
+        if (steps[i].count) {
+            generate_expr(cg, steps[i].count);
+            steps[i].slot = slot_count++;
+        }
     }
 
-    char else_label[32];
-    char end_label[32];
-    sprintf(else_label, ".L_else_%d", cg->label_counter);
-    sprintf(end_label, ".L_end_%d", cg->label_counter);
+    // Loop state lives below the slots, addressed from sp
+    int cursor_size = (int)((sizeof(SeqCursor) + 15) & ~(size_t)15);
+    int span_ptr = cursor_size;
+    int span_n = cursor_size + 8;
+    int index = cursor_size + 16;
+    int saved = cursor_size + 24;
+    int area = cursor_size + 32;
+#define SLOT_OFFSET(slot) (area + (slot_count - 1 - (slot)) * 16)
+
+    if (reducer == REDUCER_CONJ) {
+        int presize = 1;
+        for (int i = 0; i < step_count; i++) {
+            if (steps[i].kind != XFORM_MAP) presize = 0;
+        }
+        if (presize) {
+            // One element out per element in, so size the target once
+            fprintf(out, "    ldr x0, [sp, #%d]\n", SLOT_OFFSET(0) - area);
+            fprintf(out, "    ldr x1, [sp, #%d]\n", SLOT_OFFSET(1) - area);
+            emit_call(out, "_into_reserve");
+        }
+    }
+
+    emit_comment(out, "Fused loop: open a cursor on the source");
+    fprintf(out, "    sub sp, sp, #%d\n", area);
+    fprintf(out, "    mov x0, sp\n");
+    fprintf(out, "    ldr x1, [sp, #%d]\n", SLOT_OFFSET(1));
+    emit_call(out, "_rt_cursor_init");
+
+    emit_label(out, span_label);
+    fprintf(out, "    mov x0, sp\n");
+    fprintf(out, "    add x1, sp, #%d\n", span_ptr);
+    emit_load_imm32(out, 2, 0x7FFFFFFF);
+    emit_call(out, "_rt_cursor_span");
+    fprintf(out, "    cbz w0, %s\n", done_label);
+    fprintf(out, "    sxtw x0, w0\n");
+    fprintf(out, "    str x0, [sp, #%d]\n", span_n);
+    fprintf(out, "    str xzr, [sp, #%d]\n", index);
+
+    emit_label(out, elem_label);
+    // A take that has let its last element through stops the loop before
+    // anything more is pulled from the source
+    for (int i = 0; i < step_count; i++) {
+        if (steps[i].kind == XFORM_TAKE) {
+            fprintf(out, "    ldr d1, [sp, #%d]\n", SLOT_OFFSET(steps[i].slot));
+            fprintf(out, "    fcmp d1, #0.0\n");
+            emit_branch_le(out, done_label);
+        }
+    }
+    fprintf(out, "    ldr x0, [sp, #%d]\n", index);
+    fprintf(out, "    ldr x1, [sp, #%d]\n", span_n);
+    fprintf(out, "    cmp x0, x1\n");
+    emit_branch_ge(out, span_label);
+    fprintf(out, "    ldr x1, [sp, #%d]\n", span_ptr);
+    fprintf(out, "    ldr d0, [x1, x0, lsl #3]\n");
+    fprintf(out, "    add x0, x0, #1\n");
+    fprintf(out, "    str x0, [sp, #%d]\n", index);
+
+    for (int i = 0; i < step_count; i++) {
+        int offset = steps[i].slot >= 0 ? SLOT_OFFSET(steps[i].slot) : 0;
+        switch (steps[i].kind) {
+            case XFORM_MAP:
+                emit_comment(out, "Fused loop: map");
+                emit_call(out, steps[i].func->label);
+                break;
+            case XFORM_FILTER:
+                emit_comment(out, "Fused loop: filter");
+                fprintf(out, "    str d0, [sp, #%d]\n", saved);
+                emit_call(out, steps[i].func->label);
+                fprintf(out, "    fcmp d0, #0.0\n");
+                emit_branch_eq(out, elem_label);
+                fprintf(out, "    ldr d0, [sp, #%d]\n", saved);
+                break;
+            case XFORM_TAKE:
+                emit_comment(out, "Fused loop: take");
+                fprintf(out, "    ldr d1, [sp, #%d]\n", offset);
+                fprintf(out, "    fmov d2, #1.0\n");
+                fprintf(out, "    fsub d1, d1, d2\n");
+                fprintf(out, "    str d1, [sp, #%d]\n", offset);
+                break;
+            case XFORM_DROP: {
+                char pass_label[32];
+                sprintf(pass_label, "L_xf_pass_%d_%d", id, i);
+                emit_comment(out, "Fused loop: drop");
+                fprintf(out, "    ldr d1, [sp, #%d]\n", offset);
+                fprintf(out, "    fcmp d1, #0.0\n");
+                emit_branch_le(out, pass_label);
+                fprintf(out, "    fmov d2, #1.0\n");
+                fprintf(out, "    fsub d1, d1, d2\n");
+                fprintf(out, "    str d1, [sp, #%d]\n", offset);
+                emit_branch(out, elem_label);
+                emit_label(out, pass_label);
+                break;
+            }
+        }
+    }
+
+    emit_comment(out, "Fused loop: reduce");
+    int acc = SLOT_OFFSET(0);
+    switch (reducer) {
+        case REDUCER_ADD:
+        case REDUCER_MUL:
+            fprintf(out, "    ldr d1, [sp, #%d]\n", acc);
+            fprintf(out, "    %s d1, d1, d0\n", reducer == REDUCER_ADD ? "fadd" : "fmul");
+            fprintf(out, "    str d1, [sp, #%d]\n", acc);
+            break;
+        case REDUCER_CONJ:
+            fprintf(out, "    fmov x1, d0\n");
+            fprintf(out, "    ldr x0, [sp, #%d]\n", acc);
+            emit_call(out, "_append_elem");
+            fprintf(out, "    str x0, [sp, #%d]\n", acc);
+            break;
+        case REDUCER_CALL:
+            fprintf(out, "    fmov d1, d0\n");
+            fprintf(out, "    ldr d0, [sp, #%d]\n", acc);
+            emit_call(out, reduce_fn->label);
+            fprintf(out, "    str d0, [sp, #%d]\n", acc);
+            break;
+    }
+    emit_branch(out, elem_label);
+
+    emit_label(out, done_label);
+    fprintf(out, "    ldr d0, [sp, #%d]\n", acc);
+    fprintf(out, "    add sp, sp, #%d\n", area + slot_count * 16);
+    emit_push_double(out, 0);
+#undef SLOT_OFFSET
+}
+
+// (transduce xform f coll) / (transduce xform f init coll)
+static void generate_transduce(CodeGen *cg, ASTNode **args, int arg_count) {
+    if (arg_count != 3 && arg_count != 4) {
+        fprintf(stderr, "Error: transduce requires an xform, a function, an optional init and a collection\n");
+        exit(1);
+    }
+
+    XformStep steps[MAX_XFORM_STEPS];
+    int step_count = collect_xform(cg, args[0], steps, 0);
+    FunctionInfo *reduce_fn;
+    ReducerKind reducer = reducer_kind(cg, args[1], &reduce_fn);
+
+    emit_comment(cg->output, "Transduce: init");
+    if (arg_count == 4) {
+        generate_expr(cg, args[2]);
+    } else if (reducer == REDUCER_ADD) {
+        generate_number(cg, 0.0);
+    } else if (reducer == REDUCER_MUL) {
+        generate_number(cg, 1.0);
+    } else if (reducer == REDUCER_CONJ) {
+        emit_call(cg->output, "_create_vector");
+        emit_push_value(cg->output, 0);
+    } else {
+        fprintf(stderr, "Error: transduce with %s requires an init value\n", reduce_fn->name);
+        exit(1);
+    }
+
+    generate_fused_loop(cg, steps, step_count, reducer, reduce_fn, args[arg_count - 1]);
+}
+
+// (into to coll) / (into to xform coll) conj-es into a copy of `to`
+static void generate_into(CodeGen *cg, ASTNode **args, int arg_count) {
+    if (arg_count != 2 && arg_count != 3) {
+        fprintf(stderr, "Error: into requires a target, an optional xform and a collection\n");
+        exit(1);
+    }
+
+    XformStep steps[MAX_XFORM_STEPS];
+    int step_count = arg_count == 3 ? collect_xform(cg, args[1], steps, 0) : 0;
+
+    emit_comment(cg->output, "Into: target");
+    ASTNode *to = args[0];
+    if (to->type == AST_LIST && to->as.list.count == 0) {
+        // [] literal
+        emit_call(cg->output, "_create_vector");
+    } else {
+        generate_expr(cg, to);
+        emit_pop_value(cg->output, 0);
+        emit_call(cg->output, "_copy_collection");
+    }
+    emit_push_value(cg->output, 0);
+
+    generate_fused_loop(cg, steps, step_count, REDUCER_CONJ, NULL, args[arg_count - 1]);
+}
+
+// (reduce op coll) / (reduce op init coll) over + or * lowers to a kernel,
+// any other reducer to a fused loop
+static void generate_reduce(CodeGen *cg, ASTNode **args, int arg_count) {
+    if ((arg_count != 2 && arg_count != 3) || args[0]->type != AST_SYMBOL) {
+        fprintf(stderr, "Error: reduce requires a function, an optional init and a collection\n");
+        exit(1);
+    }
+
+    const char *op = args[0]->as.symbol;
+    int is_sum = strcmp(op, "+") == 0;
+    if (!is_sum && strcmp(op, "*") != 0) {
+        // Any other reducer is a defn, run as a fused loop with no steps
+        if (arg_count != 3) {
+            fprintf(stderr, "Error: reduce with %s requires an init value\n", op);
+            exit(1);
+        }
+        FunctionInfo *reduce_fn = lookup_step_function(cg, args[0], 2, "reduce");
+        generate_expr(cg, args[1]);
+        generate_fused_loop(cg, NULL, 0, REDUCER_CALL, reduce_fn, args[2]);
+        return;
+    }
+
+    if (arg_count == 2) {
+        generate_list_kernel(cg, is_sum ? "list-sum" : "list-product", &args[1], 1);
+        return;
+    }
+
+    generate_expr(cg, args[1]);  // Init
+    generate_list_kernel(cg, is_sum ? "list-sum" : "list-product", &args[2], 1);
+    emit_pop_double(cg->output, 0);
+    emit_pop_double(cg->output, 1);
+    if (is_sum) {
+        emit_fadd(cg->output);
+    } else {
+        emit_fmul(cg->output);
+    }
+    emit_push_double(cg->output, 0);
+}
+
+static int is_parallel_function(const char *symbol) {
+    return strcmp(symbol, "pmap") == 0 ||
+           strcmp(symbol, "preduce") == 0 ||
+           strcmp(symbol, "future") == 0 ||
+           strcmp(symbol, "deref") == 0;
+}
+
+// Locals of the enclosing function that a future or go body refers to
+static void collect_captures(ASTNode *node, const char *builtin, char **names, int *count) {
+    if (node->type == AST_SYMBOL) {
+        int is_let = 0;
+        int frame_offset = 0;
+        if (find_local_index(node->as.symbol, &is_let, &frame_offset) < 0) {
+            return;
+        }
+        for (int i = 0; i < *count; i++) {
+            if (strcmp(names[i], node->as.symbol) == 0) {
+                return;
+            }
+        }
+        if (*count == 8) {
+            fprintf(stderr, "Error: %s body captures more than 8 locals\n", builtin);
+            exit(1);
+        }
+        names[(*count)++] = node->as.symbol;
+    } else if (node->type == AST_LIST || node->type == AST_MAP) {
+        for (int i = 0; i < node->as.list.count; i++) {
+            collect_captures(node->as.list.elements[i], builtin, names, count);
+        }
+    }
+}
+
+// The body of a future or go block is lifted into a function taking the
+// captured locals; it is generated with the other user functions once main
+// is done. `spawn` receives its address, the capture count and the captures.
+static void generate_lifted_body(CodeGen *cg, const char *builtin, const char *spawn,
+                                 ASTNode **args, int arg_count) {
+    if (arg_count != 1) {
+        fprintf(stderr, "Error: %s requires exactly 1 argument\n", builtin);
+        exit(1);
+    }
+
+    char *captures[8];
+    int capture_count = 0;
+    collect_captures(args[0], builtin, captures, &capture_count);
+
+    char name[32];
+    sprintf(name, "%s-body-%d", builtin, cg->label_counter++);
+    add_function(cg->symbols, name, capture_count, captures, args[0]);
+    FunctionInfo *body = lookup_function(cg->symbols, name);
+
+    emit_comment(cg->output, "Lifted body: pass captured locals");
+    for (int i = 0; i < capture_count; i++) {
+        generate_symbol(cg, captures[i]);
+        if (!local_is_number(cg, captures[i])) {
+            emit_share_top(cg);
+        }
+    }
+    for (int i = capture_count - 1; i >= 0; i--) {
+        emit_pop_double(cg->output, i);
+    }
+    fprintf(cg->output, "    adrp x0, %s@PAGE\n", body->label);
+    fprintf(cg->output, "    add x0, x0, %s@PAGEOFF\n", body->label);
+    fprintf(cg->output, "    mov x1, #%d\n", capture_count);
+    emit_call(cg->output, spawn);
+    emit_push_value(cg->output, 0);
+}
+
+// Builtins in runtime/parallel.c, scheduled by runtime/scheduler.c
+static void generate_parallel_function(CodeGen *cg, const char *func, ASTNode **args, int arg_count) {
+    char comment[64];
+    snprintf(comment, sizeof(comment), "Parallel: %s", func);
+    emit_comment(cg->output, comment);
+
+    if (strcmp(func, "future") == 0) {
+        generate_lifted_body(cg, func, "_future_spawn", args, arg_count);
+        return;
+    }
+
+    if (strcmp(func, "deref") == 0) {
+        if (arg_count != 1) {
+            fprintf(stderr, "Error: deref requires exactly 1 argument\n");
+            exit(1);
+        }
+        generate_expr(cg, args[0]);
+        emit_pop_value(cg->output, 0);
+        emit_call(cg->output, "_deref");
+    } else if (strcmp(func, "pmap") == 0) {
+        if (arg_count != 2) {
+            fprintf(stderr, "Error: pmap requires exactly 2 arguments\n");
+            exit(1);
+        }
+        generate_function_arg(cg, args[0], 1, func);
+        generate_expr(cg, args[1]);
+        emit_pop_value(cg->output, 1);
+        emit_pop_value(cg->output, 0);
+        emit_call(cg->output, "_pmap");
+    } else {
+        // (preduce f init coll), f associative
+        if (arg_count != 3) {
+            fprintf(stderr, "Error: preduce requires a function, an init and a collection\n");
+            exit(1);
+        }
+        ASTNode *fn = args[0];
+        if (fn->type == AST_SYMBOL &&
+            (strcmp(fn->as.symbol, "+") == 0 || strcmp(fn->as.symbol, "*") == 0)) {
+            const char *label = strcmp(fn->as.symbol, "+") == 0 ? "_rt_add_function" : "_rt_mul_function";
+            fprintf(cg->output, "    adrp x0, %s@PAGE\n", label);
+            fprintf(cg->output, "    add x0, x0, %s@PAGEOFF\n", label);
+            emit_box_pointer(cg->output, 0, VALUE_TAG_OBJECT);
+            emit_push_value(cg->output, 0);
+        } else {
+            generate_function_arg(cg, fn, 2, func);
+        }
+        generate_expr(cg, args[1]);
+        generate_expr(cg, args[2]);
+        emit_pop_value(cg->output, 2);
+        emit_pop_value(cg->output, 1);
+        emit_pop_value(cg->output, 0);
+        emit_call(cg->output, "_preduce");
+    }
+    emit_push_value(cg->output, 0);
+}
+
+static int is_atom_function(const char *symbol) {
+    return strcmp(symbol, "atom") == 0 ||
+           strcmp(symbol, "reset!") == 0 ||
+           strcmp(symbol, "swap!") == 0;
+}
+
+// Atoms in runtime/atom.c; deref is shared with futures
+static void generate_atom_function(CodeGen *cg, const char *func, ASTNode **args, int arg_count) {
+    char comment[64];
+    snprintf(comment, sizeof(comment), "Atom: %s", func);
+    emit_comment(cg->output, comment);
+
+    if (strcmp(func, "atom") == 0) {
+        if (arg_count != 1) {
+            fprintf(stderr, "Error: atom requires exactly 1 argument\n");
+            exit(1);
+        }
+        generate_expr(cg, args[0]);
+        emit_pop_value(cg->output, 0);
+        emit_call(cg->output, "_atom_new");
+        emit_push_value(cg->output, 0);
+        return;
+    }
+
+    if (strcmp(func, "reset!") == 0) {
+        if (arg_count != 2) {
+            fprintf(stderr, "Error: reset! requires exactly 2 arguments\n");
+            exit(1);
+        }
+        generate_expr(cg, args[0]);
+        generate_expr(cg, args[1]);
+        emit_pop_value(cg->output, 1);
+        emit_pop_value(cg->output, 0);
+        emit_call(cg->output, "_atom_reset");
+        emit_push_value(cg->output, 0);
+        return;
+    }
+
+    // (swap! a f) / (swap! a f x)
+    if (arg_count != 2 && arg_count != 3) {
+        fprintf(stderr, "Error: swap! requires an atom, a function and an optional argument\n");
+        exit(1);
+    }
+
+    ASTNode *fn = args[1];
+    if (arg_count == 3 && fn->type == AST_SYMBOL &&
+        (strcmp(fn->as.symbol, "+") == 0 || strcmp(fn->as.symbol, "*") == 0)) {
+        // Numeric counters update in the CAS loop without a call
+        generate_expr(cg, args[0]);
+        generate_expr(cg, args[2]);
+        emit_pop_double(cg->output, 0);
+        emit_pop_value(cg->output, 0);
+        emit_call(cg->output, strcmp(fn->as.symbol, "+") == 0 ? "_atom_add" : "_atom_mul");
+        emit_push_double(cg->output, 0);
+        return;
+    }
+
+    generate_expr(cg, args[0]);
+    generate_function_arg(cg, fn, arg_count - 1, func);
+    if (arg_count == 3) {
+        generate_expr(cg, args[2]);
+        emit_pop_value(cg->output, 2);
+    }
+    emit_pop_value(cg->output, 1);
+    emit_pop_value(cg->output, 0);
+    emit_call(cg->output, arg_count == 3 ? "_atom_swap_with" : "_atom_swap");
+    emit_push_value(cg->output, 0);
+}
+
+static int is_channel_function(const char *symbol) {
+    return strcmp(symbol, "go") == 0 ||
+           strcmp(symbol, "chan") == 0 ||
+           strcmp(symbol, ">!") == 0 ||
+           strcmp(symbol, "<!") == 0 ||
+           strcmp(symbol, "close!") == 0;
+}
+
+// Green threads in runtime/fiber.c and channels in runtime/channel.c
+static void generate_channel_function(CodeGen *cg, const char *func, ASTNode **args, int arg_count) {
+    char comment[64];
+    snprintf(comment, sizeof(comment), "Channel: %s", func);
+    emit_comment(cg->output, comment);
+
+    if (strcmp(func, "go") == 0) {
+        generate_lifted_body(cg, func, "_go_spawn", args, arg_count);
+        return;
+    }
+
+    if (strcmp(func, "chan") == 0) {
+        // (chan) / (chan capacity)
+        if (arg_count > 1) {
+            fprintf(stderr, "Error: chan takes at most 1 argument\n");
+            exit(1);
+        }
+        if (arg_count == 1) {
+            generate_expr(cg, args[0]);
+            emit_pop_double(cg->output, 0);
+        } else {
+            fprintf(cg->output, "    fmov d0, #1.0\n");
+        }
+        emit_call(cg->output, "_chan_new");
+        emit_push_value(cg->output, 0);
+    } else if (strcmp(func, ">!") == 0) {
+        if (arg_count != 2) {
+            fprintf(stderr, "Error: >! requires exactly 2 arguments\n");
+            exit(1);
+        }
+        generate_expr(cg, args[0]);
+        generate_expr(cg, args[1]);
+        emit_pop_value(cg->output, 1);
+        emit_pop_value(cg->output, 0);
+        emit_call(cg->output, "_chan_send");
+        emit_push_double(cg->output, 0);
+    } else if (strcmp(func, "<!") == 0) {
+        // (<! ch) / (<! ch not-found), not-found once closed and drained
+        if (arg_count != 1 && arg_count != 2) {
+            fprintf(stderr, "Error: <! requires a channel and an optional not-found value\n");
+            exit(1);
+        }
+        generate_expr(cg, args[0]);
+        if (arg_count == 2) {
+            generate_expr(cg, args[1]);
+            emit_pop_value(cg->output, 1);
+        } else {
+            fprintf(cg->output, "    mov x1, #0\n");
+        }
+        emit_pop_value(cg->output, 0);
+        emit_call(cg->output, "_chan_recv");
+        emit_push_value(cg->output, 0);
+    } else {
+        if (arg_count != 1) {
+            fprintf(stderr, "Error: close! requires exactly 1 argument\n");
+            exit(1);
+        }
+        generate_expr(cg, args[0]);
+        emit_pop_value(cg->output, 0);
+        emit_call(cg->output, "_chan_close");
+        emit_push_value(cg->output, 0);
+    }
+}
+
+static int is_map_function(const char *symbol) {
+    return strcmp(symbol, "get") == 0 ||
+           strcmp(symbol, "assoc") == 0 ||
+           strcmp(symbol, "dissoc") == 0 ||
+           strcmp(symbol, "contains?") == 0 ||
+           strcmp(symbol, "count") == 0;
+}
+
+// Literal keys are hashed here with the runtime's own hash function, so the
+// generated code can call the *_hashed entry points and skip hashing.
+static int constant_key_hash(ASTNode *key, uint32_t *hash) {
+    if (key->type == AST_NUMBER) {
+        *hash = value_hash_number(key->as.number);
+        return 1;
+    }
+    if (key->type == AST_KEYWORD) {
+        *hash = value_hash_keyword(key->as.keyword);
+        return 1;
+    }
+    // Escapes are only decoded by the assembler, so skip those strings
+    if (key->type == AST_STRING && !strchr(key->as.string, '\\')) {
+        *hash = value_hash_bytes(key->as.string);
+        return 1;
+    }
+    return 0;
+}
+
+// Call a map builtin with map/key/... already in x0.., picking the
+// precomputed-hash variant when the key is a literal
+static void emit_map_call(CodeGen *cg, const char *name, ASTNode *key, int hash_reg) {
+    uint32_t hash;
+    char label[64];
+    if (constant_key_hash(key, &hash)) {
+        emit_load_imm32(cg->output, hash_reg, hash);
+        snprintf(label, sizeof(label), "_%s_hashed", name);
+    } else {
+        snprintf(label, sizeof(label), "_%s", name);
+    }
+    emit_call(cg->output, label);
+}
+
+// Map stays on top of the stack while each key/value pair is assoc'ed
+static void generate_assoc_pairs(CodeGen *cg, ASTNode **pairs, int pair_count) {
+    for (int i = 0; i < pair_count; i++) {
+        generate_expr(cg, pairs[i * 2]);      // Key
+        generate_expr(cg, pairs[i * 2 + 1]);  // Value
+        emit_pop_value(cg->output, 2);
+        emit_pop_value(cg->output, 1);
+        fprintf(cg->output, "    ldr x0, [sp]\n");
+        emit_map_call(cg, "map_assoc", pairs[i * 2], 3);
+        fprintf(cg->output, "    str x0, [sp]\n");
+    }
+}
+
+static void generate_map_literal(CodeGen *cg, ASTNode *node) {
+    emit_comment(cg->output, "Map literal");
+    emit_call(cg->output, "_create_map");
+    emit_push_value(cg->output, 0);
+    generate_assoc_pairs(cg, node->as.list.elements, node->as.list.count / 2);
+}
+
+static void generate_map_function(CodeGen *cg, const char *func, ASTNode **args, int arg_count) {
+    char comment[64];
+    snprintf(comment, sizeof(comment), "Map function: %s", func);
+    emit_comment(cg->output, comment);
+
+    if (strcmp(func, "get") == 0) {
+        if (arg_count != 2 && arg_count != 3) {
+            fprintf(stderr, "Error: get requires 2 or 3 arguments\n");
+            exit(1);
+        }
+        generate_expr(cg, args[0]);  // Map
+        generate_expr(cg, args[1]);  // Key
+        if (arg_count == 3) {
+            generate_expr(cg, args[2]);  // Not-found value
+            emit_pop_value(cg->output, 2);
+        } else {
+            fprintf(cg->output, "    mov x2, #0\n");  // 0.0
+        }
+        emit_pop_value(cg->output, 1);
+        emit_pop_value(cg->output, 0);
+        emit_map_call(cg, "map_get", args[1], 3);
+        emit_push_value(cg->output, 0);
+    } else if (strcmp(func, "assoc") == 0) {
+        if (arg_count < 3 || (arg_count - 1) % 2 != 0) {
+            fprintf(stderr, "Error: assoc requires a map and key/value pairs\n");
+            exit(1);
+        }
+        generate_expr(cg, args[0]);
+        generate_assoc_pairs(cg, &args[1], (arg_count - 1) / 2);
+    } else if (strcmp(func, "dissoc") == 0) {
+        if (arg_count < 2) {
+            fprintf(stderr, "Error: dissoc requires a map and at least one key\n");
+            exit(1);
+        }
+        generate_expr(cg, args[0]);
+        for (int i = 1; i < arg_count; i++) {
+            generate_expr(cg, args[i]);
+            emit_pop_value(cg->output, 1);
+            fprintf(cg->output, "    ldr x0, [sp]\n");
+            emit_map_call(cg, "map_dissoc", args[i], 2);
+            fprintf(cg->output, "    str x0, [sp]\n");
+        }
+    } else if (strcmp(func, "contains?") == 0) {
+        if (arg_count != 2) {
+            fprintf(stderr, "Error: contains? requires exactly 2 arguments\n");
+            exit(1);
+        }
+        generate_expr(cg, args[0]);
+        generate_expr(cg, args[1]);
+        emit_pop_value(cg->output, 1);
+        emit_pop_value(cg->output, 0);
+        emit_map_call(cg, "map_contains", args[1], 2);
+        emit_push_double(cg->output, 0);
+    } else if (strcmp(func, "count") == 0) {
+        if (arg_count != 1) {
+            fprintf(stderr, "Error: count requires exactly 1 argument\n");
+            exit(1);
+        }
+        generate_expr(cg, args[0]);
+        emit_pop_value(cg->output, 0);
+        emit_call(cg->output, "_count");
+        emit_push_double(cg->output, 0);
+    }
+}
+
+static void generate_let(CodeGen *cg, ASTNode **args, int arg_count) {
+    if (arg_count != 2) {
+        fprintf(stderr, "Error: let requires exactly 2 arguments (bindings body)\n");
+        exit(1);
+    }
+
+    ASTNode *bindings = args[0];
+    ASTNode *body = args[1];
+
+    if (bindings->type != AST_LIST) {
+        fprintf(stderr, "Error: let bindings must be a vector/list\n");
+        exit(1);
+    }
+
+    if (bindings->as.list.count % 2 != 0) {
+        fprintf(stderr, "Error: let bindings must have even number of elements\n");
+        exit(1);
+    }
+
+    int binding_count = bindings->as.list.count / 2;
+    char **binding_names = malloc(binding_count * sizeof(char *));
+    int *binding_numbers = malloc(binding_count * sizeof(int));
+
+    emit_comment(cg->output, "Let: evaluate bindings");
+
+    // Calculate where bindings will be stored relative to frame pointer
+    // Account for parent context's bindings AND parameters
+    int parent_bindings = 0;
+    if (current_context) {
+        parent_bindings = current_context->param_count + current_context->let_count;
+    }
+    int let_frame_offset = parent_bindings;
+
+    // Evaluate each binding and push to stack
+    for (int i = 0; i < binding_count; i++) {
+        ASTNode *name_node = bindings->as.list.elements[i * 2];
+        ASTNode *value_node = bindings->as.list.elements[i * 2 + 1];
+
+        if (name_node->type != AST_SYMBOL) {
+            fprintf(stderr, "Error: let binding name must be a symbol\n");
+            free(binding_names);
+            free(binding_numbers);
+            exit(1);
+        }
+
+        binding_names[i] = name_node->as.symbol;
+        binding_numbers[i] = is_number_expr(cg, value_node);
+
+        // Evaluate the value expression
+        generate_expr(cg, value_node);
+    }
+
+    // Create new context with let bindings
+    LocalContext let_ctx;
+    let_ctx.param_names = current_context ? current_context->param_names : NULL;
+    let_ctx.param_count = current_context ? current_context->param_count : 0;
+    let_ctx.let_names = binding_names;
+    let_ctx.let_numbers = binding_numbers;
+    let_ctx.let_count = binding_count;
+    let_ctx.let_frame_offset = let_frame_offset;
+    let_ctx.parent = current_context;
+
+    LocalContext *saved_context = current_context;
+    current_context = &let_ctx;
+
+    emit_comment(cg->output, "Let: evaluate body");
+    generate_expr(cg, body);
+
+    current_context = saved_context;
+
+    emit_comment(cg->output, "Let: cleanup bindings");
+    // Pop the result into d0 first
+    emit_pop_double(cg->output, 0);
+
+    // Pop all the let bindings
+    if (binding_count > 0) {
+        fprintf(cg->output, "    add sp, sp, #%d\n", binding_count * 16);
+    }
+
+    // Push the result back
+    emit_push_double(cg->output, 0);
+
+    free(binding_names);
+    free(binding_numbers);
+}
+
+// Code moved out of line goes to a buffer that is appended after the
+// function's return, see flush_cold_code
+static void begin_cold_code(CodeGen *cg, ASTNode *node) {
+    if (!cg->cold_output) {
+        cg->cold_output = open_memstream(&cg->cold_text, &cg->cold_length);
+    }
+    cg->output = cg->cold_output;
+    cg->loc_line = 0;
+    set_source_loc(cg, node->line, node->column);
+}
+
+static void end_cold_code(CodeGen *cg, FILE *hot_output, ASTNode *node) {
+    cg->output = hot_output;
+    cg->loc_line = 0;
+    set_source_loc(cg, node->line, node->column);
+}
+
+static void flush_cold_code(CodeGen *cg) {
+    if (!cg->cold_output) {
+        return;
+    }
+    fclose(cg->cold_output);
+    emit_comment(cg->output, "Cold code");
+    fwrite(cg->cold_text, 1, cg->cold_length, cg->output);
+    free(cg->cold_text);
+    cg->cold_output = NULL;
+}
+
+static void generate_if_arm(CodeGen *cg, ASTNode *arm, const char *counter, int is_else) {
+    emit_comment(cg->output, is_else ? "If: else branch" : "If: then branch");
+    if (counter) {
+        char label[48];
+        snprintf(label, sizeof(label), "%s%s", counter, is_else ? "_else" : "");
+        emit_increment_counter(cg->output, label);
+    }
+    generate_expr(cg, arm);
+}
+
+// With --profile-use the more often taken arm falls through, and an arm
+// taken under 1/COLD_RATIO as often is moved after the function's return,
+// out of the hot path
+static void generate_if(CodeGen *cg, ASTNode *node, ASTNode **args, int arg_count) {
+    if (arg_count != 3) {
+        fprintf(stderr, "Error: if requires exactly 3 arguments (condition then else)\n");
+        exit(1);
+    }
+
+    const char *counter = NULL;
+    if (cg->options->profile_generate && node->line > 0) {
+        counter = add_branch_counter(cg, node);
+    }
+    const ProfileBranch *branch = NULL;
+    if (cg->options->profile) {
+        branch = profile_branch(cg->options->profile, node->line, node->column);
+    }
+    int else_first = branch && branch->else_count > branch->then_count;
+    long hot = branch ? (else_first ? branch->else_count : branch->then_count) : 0;
+    long cold = branch ? (else_first ? branch->then_count : branch->else_count) : 0;
+    int outline = hot > 0 && cold * COLD_RATIO < hot && cg->output != cg->cold_output;
+
+    char other_label[32];
+    char end_label[32];
+    sprintf(other_label, "%s_%d", else_first ? "L_then" : "L_else", cg->label_counter);
+    sprintf(end_label, "L_end_%d", cg->label_counter);
     cg->label_counter++;
 
     emit_comment(cg->output, "If: evaluate condition");
@@ -531,16 +1952,28 @@ static void generate_if(CodeGen *cg, ASTNode **args, int arg_count) {
     emit_comment(cg->output, "If: check condition");
     emit_pop_double(cg->output, 0);
     fprintf(cg->output, "    fcmp d0, #0.0\n");
-    emit_branch_eq(cg->output, else_label);
+    if (else_first) {
+        emit_branch_ne(cg->output, other_label);
+    } else {
+        emit_branch_eq(cg->output, other_label);
+    }
 
-    emit_comment(cg->output, "If: then branch");
-    generate_expr(cg, args[1]);
-    emit_branch(cg->output, end_label);
+    generate_if_arm(cg, args[else_first ? 2 : 1], counter, else_first);
 
-    emit_comment(cg->output, "If: else branch");
-    emit_label(cg->output, else_label);
-    generate_expr(cg, args[2]);
+    if (outline) {
+        emit_label(cg->output, end_label);
+        FILE *hot_output = cg->output;
+        begin_cold_code(cg, node);
+        emit_label(cg->output, other_label);
+        generate_if_arm(cg, args[else_first ? 1 : 2], counter, !else_first);
+        emit_branch(cg->output, end_label);
+        end_cold_code(cg, hot_output, node);
+        return;
+    }
 
+    emit_branch(cg->output, end_label);
+    emit_label(cg->output, other_label);
+    generate_if_arm(cg, args[else_first ? 1 : 2], counter, !else_first);
     emit_label(cg->output, end_label);
 }
 
@@ -573,6 +2006,22 @@ static void generate_function_call(CodeGen *cg, const char *name, ASTNode **args
     emit_push_double(cg->output, 0);
 }
 
+// Names generate_list handles itself, which shadow user functions
+int is_builtin(const char *symbol) {
+    static const char *forms[] = {
+        "map", "reduce", "transduce", "into", "if", "let", "quote", "defn", "defn-memo", "def", NULL
+    };
+    for (int i = 0; forms[i]; i++) {
+        if (strcmp(symbol, forms[i]) == 0) {
+            return 1;
+        }
+    }
+    return is_operator(symbol) || is_comparison(symbol) || is_string_function(symbol) ||
+           is_list_function(symbol) || is_map_function(symbol) || is_list_kernel(symbol) ||
+           is_seq_function(symbol) || is_channel_function(symbol) ||
+           is_atom_function(symbol) || is_parallel_function(symbol);
+}
+
 static void generate_list(CodeGen *cg, ASTNode *node) {
     if (node->as.list.count == 0) {
         fprintf(stderr, "Error: Empty list not allowed\n");
@@ -580,6 +2029,29 @@ static void generate_list(CodeGen *cg, ASTNode *node) {
     }
 
     ASTNode *first = node->as.list.elements[0];
+
+    // (:key map) and (:key map default) look the keyword up in the map
+    if (first->type == AST_KEYWORD) {
+        int arg_count = node->as.list.count - 1;
+        if (arg_count != 1 && arg_count != 2) {
+            fprintf(stderr, "Error: Keyword lookup requires 1 or 2 arguments\n");
+            exit(1);
+        }
+        generate_expr(cg, node->as.list.elements[1]);  // Map
+        generate_keyword(cg, first->as.keyword);
+        if (arg_count == 2) {
+            generate_expr(cg, node->as.list.elements[2]);
+            emit_pop_value(cg->output, 2);
+        } else {
+            fprintf(cg->output, "    mov x2, #0\n");  // 0.0
+        }
+        emit_pop_value(cg->output, 1);
+        emit_pop_value(cg->output, 0);
+        emit_map_call(cg, "map_get", first, 3);
+        emit_push_value(cg->output, 0);
+        return;
+    }
+
     if (first->type != AST_SYMBOL) {
         fprintf(stderr, "Error: First element of list must be a symbol\n");
         exit(1);
@@ -589,7 +2061,9 @@ static void generate_list(CodeGen *cg, ASTNode *node) {
     ASTNode **args = &node->as.list.elements[1];
     int arg_count = node->as.list.count - 1;
 
-    if (is_operator(symbol)) {
+    if (node->scratch) {
+        generate_scratch_literal(cg, symbol, args, arg_count);
+    } else if (is_operator(symbol)) {
         generate_operator(cg, symbol, args, arg_count);
     } else if (is_comparison(symbol)) {
         generate_comparison(cg, symbol, args, arg_count);
@@ -597,12 +2071,34 @@ static void generate_list(CodeGen *cg, ASTNode *node) {
         generate_string_function(cg, symbol, args, arg_count);
     } else if (is_list_function(symbol)) {
         generate_list_function(cg, symbol, args, arg_count);
+    } else if (is_map_function(symbol)) {
+        generate_map_function(cg, symbol, args, arg_count);
+    } else if (is_list_kernel(symbol)) {
+        generate_list_kernel(cg, symbol, args, arg_count);
+    } else if (is_seq_function(symbol)) {
+        generate_seq_function(cg, symbol, args, arg_count);
+    } else if (strcmp(symbol, "map") == 0) {
+        generate_map(cg, args, arg_count);
+    } else if (strcmp(symbol, "reduce") == 0) {
+        generate_reduce(cg, args, arg_count);
+    } else if (is_channel_function(symbol)) {
+        generate_channel_function(cg, symbol, args, arg_count);
+    } else if (is_atom_function(symbol)) {
+        generate_atom_function(cg, symbol, args, arg_count);
+    } else if (is_parallel_function(symbol)) {
+        generate_parallel_function(cg, symbol, args, arg_count);
+    } else if (strcmp(symbol, "transduce") == 0) {
+        generate_transduce(cg, args, arg_count);
+    } else if (strcmp(symbol, "into") == 0) {
+        generate_into(cg, args, arg_count);
     } else if (strcmp(symbol, "if") == 0) {
-        generate_if(cg, args, arg_count);
+        generate_if(cg, node, args, arg_count);
     } else if (strcmp(symbol, "let") == 0) {
         generate_let(cg, args, arg_count);
-    } else if (strcmp(symbol, "defn") == 0) {
-        fprintf(stderr, "Error: defn not yet supported in this context\n");
+    } else if (strcmp(symbol, "quote") == 0) {
+        generate_quote(cg, args, arg_count);
+    } else if (strcmp(symbol, "defn") == 0 || strcmp(symbol, "defn-memo") == 0) {
+        fprintf(stderr, "Error: %s not yet supported in this context\n", symbol);
         exit(1);
     } else {
         generate_function_call(cg, symbol, args, arg_count);
@@ -624,6 +2120,11 @@ static void generate_symbol(CodeGen *cg, const char *symbol) {
     int frame_offset = 0;
     int local_idx = find_local_index(symbol, &is_let, &frame_offset);
     if (local_idx < 0) {
+        FunctionInfo *func = lookup_function(cg->symbols, symbol);
+        if (func) {
+            generate_function_value(cg, func);
+            return;
+        }
         fprintf(stderr, "Error: Undefined symbol: %s\n", symbol);
         exit(1);
     }
@@ -637,13 +2138,49 @@ static void generate_symbol(CodeGen *cg, const char *symbol) {
         emit_push_double(cg->output, 0);
     } else {
         emit_comment(cg->output, "Load parameter");
-        int offset = -(current_context->param_count - local_idx) * 16;
+        // Parameters are saved in order below the frame pointer
+        int offset = -(local_idx + 1) * 16;
         fprintf(cg->output, "    ldr d0, [x29, #%d]\n", offset);
         emit_push_double(cg->output, 0);
     }
 }
 
+// With -g, instructions belong to the innermost form being generated
+static void set_source_loc(CodeGen *cg, int line, int column) {
+    if (cg->options->debug_info && line > 0 &&
+        (line != cg->loc_line || column != cg->loc_column)) {
+        emit_loc(cg->output, line, column);
+        cg->loc_line = line;
+        cg->loc_column = column;
+    }
+}
+
+static void generate_expr_at(CodeGen *cg, ASTNode *node);
+
 static void generate_expr(CodeGen *cg, ASTNode *node) {
+    if (node->type != AST_LIST && node->type != AST_MAP) {
+        generate_expr_at(cg, node);
+        return;
+    }
+
+    // The enclosing form's own instructions follow this one's
+    int line = cg->loc_line;
+    int column = cg->loc_column;
+    set_source_loc(cg, node->line, node->column);
+    generate_expr_at(cg, node);
+    set_source_loc(cg, line, column);
+}
+
+static void generate_expr_at(CodeGen *cg, ASTNode *node) {
+    if (node->cse_reuse) {
+        emit_comment(cg->output, "Reuse common subexpression");
+        fprintf(cg->output, "    ldr x0, [x29, #%d]\n", cg->cse_offset + node->cse_slot * 16);
+        // Already shared: pure values are numbers, container elements or
+        // locals that the reuse reads again
+        emit_push_value(cg->output, 0);
+        return;
+    }
+
     switch (node->type) {
         case AST_NUMBER:
             generate_number(cg, node->as.number);
@@ -651,15 +2188,33 @@ static void generate_expr(CodeGen *cg, ASTNode *node) {
 
         case AST_SYMBOL:
             generate_symbol(cg, node->as.symbol);
+            if (!node->last_use && !node->consumed && is_local(cg, node->as.symbol) &&
+                !local_is_number(cg, node->as.symbol)) {
+                emit_share_top(cg);
+            }
             break;
 
         case AST_STRING:
             generate_string(cg, node->as.string);
             break;
 
+        case AST_KEYWORD:
+            generate_keyword(cg, node->as.keyword);
+            break;
+
         case AST_LIST:
             generate_list(cg, node);
             break;
+
+        case AST_MAP:
+            generate_map_literal(cg, node);
+            break;
+    }
+
+    if (node->cse_slot >= 0) {
+        emit_comment(cg->output, "Keep common subexpression");
+        fprintf(cg->output, "    ldr x0, [sp]\n");
+        fprintf(cg->output, "    str x0, [x29, #%d]\n", cg->cse_offset + node->cse_slot * 16);
     }
 }
 
@@ -667,7 +2222,8 @@ static int is_defn(ASTNode *node) {
     return node->type == AST_LIST &&
            node->as.list.count > 0 &&
            node->as.list.elements[0]->type == AST_SYMBOL &&
-           strcmp(node->as.list.elements[0]->as.symbol, "defn") == 0;
+           (strcmp(node->as.list.elements[0]->as.symbol, "defn") == 0 ||
+            strcmp(node->as.list.elements[0]->as.symbol, "defn-memo") == 0);
 }
 
 static int is_def(ASTNode *node) {
@@ -695,46 +2251,178 @@ static int is_top_level_container(ASTNode *node) {
     return 0;
 }
 
+static void generate_def_init(CodeGen *cg, ASTNode *node) {
+    Variable *var = lookup_variable(cg, node->as.list.elements[1]->as.symbol);
+    if (!var || !var->init) {
+        return;
+    }
+
+    emit_comment(cg->output, "Initialize variable");
+    uniqueness_analyze(var->init);
+    generate_expr(cg, var->init);
+    if (!is_number_expr(cg, var->init)) {
+        emit_share_top(cg);
+    }
+    emit_pop_double(cg->output, 0);
+    fprintf(cg->output, "    adrp x0, %s@PAGE\n", var->label);
+    fprintf(cg->output, "    add x0, x0, %s@PAGEOFF\n", var->label);
+    fprintf(cg->output, "    str d0, [x0]\n");
+}
+
+// Short description of a top-level form for the --perf-counters table:
+// its position and head, e.g. "#2 (def total ...)"
+static void describe_form(ASTNode *node, int index, char *buf, size_t size) {
+    if (node->type == AST_LIST && node->as.list.count > 0 &&
+        node->as.list.elements[0]->type == AST_SYMBOL) {
+        const char *head = node->as.list.elements[0]->as.symbol;
+        if (is_def(node)) {
+            snprintf(buf, size, "#%d (%s %s ...)", index, head,
+                     node->as.list.elements[1]->as.symbol);
+        } else {
+            snprintf(buf, size, "#%d (%s ...)", index, head);
+        }
+    } else {
+        snprintf(buf, size, "#%d expression", index);
+    }
+}
+
+static void emit_perf_scope_begin(CodeGen *cg, ASTNode *node, int index) {
+    char desc[128];
+    describe_form(node, index, desc, sizeof(desc));
+    const char *label = add_string_constant(cg, desc);
+    fprintf(cg->output, "    mov x0, #%d\n", index);
+    fprintf(cg->output, "    adrp x1, %s@PAGE\n", label);
+    fprintf(cg->output, "    add x1, x1, %s@PAGEOFF\n", label);
+    emit_call(cg->output, "_perf_scope_begin");
+}
+
+static void emit_perf_scope_end(CodeGen *cg, int index) {
+    fprintf(cg->output, "    mov x0, #%d\n", index);
+    emit_call(cg->output, "_perf_scope_end");
+}
+
+// Evaluates one top-level form: initializes a def that is not a literal,
+// or prints the value of an expression. With --perf-counters the form
+// runs inside a counter scope; printing is left outside it.
+static void generate_top_level_form(CodeGen *cg, ASTNode *node, int *perf_index) {
+    int perf = cg->options->perf_counters;
+    if (is_defn(node)) {
+        return;
+    }
+    if (is_def(node)) {
+        Variable *var = lookup_variable(cg, node->as.list.elements[1]->as.symbol);
+        if (!var || !var->init) {
+            return;
+        }
+        if (perf) {
+            emit_perf_scope_begin(cg, node, *perf_index);
+        }
+        generate_def_init(cg, node);
+        if (perf) {
+            emit_perf_scope_end(cg, (*perf_index)++);
+        }
+        return;
+    }
+
+    if (perf) {
+        emit_perf_scope_begin(cg, node, *perf_index);
+    }
+    emit_comment(cg->output, "Evaluate expression");
+    uniqueness_analyze(node);
+    generate_expr(cg, node);
+    if (perf) {
+        emit_perf_scope_end(cg, (*perf_index)++);
+    }
+
+    emit_comment(cg->output, "Pop result and print");
+    emit_pop_value(cg->output, 0);
+    emit_call(cg->output, "_print_value");
+}
+
 static void generate_main(CodeGen *cg, ASTNode *ast) {
     emit_text_section_start(cg->output);
     emit_function_start(cg->output, "_main");
+    cg->loc_line = 0;
+    set_source_loc(cg, ast->line, ast->column);
     emit_function_prologue(cg->output);
 
+    if (cg->options->stats) {
+        emit_comment(cg->output, "Report runtime stats at exit");
+        fprintf(cg->output, "    adrp x0, .L_defn_stats@PAGE\n");
+        fprintf(cg->output, "    add x0, x0, .L_defn_stats@PAGEOFF\n");
+        emit_call(cg->output, "_rt_stats_start");
+    }
+    if (cg->options->profile_generate) {
+        emit_comment(cg->output, "Write the profile at exit");
+        fprintf(cg->output, "    adrp x0, .L_profile@PAGE\n");
+        fprintf(cg->output, "    add x0, x0, .L_profile@PAGEOFF\n");
+        emit_call(cg->output, "_rt_profile_start");
+    }
+
+    int perf_index = 0;
     if (is_top_level_container(ast)) {
         for (int i = 0; i < ast->as.list.count; i++) {
-            if (!is_defn(ast->as.list.elements[i]) && !is_def(ast->as.list.elements[i])) {
-                emit_comment(cg->output, "Evaluate expression");
-                generate_expr(cg, ast->as.list.elements[i]);
-
-                emit_comment(cg->output, "Pop result and print");
-                emit_pop_double(cg->output, 0);
-                emit_call(cg->output, "_print_double");
-            }
+            generate_top_level_form(cg, ast->as.list.elements[i], &perf_index);
         }
-    } else if (!is_defn(ast) && !is_def(ast)) {
-        emit_comment(cg->output, "Evaluate expression");
-        generate_expr(cg, ast);
-
-        emit_comment(cg->output, "Pop result and print");
-        emit_pop_double(cg->output, 0);
-        emit_call(cg->output, "_print_double");
+    } else {
+        generate_top_level_form(cg, ast, &perf_index);
     }
 
     emit_comment(cg->output, "Return 0");
     fprintf(cg->output, "    mov w0, #0\n");
     emit_function_epilogue(cg->output);
+    flush_cold_code(cg);
+    emit_function_end(cg->output);
+}
+
+// (defn-memo name {:max n :evict :clock|:clear} [params] body), the map
+// being optional
+static void parse_memo_options(FunctionInfo *func, ASTNode *options) {
+    func->memo = 1;
+    func->memo_max_entries = MEMO_DEFAULT_MAX_ENTRIES;
+    func->memo_evict = MEMO_EVICT_CLOCK;
+    if (!options) {
+        return;
+    }
+
+    for (int i = 0; i + 1 < options->as.list.count; i += 2) {
+        ASTNode *key = options->as.list.elements[i];
+        ASTNode *val = options->as.list.elements[i + 1];
+        if (key->type == AST_KEYWORD && strcmp(key->as.keyword, "max") == 0 &&
+            val->type == AST_NUMBER && val->as.number >= 1) {
+            func->memo_max_entries = (long)val->as.number;
+        } else if (key->type == AST_KEYWORD && strcmp(key->as.keyword, "evict") == 0 &&
+                   val->type == AST_KEYWORD && strcmp(val->as.keyword, "clock") == 0) {
+            func->memo_evict = MEMO_EVICT_CLOCK;
+        } else if (key->type == AST_KEYWORD && strcmp(key->as.keyword, "evict") == 0 &&
+                   val->type == AST_KEYWORD && strcmp(val->as.keyword, "clear") == 0) {
+            func->memo_evict = MEMO_EVICT_CLEAR;
+        } else {
+            fprintf(stderr, "Error: defn-memo options are :max <count> and :evict :clock or :clear\n");
+            exit(1);
+        }
+    }
 }
 
 static void collect_functions_from_node(CodeGen *cg, ASTNode *node) {
     if (is_defn(node)) {
-        if (node->as.list.count < 4) {
-            fprintf(stderr, "Error: defn requires at least 3 arguments\n");
+        const char *form = node->as.list.elements[0]->as.symbol;
+        int memo = strcmp(form, "defn-memo") == 0;
+        ASTNode *options = NULL;
+        int first = 2;
+        if (memo && node->as.list.count > 2 && node->as.list.elements[2]->type == AST_MAP) {
+            options = node->as.list.elements[2];
+            first = 3;
+        }
+
+        if (node->as.list.count < first + 2) {
+            fprintf(stderr, "Error: %s requires at least 3 arguments\n", form);
             exit(1);
         }
 
         ASTNode *name_node = node->as.list.elements[1];
-        ASTNode *params_node = node->as.list.elements[2];
-        ASTNode *body_node = node->as.list.elements[3];
+        ASTNode *params_node = node->as.list.elements[first];
+        ASTNode *body_node = node->as.list.elements[first + 1];
 
         if (name_node->type != AST_SYMBOL) {
             fprintf(stderr, "Error: Function name must be a symbol\n");
@@ -755,8 +2443,16 @@ static void collect_functions_from_node(CodeGen *cg, ASTNode *node) {
             param_names[i] = params_node->as.list.elements[i]->as.symbol;
         }
 
+        if (memo && params_node->as.list.count > 8) {
+            fprintf(stderr, "Error: defn-memo supports at most 8 parameters\n");
+            exit(1);
+        }
+
         add_function(cg->symbols, name_node->as.symbol,
                     params_node->as.list.count, param_names, body_node);
+        if (memo) {
+            parse_memo_options(lookup_function(cg->symbols, name_node->as.symbol), options);
+        }
 
         free(param_names);
     } else if (is_def(node)) {
@@ -768,12 +2464,13 @@ static void collect_functions_from_node(CodeGen *cg, ASTNode *node) {
             exit(1);
         }
 
-        if (value_node->type != AST_NUMBER) {
-            fprintf(stderr, "Error: Variable value must be a number\n");
-            exit(1);
+        if (value_node->type == AST_NUMBER) {
+            add_variable(cg, name_node->as.symbol, value_node->as.number);
+        } else {
+            // Starts as 0.0, set when main reaches the def
+            Variable *var = add_variable(cg, name_node->as.symbol, 0.0);
+            var->init = value_node;
         }
-
-        add_variable(cg, name_node->as.symbol, value_node->as.number);
     }
 }
 
@@ -787,20 +2484,84 @@ static void collect_functions(CodeGen *cg, ASTNode *ast) {
     }
 }
 
+// A def whose value partial evaluation reduced to a literal is stored in
+// the data section like any other constant def
+static void fold_variable_inits(CodeGen *cg) {
+    for (int i = 0; i < cg->var_count; i++) {
+        Variable *var = cg->variables[i];
+        if (var->init && var->init->type == AST_NUMBER) {
+            var->value = var->init->as.number;
+            var->init = NULL;
+        }
+    }
+}
+
+// Loads the MemoCache, frame and arity arguments of memo_lookup and
+// memo_store, which read the saved parameters through the frame pointer
+static void emit_memo_call(CodeGen *cg, FunctionInfo *func) {
+    char label[256];
+    memo_cache_label(func, label, sizeof(label));
+    fprintf(cg->output, "    adrp x0, %s@PAGE\n", label);
+    fprintf(cg->output, "    add x0, x0, %s@PAGEOFF\n", label);
+    fprintf(cg->output, "    mov x1, x29\n");
+    fprintf(cg->output, "    mov x2, #%d\n", func->arity);
+}
+
+// Slots above the frame record hold what must not move with the operand
+// stack: the scratch mark at [x29, #16] for functions with call-local
+// collections, released to on return, then the CSE slots
 static void generate_function(CodeGen *cg, FunctionInfo *func) {
+    int uses_scratch = escape_analyze(func->body) > 0;
+    int cse_slots = cse_analyze(func->body, func->param_names, func->arity, cg->symbols);
+    uniqueness_analyze(func->body);
+    int frame_extra = (uses_scratch + cse_slots) * 16;
+    cg->cse_offset = 16 + uses_scratch * 16;
+
     fprintf(cg->output, "\n");
     emit_function_start(cg->output, func->label);
-    emit_function_prologue(cg->output);
+    cg->loc_line = 0;
+    set_source_loc(cg, func->body->line, func->body->column);
+    if (frame_extra) {
+        fprintf(cg->output, "    sub sp, sp, #%d\n", frame_extra);
+        fprintf(cg->output, "    .cfi_def_cfa_offset %d\n", frame_extra);
+    }
+    emit_function_prologue_above(cg->output, frame_extra);
+
+    if (counts_calls(cg)) {
+        char label[256];
+        call_counter_label(func, label, sizeof(label));
+        emit_comment(cg->output, "Count the call");
+        emit_increment_counter(cg->output, label);
+    }
 
     emit_comment(cg->output, "Save parameters to stack");
     for (int i = 0; i < func->arity && i < 8; i++) {
         fprintf(cg->output, "    str d%d, [sp, #-16]!\n", i);
     }
 
+    if (uses_scratch) {
+        emit_comment(cg->output, "Mark scratch region");
+        emit_call(cg->output, "_scratch_mark");
+        fprintf(cg->output, "    str x0, [x29, #16]\n");
+    }
+
+    char memo_done_label[32];
+    if (func->memo) {
+        sprintf(memo_done_label, "L_memo_done_%d", cg->label_counter++);
+        emit_comment(cg->output, "Memoized: return the cached result if there is one");
+        emit_memo_call(cg, func);
+        fprintf(cg->output, "    sub sp, sp, #16\n");
+        fprintf(cg->output, "    mov x3, sp\n");
+        emit_call(cg->output, "_memo_lookup");
+        emit_pop_double(cg->output, 0);
+        fprintf(cg->output, "    cbnz x0, %s\n", memo_done_label);
+    }
+
     LocalContext ctx;
     ctx.param_names = func->param_names;
     ctx.param_count = func->arity;
     ctx.let_names = NULL;
+    ctx.let_numbers = NULL;
     ctx.let_count = 0;
     ctx.let_frame_offset = 0;
     ctx.parent = NULL;
@@ -814,25 +2575,99 @@ static void generate_function(CodeGen *cg, FunctionInfo *func) {
     emit_comment(cg->output, "Pop result into d0");
     emit_pop_double(cg->output, 0);
 
+    if (func->memo) {
+        emit_comment(cg->output, "Cache the result");
+        emit_memo_call(cg, func);
+        emit_call(cg->output, "_memo_store");
+        emit_label(cg->output, memo_done_label);
+    }
+
+    if (uses_scratch) {
+        emit_comment(cg->output, "Release scratch region, keeping the result in its slot");
+        fprintf(cg->output, "    ldr x0, [x29, #16]\n");
+        fprintf(cg->output, "    str d0, [x29, #16]\n");
+        emit_call(cg->output, "_scratch_release");
+        fprintf(cg->output, "    ldr d0, [x29, #16]\n");
+    }
+
+    if (frame_extra) {
+        fprintf(cg->output, "    mov sp, x29\n");
+        fprintf(cg->output, "    ldp x29, x30, [sp], #16\n");
+        fprintf(cg->output, "    add sp, sp, #%d\n", frame_extra);
+        emit_return(cg->output);
+        flush_cold_code(cg);
+        emit_function_end(cg->output);
+        return;
+    }
+
     emit_function_epilogue(cg->output);
+    flush_cold_code(cg);
+    emit_function_end(cg->output);
 }
 
+// Generating a function can lift more (future bodies), so this is called
+// again after main and picks up where it left off. Functions the program
+// never calls are left out, and with them the constants only they use.
 static void generate_user_functions(CodeGen *cg) {
-    for (int i = 0; i < cg->symbols->function_count; i++) {
-        generate_function(cg, cg->symbols->functions[i]);
+    for (; cg->functions_emitted < cg->symbols->function_count; cg->functions_emitted++) {
+        FunctionInfo *func = cg->symbols->functions[cg->functions_emitted];
+        if (func->reachable) {
+            generate_function(cg, func);
+        }
     }
 }
 
-void generate_asm(ASTNode *ast, const char *output_file) {
+void generate_asm(ASTNode *ast, FILE *output, const CodegenOptions *options) {
     CodeGen cg;
-    init_codegen(&cg, output_file);
+    init_codegen(&cg, output, options);
 
+    phase_begin("collect_functions");
     collect_functions(&cg, ast);
+    phase_end();
+
+    phase_begin("partial_eval");
+    int folded = partial_eval(cg.symbols, ast);
+    fold_variable_inits(&cg);
+    phase_end();
+
+    int inlined = 0;
+    if (options->profile) {
+        phase_begin("inline");
+        inlined = inline_hot_calls(cg.symbols, ast, options->profile);
+        phase_end();
+    }
+
+    phase_begin("reachability");
+    int unreachable = mark_reachable(cg.symbols, ast);
+    phase_end();
 
     emit_header(cg.output);
+    if (options->debug_info) {
+        emit_debug_file(cg.output, options->source_dir, options->source_name);
+    }
+    phase_begin("generate_user_functions");
     generate_user_functions(&cg);
+    phase_end();
+    phase_begin("generate_main");
     generate_main(&cg, ast);
+    phase_end();
+    phase_begin("generate_user_functions");
+    generate_user_functions(&cg);
+    phase_end();
+    phase_begin("emit_data_section");
+    if (options->debug_info) {
+        emit_debug_info(cg.output, options->source_dir, options->source_name);
+    }
     emit_data_section(&cg);
+    phase_end();
+
+    time_report_count("functions", cg.symbols->function_count);
+    time_report_count("functions_emitted", cg.symbols->function_count - unreachable);
+    time_report_count("calls_folded", folded);
+    time_report_count("calls_inlined", inlined);
+    time_report_count("float_constants", cg.float_count + cg.var_count);
+    time_report_count("string_constants", cg.string_count);
+    time_report_count("keyword_constants", cg.keyword_count);
 
     cleanup_codegen(&cg);
 }
@@ -0,0 +1,401 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cse.h"
+#include "codegen.h"
+
+// Common subexpression elimination over a function body.
+//
+// Expressions are numbered by value: two calls are the same value when
+// they apply the same pure function to the same values, where a local is
+// identified by its binding rather than its name, so a let that shadows
+// a parameter starts a different value. Pure functions are the numeric
+// builtins, str-length, str-char-at, first, list-count and defns that
+// partial evaluation found pure.
+//
+// A later copy can reuse an earlier one when the earlier one has always
+// run by then: it is in an if's test and the later copy in a branch, in a
+// let binding and the later copy in the body or a later binding, or in an
+// earlier argument of a call that evaluates its arguments in order. The
+// earlier copy must not itself sit in an if branch below that point.
+// Only forms whose codegen is known to follow this order are entered;
+// anything else, including future and go bodies, is left alone.
+//
+// Larger expressions are matched first, so the inner calls of a reused
+// copy are never looked at again.
+
+#define MAX_CSE_SLOTS 64
+
+typedef struct PathStep {
+    ASTNode *node;
+    int child;  // Index into node's elements taken towards the occurrence
+} PathStep;
+
+typedef struct Occurrence {
+    ASTNode *node;
+    char *key;
+    int size;
+    int order;  // Preorder index, which is evaluation order
+    PathStep *path;
+    int path_len;
+} Occurrence;
+
+typedef struct Scope {
+    char **names;
+    char **ids;
+    int count;
+    struct Scope *parent;
+} Scope;
+
+typedef struct Cse {
+    SymbolTable *symbols;
+    PathStep path[256];
+    int path_len;
+    Occurrence *occurrences;
+    int count;
+    int capacity;
+    int order;
+    int next_binding;
+} Cse;
+
+static const char *head_symbol(ASTNode *node) {
+    if (node->type != AST_LIST || node->as.list.count == 0 ||
+        node->as.list.elements[0]->type != AST_SYMBOL) {
+        return NULL;
+    }
+    return node->as.list.elements[0]->as.symbol;
+}
+
+static int is_one_of(const char *symbol, const char **names) {
+    for (int i = 0; names[i]; i++) {
+        if (strcmp(symbol, names[i]) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int is_numeric_builtin(const char *symbol) {
+    static const char *names[] = {"+", "-", "*", "/", "<", ">", "=", "<=", ">=", NULL};
+    return is_one_of(symbol, names);
+}
+
+static int is_pure_builtin(const char *symbol) {
+    static const char *names[] = {"str-length", "str-char-at", "first", "list-count", NULL};
+    return is_numeric_builtin(symbol) || is_one_of(symbol, names);
+}
+
+// Builtins whose codegen evaluates every argument once, left to right
+static int is_ordered_builtin(const char *symbol) {
+    static const char *names[] = {
+        "str-concat", "substring", "cons", "rest", "append", "list", "vector",
+        "print-list", NULL
+    };
+    return is_pure_builtin(symbol) || is_one_of(symbol, names);
+}
+
+static FunctionInfo *user_function(Cse *cse, const char *symbol, int arg_count) {
+    if (is_builtin(symbol)) {
+        return NULL;
+    }
+    FunctionInfo *func = lookup_function(cse->symbols, symbol);
+    return func && func->arity == arg_count ? func : NULL;
+}
+
+static const char *resolve(Scope *scope, const char *name) {
+    for (; scope; scope = scope->parent) {
+        // Codegen takes the first binding of a repeated name
+        for (int i = 0; i < scope->count; i++) {
+            if (strcmp(scope->names[i], name) == 0) {
+                return scope->ids[i];
+            }
+        }
+    }
+    return NULL;
+}
+
+static char *format_key(const char *fmt, const char *a, const char *b) {
+    size_t size = strlen(fmt) + strlen(a) + strlen(b) + 1;
+    char *key = malloc(size);
+    snprintf(key, size, fmt, a, b);
+    return key;
+}
+
+static int subtree_size(ASTNode *node) {
+    int size = 1;
+    if (node->type == AST_LIST || node->type == AST_MAP) {
+        for (int i = 0; i < node->as.list.count; i++) {
+            size += subtree_size(node->as.list.elements[i]);
+        }
+    }
+    return size;
+}
+
+static void record(Cse *cse, ASTNode *node, char *key, int order) {
+    if (cse->count >= cse->capacity) {
+        cse->capacity = cse->capacity ? cse->capacity * 2 : 16;
+        cse->occurrences = realloc(cse->occurrences, cse->capacity * sizeof(Occurrence));
+    }
+    Occurrence *occ = &cse->occurrences[cse->count++];
+    occ->node = node;
+    occ->key = strdup(key);
+    occ->size = subtree_size(node);
+    occ->order = order;
+    occ->path_len = cse->path_len;
+    occ->path = malloc((cse->path_len + 1) * sizeof(PathStep));
+    memcpy(occ->path, cse->path, cse->path_len * sizeof(PathStep));
+}
+
+static char *visit(Cse *cse, ASTNode *node, Scope *scope);
+
+static char *visit_child(Cse *cse, ASTNode *parent, int child, Scope *scope) {
+    if (cse->path_len == (int)(sizeof(cse->path) / sizeof(cse->path[0]))) {
+        return NULL;  // Too deep to track, left alone
+    }
+    cse->path[cse->path_len].node = parent;
+    cse->path[cse->path_len].child = child;
+    cse->path_len++;
+    char *key = visit(cse, parent->as.list.elements[child], scope);
+    cse->path_len--;
+    return key;
+}
+
+static void visit_let(Cse *cse, ASTNode *node, Scope *scope) {
+    if (node->as.list.count != 3 || node->as.list.elements[1]->type != AST_LIST) {
+        return;
+    }
+    if (cse->path_len + 2 > (int)(sizeof(cse->path) / sizeof(cse->path[0]))) {
+        return;
+    }
+    ASTNode *bindings = node->as.list.elements[1];
+    int count = bindings->as.list.count / 2;
+
+    // Values see the outer scope only
+    cse->path[cse->path_len].node = node;
+    cse->path[cse->path_len].child = 1;
+    cse->path_len++;
+    for (int i = 1; i < bindings->as.list.count; i += 2) {
+        free(visit_child(cse, bindings, i, scope));
+    }
+    cse->path_len--;
+
+    Scope inner = {malloc((count + 1) * sizeof(char *)), malloc((count + 1) * sizeof(char *)),
+                   0, scope};
+    for (int i = 0; i < count; i++) {
+        ASTNode *name = bindings->as.list.elements[i * 2];
+        if (name->type != AST_SYMBOL) {
+            continue;
+        }
+        char id[32];
+        snprintf(id, sizeof(id), "%%b%d", cse->next_binding++);
+        inner.names[inner.count] = name->as.symbol;
+        inner.ids[inner.count] = strdup(id);
+        inner.count++;
+    }
+    free(visit_child(cse, node, 2, &inner));
+    for (int i = 0; i < inner.count; i++) {
+        free(inner.ids[i]);
+    }
+    free(inner.names);
+    free(inner.ids);
+}
+
+// Returns the value key of a pure expression, NULL otherwise
+static char *visit(Cse *cse, ASTNode *node, Scope *scope) {
+    int order = cse->order++;
+    node->cse_slot = -1;
+    node->cse_reuse = 0;
+
+    switch (node->type) {
+        case AST_NUMBER: {
+            char buf[64];
+            snprintf(buf, sizeof(buf), "%.17g", node->as.number);
+            return strdup(buf);
+        }
+        case AST_SYMBOL: {
+            const char *id = resolve(scope, node->as.symbol);
+            return id ? strdup(id) : format_key("%%g:%s%s", node->as.symbol, "");
+        }
+        case AST_STRING:
+            return format_key("\"%s\"%s", node->as.string, "");
+        case AST_KEYWORD:
+            return format_key(":%s%s", node->as.keyword, "");
+        case AST_MAP:
+            return NULL;
+        case AST_LIST:
+            break;
+    }
+
+    const char *symbol = head_symbol(node);
+    if (!symbol || strcmp(symbol, "quote") == 0) {
+        return NULL;
+    }
+    int arg_count = node->as.list.count - 1;
+
+    if (strcmp(symbol, "if") == 0) {
+        for (int i = 1; i <= arg_count; i++) {
+            free(visit_child(cse, node, i, scope));
+        }
+        return NULL;
+    }
+    if (strcmp(symbol, "let") == 0) {
+        visit_let(cse, node, scope);
+        return NULL;
+    }
+
+    FunctionInfo *func = user_function(cse, symbol, arg_count);
+    if (!func && !is_ordered_builtin(symbol)) {
+        return NULL;
+    }
+
+    int pure = func ? func->pure : is_pure_builtin(symbol);
+    int nested = 0;
+    char *key = format_key("(%s%s", symbol, "");
+    for (int i = 1; i <= arg_count; i++) {
+        char *arg = visit_child(cse, node, i, scope);
+        if (!arg) {
+            pure = 0;
+        }
+        if (pure) {
+            char *longer = format_key("%s %s", key, arg);
+            free(key);
+            key = longer;
+        }
+        free(arg);
+        nested |= node->as.list.elements[i]->type == AST_LIST;
+    }
+    if (!pure) {
+        free(key);
+        return NULL;
+    }
+
+    char *closed = format_key("%s)%s", key, "");
+    free(key);
+    // Arithmetic on locals is cheaper to redo than to keep in a slot
+    if (!is_numeric_builtin(symbol) || nested) {
+        record(cse, node, closed, order);
+    }
+    return closed;
+}
+
+static int is_if(ASTNode *node) {
+    const char *symbol = head_symbol(node);
+    return symbol && strcmp(symbol, "if") == 0;
+}
+
+// Has `a` always been evaluated by the time `b` is?
+static int dominates(Occurrence *a, Occurrence *b) {
+    int k = 0;
+    while (k < a->path_len && k < b->path_len && a->path[k].node == b->path[k].node &&
+           a->path[k].child == b->path[k].child) {
+        k++;
+    }
+    if (k == a->path_len || k == b->path_len) {
+        return 0;  // One contains the other
+    }
+
+    ASTNode *split = a->path[k].node;
+    int from = a->path[k].child;
+    int to = b->path[k].child;
+    if (is_if(split)) {
+        if (from != 1) {
+            return 0;
+        }
+    } else if (from >= to) {
+        return 0;
+    }
+
+    for (int i = k + 1; i < a->path_len; i++) {
+        if (is_if(a->path[i].node) && a->path[i].child >= 2) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int in_reused(Occurrence *occ) {
+    if (occ->node->cse_reuse) {
+        return 1;
+    }
+    for (int i = 0; i < occ->path_len; i++) {
+        if (occ->path[i].node->cse_reuse) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int by_size_then_order(const void *pa, const void *pb) {
+    const Occurrence *a = pa;
+    const Occurrence *b = pb;
+    if (a->size != b->size) {
+        return b->size - a->size;
+    }
+    int key_order = strcmp(a->key, b->key);
+    return key_order ? key_order : a->order - b->order;
+}
+
+int cse_analyze(ASTNode *body, char **params, int param_count, SymbolTable *symbols) {
+    Cse cse;
+    cse.symbols = symbols;
+    cse.path_len = 0;
+    cse.occurrences = NULL;
+    cse.count = 0;
+    cse.capacity = 0;
+    cse.order = 0;
+    cse.next_binding = 0;
+
+    Scope scope = {params, malloc((param_count + 1) * sizeof(char *)), param_count, NULL};
+    for (int i = 0; i < param_count; i++) {
+        char id[32];
+        snprintf(id, sizeof(id), "%%a%d", i);
+        scope.ids[i] = strdup(id);
+    }
+    free(visit(&cse, body, &scope));
+
+    // Groups of equal keys, largest first, each in evaluation order
+    if (cse.count > 0) {
+        qsort(cse.occurrences, cse.count, sizeof(Occurrence), by_size_then_order);
+    }
+    int slots = 0;
+    for (int start = 0; start < cse.count;) {
+        int end = start + 1;
+        while (end < cse.count && strcmp(cse.occurrences[end].key, cse.occurrences[start].key) == 0) {
+            end++;
+        }
+        for (int j = start + 1; j < end; j++) {
+            Occurrence *later = &cse.occurrences[j];
+            if (in_reused(later)) {
+                continue;
+            }
+            for (int i = start; i < j; i++) {
+                Occurrence *earlier = &cse.occurrences[i];
+                if (in_reused(earlier) || !dominates(earlier, later)) {
+                    continue;
+                }
+                if (earlier->node->cse_slot < 0) {
+                    if (slots == MAX_CSE_SLOTS) {
+                        break;
+                    }
+                    earlier->node->cse_slot = slots++;
+                }
+                later->node->cse_reuse = 1;
+                later->node->cse_slot = earlier->node->cse_slot;
+                break;
+            }
+        }
+        start = end;
+    }
+
+    for (int i = 0; i < cse.count; i++) {
+        free(cse.occurrences[i].key);
+        free(cse.occurrences[i].path);
+    }
+    free(cse.occurrences);
+    for (int i = 0; i < param_count; i++) {
+        free(scope.ids[i]);
+    }
+    free(scope.ids);
+    return slots;
+}
@@ -0,0 +1,194 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "escape.h"
+
+// Escape analysis for collection literals.
+//
+// A literal may use the call's scratch region when its value is only ever
+// read by builtins that never keep a reference to their argument: either
+// it is such a builtin's argument directly, or it is bound by `let` and
+// every use of the name is. Anything else -- returning it, storing it in
+// another collection, passing it to a user function or capturing it in a
+// future or go body -- counts as an escape. Aliasing (let [u t] ...) is an
+// escape too, so a name is the only handle a literal can have.
+
+#define MAX_BINDINGS 256
+// Element offsets must fit a scaled `str` immediate
+#define MAX_SCRATCH_ELEMENTS 4096
+
+typedef enum {
+    USE_ESCAPES,   // The value may outlive the expression
+    USE_CONSUMED   // Only read by a non-retaining builtin
+} Use;
+
+typedef struct Binding {
+    const char *name;
+    ASTNode *literal;  // NULL for bindings that are not candidates
+    int escaped;
+} Binding;
+
+typedef struct EscapeState {
+    Binding bindings[MAX_BINDINGS];
+    int binding_count;
+    int lifted_depth;  // Inside a future or go body, which outlives the call
+    int marked;
+} EscapeState;
+
+// Builtins whose result never aliases a collection argument
+static int is_consumer(const char *symbol) {
+    static const char *consumers[] = {
+        "first", "rest", "list-count", "count", "print-list", "=",
+        "list-sum", "list-product", "list-dot", "list-min", "list-max",
+        "list-scale", "list-add", "list-sub", "list-mul", NULL
+    };
+    for (int i = 0; consumers[i]; i++) {
+        if (strcmp(symbol, consumers[i]) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int is_call_to(ASTNode *node, const char *symbol) {
+    return node->type == AST_LIST && node->as.list.count > 0 &&
+           node->as.list.elements[0]->type == AST_SYMBOL &&
+           strcmp(node->as.list.elements[0]->as.symbol, symbol) == 0;
+}
+
+static int is_collection_literal(ASTNode *node) {
+    return (is_call_to(node, "list") || is_call_to(node, "vector")) &&
+           node->as.list.count <= MAX_SCRATCH_ELEMENTS;
+}
+
+static void visit(EscapeState *state, ASTNode *node, Use use);
+
+static void visit_symbol(EscapeState *state, const char *symbol, Use use) {
+    if (use == USE_CONSUMED && state->lifted_depth == 0) {
+        return;
+    }
+    for (int i = state->binding_count - 1; i >= 0; i--) {
+        if (strcmp(state->bindings[i].name, symbol) == 0) {
+            state->bindings[i].escaped = 1;
+            return;
+        }
+    }
+}
+
+static void visit_let(EscapeState *state, ASTNode **args, int arg_count, Use use) {
+    if (arg_count != 2 || args[0]->type != AST_LIST) {
+        return;  // Reported by codegen
+    }
+
+    ASTNode *bindings = args[0];
+    int base = state->binding_count;
+    for (int i = 0; i + 1 < bindings->as.list.count; i += 2) {
+        ASTNode *name = bindings->as.list.elements[i];
+        ASTNode *init = bindings->as.list.elements[i + 1];
+
+        int candidate = is_collection_literal(init) && state->lifted_depth == 0;
+        if (candidate) {
+            // The elements are stored in the collection
+            for (int j = 1; j < init->as.list.count; j++) {
+                visit(state, init->as.list.elements[j], USE_ESCAPES);
+            }
+        } else {
+            visit(state, init, USE_ESCAPES);
+        }
+
+        if (name->type != AST_SYMBOL || state->binding_count == MAX_BINDINGS) {
+            continue;
+        }
+        // Pushed even for non-candidates so they shadow outer names
+        Binding *binding = &state->bindings[state->binding_count++];
+        binding->name = name->as.symbol;
+        binding->literal = candidate ? init : NULL;
+        binding->escaped = 0;
+    }
+
+    visit(state, args[1], use);
+
+    for (int i = base; i < state->binding_count; i++) {
+        Binding *binding = &state->bindings[i];
+        if (binding->literal && !binding->escaped) {
+            binding->literal->scratch = 1;
+            state->marked++;
+        }
+    }
+    state->binding_count = base;
+}
+
+static void visit(EscapeState *state, ASTNode *node, Use use) {
+    if (node->type == AST_SYMBOL) {
+        visit_symbol(state, node->as.symbol, use);
+        return;
+    }
+    if (node->type == AST_MAP) {
+        for (int i = 0; i < node->as.list.count; i++) {
+            visit(state, node->as.list.elements[i], USE_ESCAPES);
+        }
+        return;
+    }
+    if (node->type != AST_LIST || node->as.list.count == 0) {
+        return;
+    }
+
+    ASTNode *head = node->as.list.elements[0];
+    ASTNode **args = &node->as.list.elements[1];
+    int arg_count = node->as.list.count - 1;
+    const char *symbol = head->type == AST_SYMBOL ? head->as.symbol : "";
+
+    if (strcmp(symbol, "quote") == 0) {
+        return;
+    }
+
+    if (strcmp(symbol, "let") == 0) {
+        visit_let(state, args, arg_count, use);
+        return;
+    }
+
+    if (strcmp(symbol, "if") == 0) {
+        for (int i = 0; i < arg_count; i++) {
+            // The test is only checked for truth
+            visit(state, args[i], i == 0 ? USE_CONSUMED : use);
+        }
+        return;
+    }
+
+    if (strcmp(symbol, "future") == 0 || strcmp(symbol, "go") == 0) {
+        // Lifted into its own function, analyzed when that is generated
+        state->lifted_depth++;
+        for (int i = 0; i < arg_count; i++) {
+            visit(state, args[i], USE_ESCAPES);
+        }
+        state->lifted_depth--;
+        return;
+    }
+
+    if (is_collection_literal(node)) {
+        for (int i = 0; i < arg_count; i++) {
+            visit(state, args[i], USE_ESCAPES);
+        }
+        if (use == USE_CONSUMED && state->lifted_depth == 0) {
+            node->scratch = 1;
+            state->marked++;
+        }
+        return;
+    }
+
+    Use arg_use = is_consumer(symbol) ? USE_CONSUMED : USE_ESCAPES;
+    for (int i = 0; i < arg_count; i++) {
+        visit(state, args[i], arg_use);
+    }
+}
+
+int escape_analyze(ASTNode *body) {
+    EscapeState state;
+    state.binding_count = 0;
+    state.lifted_depth = 0;
+    state.marked = 0;
+
+    // The body's value is returned
+    visit(&state, body, USE_ESCAPES);
+    return state.marked;
+}
@@ -0,0 +1,246 @@
+#include <stdlib.h>
+#include <string.h>
+#include "inline.h"
+#include "codegen.h"
+
+// Profile-guided inlining.
+//
+// Runs after partial evaluation and before reachability, so a function
+// inlined at every call site is not emitted at all. Inlining substitutes
+// the arguments into a copy of the body instead of binding them with a
+// let, because codegen places let bindings as if the operand stack were
+// empty, which is not so in an argument position. That is only sound
+// when:
+//
+// - the body binds nothing (no let, future or go) that could shadow an
+//   argument's names, and does not call a parameter;
+// - every argument is a literal or local, or pure arithmetic on those
+//   that the body uses at most once, so nothing is evaluated twice or
+//   out of order;
+// - the body names no function as a value, which a local of the caller
+//   could shadow. Defs need no check, since they win over locals.
+//
+// The callee must not be the caller or a defn-memo, whose cache would be
+// bypassed. Only one level is inlined: a copied body is not searched
+// again.
+
+#define INLINE_MAX_NODES 32     // Body size, in AST nodes
+#define INLINE_HOT_FRACTION 20  // Hot: at least 1/20 of the hottest function's calls
+
+typedef struct Inliner {
+    SymbolTable *symbols;
+    const Profile *profile;
+    FunctionInfo *caller;  // NULL for top-level forms
+    int inlined;
+} Inliner;
+
+static const char *head_symbol(ASTNode *node) {
+    if (node->type != AST_LIST || node->as.list.count == 0 ||
+        node->as.list.elements[0]->type != AST_SYMBOL) {
+        return NULL;
+    }
+    return node->as.list.elements[0]->as.symbol;
+}
+
+static int is_binding_form(const char *symbol) {
+    static const char *forms[] = {
+        "let", "future", "go", "quote", "def", "defn", "defn-memo", NULL
+    };
+    for (int i = 0; forms[i]; i++) {
+        if (strcmp(symbol, forms[i]) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int param_index(FunctionInfo *func, const char *symbol) {
+    for (int i = 0; i < func->arity; i++) {
+        if (strcmp(func->param_names[i], symbol) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int count_nodes(ASTNode *node) {
+    int count = 1;
+    if (node->type == AST_LIST || node->type == AST_MAP) {
+        for (int i = 0; i < node->as.list.count; i++) {
+            count += count_nodes(node->as.list.elements[i]);
+        }
+    }
+    return count;
+}
+
+// Uses of `param` as a value, not as the head of a call
+static int count_uses(ASTNode *node, const char *param, int is_head) {
+    if (node->type == AST_SYMBOL) {
+        return !is_head && strcmp(node->as.symbol, param) == 0;
+    }
+    int uses = 0;
+    if (node->type == AST_LIST || node->type == AST_MAP) {
+        for (int i = 0; i < node->as.list.count; i++) {
+            uses += count_uses(node->as.list.elements[i], param,
+                               node->type == AST_LIST && i == 0);
+        }
+    }
+    return uses;
+}
+
+static int is_pure_arg(ASTNode *node) {
+    if (node->type != AST_LIST && node->type != AST_MAP) {
+        return 1;
+    }
+    const char *head = head_symbol(node);
+    if (!head || !(strcmp(head, "+") == 0 || strcmp(head, "-") == 0 ||
+                   strcmp(head, "*") == 0 || strcmp(head, "/") == 0 ||
+                   strcmp(head, "<") == 0 || strcmp(head, ">") == 0 ||
+                   strcmp(head, "=") == 0 || strcmp(head, "<=") == 0 ||
+                   strcmp(head, ">=") == 0)) {
+        return 0;
+    }
+    for (int i = 1; i < node->as.list.count; i++) {
+        if (!is_pure_arg(node->as.list.elements[i])) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int is_substitutable(Inliner *in, FunctionInfo *callee, ASTNode *node, int is_head) {
+    if (node->type == AST_SYMBOL) {
+        if (is_head) {
+            return param_index(callee, node->as.symbol) < 0;
+        }
+        return param_index(callee, node->as.symbol) >= 0 ||
+               !lookup_function(in->symbols, node->as.symbol);
+    }
+    if (node->type != AST_LIST && node->type != AST_MAP) {
+        return 1;
+    }
+    const char *head = head_symbol(node);
+    if (head && is_binding_form(head)) {
+        return 0;
+    }
+    for (int i = 0; i < node->as.list.count; i++) {
+        if (!is_substitutable(in, callee, node->as.list.elements[i],
+                              node->type == AST_LIST && i == 0)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static FunctionInfo *hot_callee(Inliner *in, ASTNode *call) {
+    const char *name = head_symbol(call);
+    if (!name || is_builtin(name)) {
+        return NULL;
+    }
+    FunctionInfo *callee = lookup_function(in->symbols, name);
+    int arg_count = call->as.list.count - 1;
+    if (!callee || callee == in->caller || callee->memo || callee->arity != arg_count) {
+        return NULL;
+    }
+
+    long calls = profile_calls(in->profile, name);
+    if (calls == 0 || calls * INLINE_HOT_FRACTION < in->profile->max_calls ||
+        count_nodes(callee->body) > INLINE_MAX_NODES ||
+        !is_substitutable(in, callee, callee->body, 0)) {
+        return NULL;
+    }
+
+    for (int i = 0; i < arg_count; i++) {
+        ASTNode *arg = call->as.list.elements[i + 1];
+        if ((arg->type == AST_LIST || arg->type == AST_MAP) &&
+            (!is_pure_arg(arg) || count_uses(callee->body, callee->param_names[i], 0) > 1)) {
+            return NULL;
+        }
+    }
+    return callee;
+}
+
+static ASTNode *substitute(FunctionInfo *callee, ASTNode *node, ASTNode **args, int is_head) {
+    if (node->type == AST_SYMBOL && !is_head) {
+        int index = param_index(callee, node->as.symbol);
+        if (index >= 0) {
+            return copy_ast(args[index]);
+        }
+    }
+    if (node->type != AST_LIST && node->type != AST_MAP) {
+        return copy_ast(node);
+    }
+
+    ASTNode *copy = node->type == AST_LIST ? create_list_node() : create_map_node();
+    copy->line = node->line;
+    copy->column = node->column;
+    for (int i = 0; i < node->as.list.count; i++) {
+        add_to_list(copy, substitute(callee, node->as.list.elements[i], args,
+                                     node->type == AST_LIST && i == 0));
+    }
+    return copy;
+}
+
+// Turns the call node into the expansion in place, so parents and
+// def initializers pointing at it see the new code
+static void inline_call(FunctionInfo *callee, ASTNode *call) {
+    ASTNode *expansion = substitute(callee, callee->body, &call->as.list.elements[1], 0);
+    for (int i = 0; i < call->as.list.count; i++) {
+        free_ast(call->as.list.elements[i]);
+    }
+    free(call->as.list.elements);
+    *call = *expansion;
+    free(expansion);
+}
+
+static int is_defn_form(ASTNode *node) {
+    const char *head = head_symbol(node);
+    return head && (strcmp(head, "defn") == 0 || strcmp(head, "defn-memo") == 0);
+}
+
+static void walk(Inliner *in, ASTNode *node, int hot) {
+    if (node->type != AST_LIST && node->type != AST_MAP) {
+        return;
+    }
+    // Bodies are walked through the symbol table
+    if (is_defn_form(node)) {
+        return;
+    }
+
+    const char *head = head_symbol(node);
+    if (head && strcmp(head, "if") == 0 && node->as.list.count == 4) {
+        const ProfileBranch *branch = profile_branch(in->profile, node->line, node->column);
+        walk(in, node->as.list.elements[1], hot);
+        walk(in, node->as.list.elements[2],
+             hot && !(branch && branch->then_count == 0 && branch->else_count > 0));
+        walk(in, node->as.list.elements[3],
+             hot && !(branch && branch->else_count == 0 && branch->then_count > 0));
+        return;
+    }
+
+    FunctionInfo *callee = hot ? hot_callee(in, node) : NULL;
+    if (callee) {
+        inline_call(callee, node);
+        in->inlined++;
+        return;
+    }
+
+    for (int i = 0; i < node->as.list.count; i++) {
+        walk(in, node->as.list.elements[i], hot);
+    }
+}
+
+int inline_hot_calls(SymbolTable *symbols, ASTNode *ast, const Profile *profile) {
+    Inliner in;
+    in.symbols = symbols;
+    in.profile = profile;
+    in.inlined = 0;
+
+    for (int i = 0; i < symbols->function_count; i++) {
+        in.caller = symbols->functions[i];
+        walk(&in, in.caller->body, 1);
+    }
+    in.caller = NULL;
+    walk(&in, ast, 1);
+    return in.inlined;
+}
@@ -1,42 +1,357 @@
+#define _POSIX_C_SOURCE 200809L
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include "tokenizer.h"
 #include "parser.h"
 #include "codegen.h"
+#include "time_report.h"
 
-int main(int argc, char *argv[]) {
-    const char *source_code;
+// Toolchain for --emit=obj and --emit=exe, overridable with CLJC_CC.
+// -arch is an Apple driver flag; elsewhere cc is expected to target arm64.
+#ifdef __APPLE__
+#define DEFAULT_TOOLCHAIN "cc -arch arm64"
+#else
+#define DEFAULT_TOOLCHAIN "cc"
+#endif
+#define DEFAULT_RUNTIME "build/libruntime.a"
+#define DEFAULT_PROFILE "cljc.profile"
+#define MAX_COMMAND 4096
 
-    if (argc < 2) {
-        fprintf(stderr, "Usage: %s \"<clojure code>\"\n", argv[0]);
-        fprintf(stderr, "Example: %s \"(+ 1 2 3)\"\n", argv[0]);
-        return 1;
+// Linker flag that drops unused runtime sections. The Makefile passes its
+// PROGRAM_LDFLAGS; other builds choose by host the same way.
+#ifndef PROGRAM_LDFLAGS
+#ifdef __APPLE__
+#define PROGRAM_LDFLAGS "-Wl,-dead_strip"
+#else
+#define PROGRAM_LDFLAGS "-Wl,--gc-sections"
+#endif
+#endif
+
+typedef enum {
+    EMIT_TOKENS,
+    EMIT_AST,
+    EMIT_ASM,
+    EMIT_OBJ,
+    EMIT_EXE
+} EmitKind;
+
+typedef struct Options {
+    const char *source;
+    const char *output;   // "-" is stdout
+    const char *runtime;  // Library linked by --emit=exe
+    EmitKind emit;
+    int dump_tokens;
+    int dump_ast;
+    int time_report;
+    TimeReportFormat report_format;
+    const char *profile_use;
+    CodegenOptions codegen;
+} Options;
+
+static void usage(const char *program) {
+    fprintf(stderr, "Usage: %s [options] \"<clojure code>\" | -\n", program);
+    fprintf(stderr, "Example: %s \"(+ 1 2 3)\"\n\n", program);
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  -                          Read the code from stdin\n");
+    fprintf(stderr, "  -o <path>                  Output file, - for stdout\n");
+    fprintf(stderr, "                             (default asm/output.s, asm/output.o or asm/program)\n");
+    fprintf(stderr, "  --emit=tokens|ast|asm|obj|exe\n");
+    fprintf(stderr, "                             What to produce (default asm); obj and exe pipe\n");
+    fprintf(stderr, "                             the assembly straight into $CLJC_CC (%s)\n", DEFAULT_TOOLCHAIN);
+    fprintf(stderr, "  --runtime=<path>           Runtime library for exe (default %s)\n", DEFAULT_RUNTIME);
+    fprintf(stderr, "  --stats                    Count defn calls; the program prints runtime\n");
+    fprintf(stderr, "                             stats at exit (CLJC_STATS=json for JSON)\n");
+    fprintf(stderr, "  --perf-counters            The program prints cycles, instructions, cache and\n");
+    fprintf(stderr, "                             branch misses of each top-level form at exit\n");
+    fprintf(stderr, "  --profile-generate[=<path>]\n");
+    fprintf(stderr, "                             Count function calls and if arms; the program\n");
+    fprintf(stderr, "                             writes them to <path> at exit (default %s)\n", DEFAULT_PROFILE);
+    fprintf(stderr, "  --profile-use=<path>       Lay out ifs, inline hot calls and move cold code\n");
+    fprintf(stderr, "                             out of line using a profile\n");
+    fprintf(stderr, "  -g                         Emit a DWARF line table and CFI for profilers\n");
+    fprintf(stderr, "  --source-name=<path>       File the line table names (default <stdin> or\n");
+    fprintf(stderr, "                             <command-line>)\n");
+    fprintf(stderr, "  --dump-tokens, --dump-ast  Print the tokens or AST to stderr\n");
+    fprintf(stderr, "  --time-report[=table|json] Print per-phase statistics to stderr\n");
+}
+
+static int parse_emit(const char *kind, EmitKind *emit) {
+    static const char *names[] = { "tokens", "ast", "asm", "obj", "exe" };
+    for (int i = 0; i < 5; i++) {
+        if (strcmp(kind, names[i]) == 0) {
+            *emit = (EmitKind)i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void parse_options(int argc, char *argv[], Options *opts) {
+    opts->source = NULL;
+    opts->output = NULL;
+    opts->runtime = DEFAULT_RUNTIME;
+    opts->emit = EMIT_ASM;
+    opts->dump_tokens = 0;
+    opts->dump_ast = 0;
+    opts->time_report = 0;
+    opts->report_format = TIME_REPORT_TABLE;
+    opts->codegen.stats = 0;
+    opts->codegen.perf_counters = 0;
+    opts->codegen.debug_info = 0;
+    opts->codegen.source_name = NULL;
+    opts->codegen.source_dir = ".";
+    opts->codegen.profile_generate = NULL;
+    opts->codegen.profile = NULL;
+    opts->profile_use = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        if (strcmp(arg, "-o") == 0 && i + 1 < argc) {
+            opts->output = argv[++i];
+        } else if (strncmp(arg, "--emit=", 7) == 0 && parse_emit(arg + 7, &opts->emit)) {
+            continue;
+        } else if (strncmp(arg, "--runtime=", 10) == 0) {
+            opts->runtime = arg + 10;
+        } else if (strcmp(arg, "--stats") == 0) {
+            opts->codegen.stats = 1;
+        } else if (strcmp(arg, "--perf-counters") == 0) {
+            opts->codegen.perf_counters = 1;
+        } else if (strcmp(arg, "--profile-generate") == 0) {
+            opts->codegen.profile_generate = DEFAULT_PROFILE;
+        } else if (strncmp(arg, "--profile-generate=", 19) == 0) {
+            opts->codegen.profile_generate = arg + 19;
+        } else if (strncmp(arg, "--profile-use=", 14) == 0) {
+            opts->profile_use = arg + 14;
+        } else if (strcmp(arg, "-g") == 0) {
+            opts->codegen.debug_info = 1;
+        } else if (strncmp(arg, "--source-name=", 14) == 0) {
+            opts->codegen.source_name = arg + 14;
+        } else if (strcmp(arg, "--dump-tokens") == 0) {
+            opts->dump_tokens = 1;
+        } else if (strcmp(arg, "--dump-ast") == 0) {
+            opts->dump_ast = 1;
+        } else if (strcmp(arg, "--time-report") == 0 || strcmp(arg, "--time-report=table") == 0) {
+            opts->time_report = 1;
+        } else if (strcmp(arg, "--time-report=json") == 0) {
+            opts->time_report = 1;
+            opts->report_format = TIME_REPORT_JSON;
+        } else if (arg[0] == '-' && arg[1] != '\0') {
+            fprintf(stderr, "Error: Unknown option %s\n", arg);
+            usage(argv[0]);
+            exit(1);
+        } else if (!opts->source) {
+            opts->source = arg;
+        } else {
+            usage(argv[0]);
+            exit(1);
+        }
     }
 
-    source_code = argv[1];
+    if (!opts->source) {
+        usage(argv[0]);
+        exit(1);
+    }
+    if (!opts->codegen.source_name) {
+        opts->codegen.source_name = strcmp(opts->source, "-") == 0 ? "<stdin>" : "<command-line>";
+    }
+    static char cwd[MAX_COMMAND];
+    if (getcwd(cwd, sizeof(cwd))) {
+        opts->codegen.source_dir = cwd;
+    }
+    if (!opts->output) {
+        static const char *defaults[] = { "-", "-", "asm/output.s", "asm/output.o", "asm/program" };
+        opts->output = defaults[opts->emit];
+    }
+    if ((opts->emit == EMIT_OBJ || opts->emit == EMIT_EXE) && strcmp(opts->output, "-") == 0) {
+        fprintf(stderr, "Error: --emit=obj and --emit=exe need an output file\n");
+        exit(1);
+    }
+}
 
-    printf("Mini Clojure Compiler\n");
-    printf("=====================\n\n");
-    printf("Source: %s\n\n", source_code);
+// Appends `arg` to a shell command in single quotes
+static void append_quoted(char *command, const char *arg) {
+    size_t length = strlen(command);
+    command[length++] = ' ';
+    command[length++] = '\'';
+    for (const char *p = arg; *p && length < MAX_COMMAND - 8; p++) {
+        if (*p == '\'') {
+            memcpy(command + length, "'\\''", 4);
+            length += 4;
+        } else {
+            command[length++] = *p;
+        }
+    }
+    command[length++] = '\'';
+    command[length] = '\0';
+}
 
-    TokenList *tokens = tokenize(source_code);
-    printf("Tokens:\n");
-    print_tokens(tokens);
+// The assembler or linker reading assembly on stdin
+static FILE *open_toolchain(Options *opts) {
+    const char *toolchain = getenv("CLJC_CC");
+    char command[MAX_COMMAND];
+    snprintf(command, sizeof(command), "%s -x assembler", toolchain ? toolchain : DEFAULT_TOOLCHAIN);
+    if (opts->emit == EMIT_OBJ) {
+        strcat(command, " -c");
+    }
+    if (opts->codegen.debug_info) {
+        // Keeps the line table; linking with -g also runs dsymutil on macOS
+        strcat(command, " -g");
+    }
+    strcat(command, " -o");
+    append_quoted(command, opts->output);
+    strcat(command, " -");
+    if (opts->emit == EMIT_EXE) {
+        // Unused runtime functions are dropped, see RUNTIME_CFLAGS in the Makefile
+        strcat(command, " -x none");
+        append_quoted(command, opts->runtime);
+        strcat(command, " -lm -lpthread " PROGRAM_LDFLAGS);
+    }
 
-    printf("\nAST:\n");
-    ASTNode *ast = parse(tokens);
-    if (ast) {
-        print_ast(ast, 0);
+    FILE *pipe = popen(command, "w");
+    if (!pipe) {
+        fprintf(stderr, "Error: Could not run: %s\n", command);
+        exit(1);
+    }
+    return pipe;
+}
 
-        printf("\nGenerating ARM64 assembly...\n");
-        generate_asm(ast, "asm/output.s");
-        printf("Assembly written to: asm/output.s\n");
+static FILE *open_output(Options *opts) {
+    if (opts->emit == EMIT_OBJ || opts->emit == EMIT_EXE) {
+        return open_toolchain(opts);
+    }
+    if (strcmp(opts->output, "-") == 0) {
+        return stdout;
+    }
+    FILE *f = fopen(opts->output, "w");
+    if (!f) {
+        fprintf(stderr, "Error: Could not open output file: %s\n", opts->output);
+        exit(1);
+    }
+    return f;
+}
 
-        free_ast(ast);
+static void close_output(Options *opts, FILE *f) {
+    if (opts->emit == EMIT_OBJ || opts->emit == EMIT_EXE) {
+        if (pclose(f) != 0) {
+            fprintf(stderr, "Error: %s failed\n", opts->emit == EMIT_OBJ ? "Assembling" : "Linking");
+            exit(1);
+        }
+    } else if (f == stdout) {
+        fflush(f);
     } else {
-        printf("Failed to parse!\n");
+        fclose(f);
+    }
+}
+
+// Source too large for a command-line argument comes on stdin
+static char *read_stdin(void) {
+    size_t capacity = 4096;
+    size_t length = 0;
+    char *text = malloc(capacity);
+    size_t n;
+    while ((n = fread(text + length, 1, capacity - length - 1, stdin)) > 0) {
+        length += n;
+        if (capacity - length - 1 == 0) {
+            capacity *= 2;
+            text = realloc(text, capacity);
+        }
+    }
+    text[length] = '\0';
+    return text;
+}
+
+static long count_ast_nodes(ASTNode *node) {
+    long count = 1;
+    if (node->type == AST_LIST || node->type == AST_MAP) {
+        for (int i = 0; i < node->as.list.count; i++) {
+            count += count_ast_nodes(node->as.list.elements[i]);
+        }
+    }
+    return count;
+}
+
+// Generates straight into the output. For --time-report the assembly goes
+// through a buffer first so its instructions can be counted.
+static void emit_assembly(Options *opts, ASTNode *ast, FILE *out) {
+    if (!opts->time_report) {
+        generate_asm(ast, out, &opts->codegen);
+        return;
+    }
+
+    char *text = NULL;
+    size_t length = 0;
+    FILE *buffer = open_memstream(&text, &length);
+    generate_asm(ast, buffer, &opts->codegen);
+    fclose(buffer);
+    time_report_count("instructions", count_instructions(text));
+
+    phase_begin("write_output");
+    fwrite(text, 1, length, out);
+    phase_end();
+    free(text);
+}
+
+int main(int argc, char *argv[]) {
+    Options opts;
+    parse_options(argc, argv, &opts);
+    if (opts.time_report) {
+        time_report_enable();
+    }
+    if (strcmp(opts.source, "-") == 0) {
+        opts.source = read_stdin();
+    }
+    Profile *profile = NULL;
+    if (opts.profile_use) {
+        profile = load_profile(opts.profile_use);
+        opts.codegen.profile = profile;
+    }
+
+    phase_begin("tokenize");
+    TokenList *tokens = tokenize(opts.source);
+    phase_end();
+    time_report_count("tokens", tokens->count);
+    if (opts.dump_tokens) {
+        print_tokens(stderr, tokens);
+    }
+
+    FILE *out = open_output(&opts);
+    if (opts.emit == EMIT_TOKENS) {
+        print_tokens(out, tokens);
+        close_output(&opts, out);
+        free_tokens(tokens);
+        time_report_print(stderr, opts.report_format);
+        return 0;
+    }
+
+    phase_begin("parse");
+    ASTNode *ast = parse(tokens);
+    phase_end();
+    if (!ast) {
+        fprintf(stderr, "Error: Failed to parse\n");
         return 1;
     }
+    time_report_count("ast_nodes", count_ast_nodes(ast));
+    if (opts.dump_ast) {
+        print_ast(stderr, ast, 0);
+    }
 
+    if (opts.emit == EMIT_AST) {
+        print_ast(out, ast, 0);
+    } else {
+        emit_assembly(&opts, ast, out);
+    }
+
+    phase_begin(opts.emit == EMIT_OBJ || opts.emit == EMIT_EXE ? "assemble" : "write_output");
+    close_output(&opts, out);
+    phase_end();
+
+    free_ast(ast);
     free_tokens(tokens);
+    if (profile) {
+        free_profile(profile);
+    }
+    time_report_print(stderr, opts.report_format);
     return 0;
 }
@@ -24,6 +24,13 @@ static int match(Parser *p, TokenType type) {
 
 static ASTNode *parse_expression(Parser *p);
 
+// Records where `node` starts, for -g line tables
+static ASTNode *located(ASTNode *node, Token *token) {
+    node->line = token->line;
+    node->column = token->column;
+    return node;
+}
+
 static ASTNode *parse_list(Parser *p) {
     Token *lparen = advance(p);
     if (!lparen || lparen->type != TOKEN_LEFT_PAREN) {
@@ -32,7 +39,7 @@ static ASTNode *parse_list(Parser *p) {
         return NULL;
     }
 
-    ASTNode *list = create_list_node();
+    ASTNode *list = located(create_list_node(), lparen);
 
     while (!match(p, TOKEN_RIGHT_PAREN) && !match(p, TOKEN_EOF)) {
         ASTNode *element = parse_expression(p);
@@ -62,7 +69,7 @@ static ASTNode *parse_vector(Parser *p) {
         return NULL;
     }
 
-    ASTNode *list = create_list_node();
+    ASTNode *list = located(create_list_node(), lbracket);
 
     while (!match(p, TOKEN_RIGHT_BRACKET) && !match(p, TOKEN_EOF)) {
         ASTNode *element = parse_expression(p);
@@ -84,6 +91,43 @@ static ASTNode *parse_vector(Parser *p) {
     return list;
 }
 
+static ASTNode *parse_map(Parser *p) {
+    Token *lbrace = advance(p);
+    if (!lbrace || lbrace->type != TOKEN_LEFT_BRACE) {
+        fprintf(stderr, "Error: Expected '{' at line %d, column %d\n",
+                lbrace ? lbrace->line : 0, lbrace ? lbrace->column : 0);
+        return NULL;
+    }
+
+    ASTNode *map = located(create_map_node(), lbrace);
+
+    while (!match(p, TOKEN_RIGHT_BRACE) && !match(p, TOKEN_EOF)) {
+        ASTNode *element = parse_expression(p);
+        if (!element) {
+            free_ast(map);
+            return NULL;
+        }
+        add_to_list(map, element);
+    }
+
+    Token *rbrace = advance(p);
+    if (!rbrace || rbrace->type != TOKEN_RIGHT_BRACE) {
+        fprintf(stderr, "Error: Expected '}' at line %d, column %d\n",
+                rbrace ? rbrace->line : 0, rbrace ? rbrace->column : 0);
+        free_ast(map);
+        return NULL;
+    }
+
+    if (map->as.list.count % 2 != 0) {
+        fprintf(stderr, "Error: Map literal must contain an even number of forms at line %d, column %d\n",
+                lbrace->line, lbrace->column);
+        free_ast(map);
+        return NULL;
+    }
+
+    return map;
+}
+
 static ASTNode *parse_expression(Parser *p) {
     Token *token = peek(p);
 
@@ -99,20 +143,28 @@ static ASTNode *parse_expression(Parser *p) {
         case TOKEN_LEFT_BRACKET:
             return parse_vector(p);
 
+        case TOKEN_LEFT_BRACE:
+            return parse_map(p);
+
         case TOKEN_NUMBER: {
             advance(p);
             double value = atof(token->value);
-            return create_number_node(value);
+            return located(create_number_node(value), token);
         }
 
         case TOKEN_SYMBOL: {
             advance(p);
-            return create_symbol_node(token->value);
+            return located(create_symbol_node(token->value), token);
         }
 
         case TOKEN_STRING: {
             advance(p);
-            return create_string_node(token->value);
+            return located(create_string_node(token->value), token);
+        }
+
+        case TOKEN_KEYWORD: {
+            advance(p);
+            return located(create_keyword_node(token->value), token);
         }
 
         case TOKEN_EOF:
@@ -136,6 +188,8 @@ ASTNode *parse(TokenList *tokens) {
     parser.current = 0;
 
     ASTNode *root = create_list_node();
+    root->line = 1;
+    root->column = 1;
 
     while (!match(&parser, TOKEN_EOF)) {
         ASTNode *expr = parse_expression(&parser);
@@ -0,0 +1,455 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "partial_eval.h"
+#include "codegen.h"
+
+// Compile-time evaluation of pure calls.
+//
+// A function is pure when its body only does arithmetic and comparisons
+// on numbers, binds with let, branches with if and calls pure functions;
+// recursion is fine. Such a call with number literals as arguments is run
+// by a small evaluator here and replaced by its result, so (factorial 5)
+// compiles to the constant 120.
+//
+// The evaluator computes what the generated code computes: let bindings
+// are evaluated before any of them is visible, `-` with one argument
+// returns it unchanged, operators with more than two arguments combine
+// right to left, and a def shadows a local of the same name. It gives up,
+// leaving the call for runtime, on anything it cannot decide: a step or
+// depth budget running out (so compilation always terminates), a result
+// that is not finite, or a name it cannot resolve.
+//
+// Failed calls are remembered with their arguments, so the same call at
+// another site is not run again, and a function that exhausts the step
+// budget MAX_BUDGET_FAILURES times is not tried any more: otherwise a
+// long-running function called from many sites would cost the budget at
+// every one of them.
+
+#define MAX_EVAL_STEPS 1000000  // Nodes evaluated for one folded call
+#define MAX_EVAL_DEPTH 256      // Nested user function calls
+#define MAX_EVAL_ARGS 8         // Arguments passed in d0-d7
+#define MAX_BUDGET_FAILURES 4   // Calls out of steps before a function is given up
+
+typedef struct Env {
+    char **names;
+    double *values;
+    int count;
+    struct Env *parent;
+} Env;
+
+typedef struct FailedCall {
+    FunctionInfo *func;
+    double args[MAX_EVAL_ARGS];
+    int out_of_steps;
+} FailedCall;
+
+typedef struct PartialEval {
+    SymbolTable *symbols;
+    char **globals;  // def names
+    int global_count;
+    long steps;
+    int depth;
+    FailedCall *failed;
+    int failed_count;
+    int failed_capacity;
+} PartialEval;
+
+static const char *head_symbol(ASTNode *node) {
+    if (node->type != AST_LIST || node->as.list.count == 0 ||
+        node->as.list.elements[0]->type != AST_SYMBOL) {
+        return NULL;
+    }
+    return node->as.list.elements[0]->as.symbol;
+}
+
+static int is_arithmetic(const char *symbol) {
+    return strcmp(symbol, "+") == 0 || strcmp(symbol, "-") == 0 ||
+           strcmp(symbol, "*") == 0 || strcmp(symbol, "/") == 0;
+}
+
+static int is_comparison(const char *symbol) {
+    return strcmp(symbol, "<") == 0 || strcmp(symbol, ">") == 0 ||
+           strcmp(symbol, "=") == 0 || strcmp(symbol, "<=") == 0 ||
+           strcmp(symbol, ">=") == 0;
+}
+
+static int is_global(PartialEval *pe, const char *name) {
+    for (int i = 0; i < pe->global_count; i++) {
+        if (strcmp(pe->globals[i], name) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// A call to a user function, as opposed to a builtin of the same name
+static FunctionInfo *user_function(PartialEval *pe, const char *symbol, int arg_count) {
+    if (is_builtin(symbol)) {
+        return NULL;
+    }
+    FunctionInfo *func = lookup_function(pe->symbols, symbol);
+    if (!func || func->arity != arg_count || arg_count > MAX_EVAL_ARGS) {
+        return NULL;
+    }
+    return func;
+}
+
+static int is_pure_expr(PartialEval *pe, ASTNode *node) {
+    if (node->type == AST_NUMBER) {
+        return 1;
+    }
+    if (node->type == AST_SYMBOL) {
+        return !is_global(pe, node->as.symbol);
+    }
+
+    const char *symbol = head_symbol(node);
+    if (!symbol) {
+        return 0;
+    }
+    ASTNode **args = &node->as.list.elements[1];
+    int arg_count = node->as.list.count - 1;
+
+    if (strcmp(symbol, "let") == 0) {
+        if (arg_count != 2 || args[0]->type != AST_LIST || args[0]->as.list.count % 2 != 0) {
+            return 0;
+        }
+        ASTNode *bindings = args[0];
+        for (int i = 0; i < bindings->as.list.count; i += 2) {
+            if (bindings->as.list.elements[i]->type != AST_SYMBOL ||
+                !is_pure_expr(pe, bindings->as.list.elements[i + 1])) {
+                return 0;
+            }
+        }
+        return is_pure_expr(pe, args[1]);
+    }
+
+    if (strcmp(symbol, "if") == 0) {
+        if (arg_count != 3) {
+            return 0;
+        }
+    } else if (is_arithmetic(symbol)) {
+        if (arg_count == 0) {
+            return 0;
+        }
+    } else if (is_comparison(symbol)) {
+        if (arg_count != 2) {
+            return 0;
+        }
+    } else {
+        FunctionInfo *func = user_function(pe, symbol, arg_count);
+        if (!func || !func->pure) {
+            return 0;
+        }
+    }
+
+    for (int i = 0; i < arg_count; i++) {
+        if (!is_pure_expr(pe, args[i])) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Greatest fixed point: every function starts pure, and those calling an
+// impure function are demoted until nothing changes
+static void analyze_purity(PartialEval *pe) {
+    for (int i = 0; i < pe->symbols->function_count; i++) {
+        pe->symbols->functions[i]->pure = 1;
+    }
+    int changed = 1;
+    while (changed) {
+        changed = 0;
+        for (int i = 0; i < pe->symbols->function_count; i++) {
+            FunctionInfo *func = pe->symbols->functions[i];
+            if (func->pure && !is_pure_expr(pe, func->body)) {
+                func->pure = 0;
+                changed = 1;
+            }
+        }
+    }
+}
+
+static int lookup(Env *env, const char *name, double *out) {
+    for (; env; env = env->parent) {
+        for (int i = 0; i < env->count; i++) {
+            if (strcmp(env->names[i], name) == 0) {
+                *out = env->values[i];
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+static int eval(PartialEval *pe, ASTNode *node, Env *env, double *out);
+
+static int eval_let(PartialEval *pe, ASTNode **args, Env *env, double *out) {
+    ASTNode *bindings = args[0];
+    int count = bindings->as.list.count / 2;
+    Env frame = {malloc((count + 1) * sizeof(char *)), malloc((count + 1) * sizeof(double)),
+                 count, env};
+    int ok = 1;
+    for (int i = 0; i < count && ok; i++) {
+        frame.names[i] = bindings->as.list.elements[i * 2]->as.symbol;
+        ok = eval(pe, bindings->as.list.elements[i * 2 + 1], env, &frame.values[i]);
+    }
+    ok = ok && eval(pe, args[1], &frame, out);
+    free(frame.names);
+    free(frame.values);
+    return ok;
+}
+
+static int eval_call(PartialEval *pe, FunctionInfo *func, ASTNode **args, Env *env, double *out) {
+    double values[MAX_EVAL_ARGS];
+    for (int i = 0; i < func->arity; i++) {
+        if (!eval(pe, args[i], env, &values[i])) {
+            return 0;
+        }
+    }
+    if (pe->depth == MAX_EVAL_DEPTH) {
+        return 0;
+    }
+    // Functions see only their parameters
+    Env frame = {func->param_names, values, func->arity, NULL};
+    pe->depth++;
+    int ok = eval(pe, func->body, &frame, out);
+    pe->depth--;
+    return ok;
+}
+
+// Combines right to left like generate_operator, so (- a b c) is
+// a - (b - c); evaluation order does not matter for pure arguments
+static int eval_arithmetic(PartialEval *pe, const char *op, ASTNode **args, int arg_count,
+                           Env *env, double *out) {
+    double acc;
+    if (!eval(pe, args[arg_count - 1], env, &acc)) {
+        return 0;
+    }
+    for (int i = arg_count - 2; i >= 0; i--) {
+        double value;
+        if (!eval(pe, args[i], env, &value)) {
+            return 0;
+        }
+        switch (op[0]) {
+            case '+': acc = value + acc; break;
+            case '-': acc = value - acc; break;
+            case '*': acc = value * acc; break;
+            default:  acc = value / acc; break;
+        }
+        if (!isfinite(acc)) {
+            return 0;
+        }
+    }
+    *out = acc;
+    return 1;
+}
+
+static int eval_comparison(PartialEval *pe, const char *op, ASTNode **args, Env *env,
+                           double *out) {
+    double a;
+    double b;
+    if (!eval(pe, args[0], env, &a) || !eval(pe, args[1], env, &b)) {
+        return 0;
+    }
+    int result;
+    if (strcmp(op, "<") == 0) {
+        result = a < b;
+    } else if (strcmp(op, ">") == 0) {
+        result = a > b;
+    } else if (strcmp(op, "=") == 0) {
+        result = a == b;
+    } else if (strcmp(op, "<=") == 0) {
+        result = a <= b;
+    } else {
+        result = a >= b;
+    }
+    *out = result ? 1.0 : 0.0;
+    return 1;
+}
+
+// `node` is a pure expression, see is_pure_expr
+static int eval(PartialEval *pe, ASTNode *node, Env *env, double *out) {
+    if (++pe->steps > MAX_EVAL_STEPS) {
+        return 0;
+    }
+    if (node->type == AST_NUMBER) {
+        *out = node->as.number;
+        return isfinite(*out);
+    }
+    if (node->type == AST_SYMBOL) {
+        return lookup(env, node->as.symbol, out);
+    }
+
+    const char *symbol = head_symbol(node);
+    ASTNode **args = &node->as.list.elements[1];
+    int arg_count = node->as.list.count - 1;
+
+    if (strcmp(symbol, "let") == 0) {
+        return eval_let(pe, args, env, out);
+    }
+    if (strcmp(symbol, "if") == 0) {
+        double test;
+        if (!eval(pe, args[0], env, &test)) {
+            return 0;
+        }
+        return eval(pe, args[test != 0.0 ? 1 : 2], env, out);
+    }
+    if (is_arithmetic(symbol)) {
+        return eval_arithmetic(pe, symbol, args, arg_count, env, out);
+    }
+    if (is_comparison(symbol)) {
+        return eval_comparison(pe, symbol, args, env, out);
+    }
+    return eval_call(pe, user_function(pe, symbol, arg_count), args, env, out);
+}
+
+// Literal arguments of a call to func, in args
+static void call_args(ASTNode *node, double *args) {
+    for (int i = 1; i < node->as.list.count; i++) {
+        args[i - 1] = node->as.list.elements[i]->as.number;
+    }
+}
+
+static int known_to_fail(PartialEval *pe, FunctionInfo *func, const double *args) {
+    int out_of_steps = 0;
+    for (int i = 0; i < pe->failed_count; i++) {
+        FailedCall *failed = &pe->failed[i];
+        if (failed->func != func) {
+            continue;
+        }
+        // Compared bitwise, so -0 and 0 stay apart
+        if (memcmp(failed->args, args, func->arity * sizeof(double)) == 0) {
+            return 1;
+        }
+        out_of_steps += failed->out_of_steps;
+    }
+    return out_of_steps >= MAX_BUDGET_FAILURES;
+}
+
+static void remember_failure(PartialEval *pe, FunctionInfo *func, const double *args) {
+    if (pe->failed_count >= pe->failed_capacity) {
+        pe->failed_capacity = pe->failed_capacity ? pe->failed_capacity * 2 : 16;
+        pe->failed = realloc(pe->failed, pe->failed_capacity * sizeof(FailedCall));
+    }
+    FailedCall *failed = &pe->failed[pe->failed_count++];
+    failed->func = func;
+    memcpy(failed->args, args, func->arity * sizeof(double));
+    failed->out_of_steps = pe->steps > MAX_EVAL_STEPS;
+}
+
+static void replace_with_number(ASTNode *node, double value) {
+    for (int i = 0; i < node->as.list.count; i++) {
+        free_ast(node->as.list.elements[i]);
+    }
+    free(node->as.list.elements);
+    node->type = AST_NUMBER;
+    node->as.number = value;
+}
+
+// Folds the children first, so a call is tried once its arguments are
+// literals
+static int fold(PartialEval *pe, ASTNode *node) {
+    if ((node->type != AST_LIST && node->type != AST_MAP) || node->as.list.count == 0) {
+        return 0;
+    }
+
+    const char *symbol = node->type == AST_LIST ? head_symbol(node) : NULL;
+    ASTNode **elements = node->as.list.elements;
+    int count = node->as.list.count;
+    int folded = 0;
+
+    if (symbol && strcmp(symbol, "quote") == 0) {
+        return 0;
+    }
+    if (symbol && (strcmp(symbol, "defn") == 0 || strcmp(symbol, "defn-memo") == 0)) {
+        // Only the body is an expression
+        return count >= 4 ? fold(pe, elements[count - 1]) : 0;
+    }
+    if (symbol && strcmp(symbol, "def") == 0) {
+        return count == 3 ? fold(pe, elements[2]) : 0;
+    }
+    if (symbol && strcmp(symbol, "let") == 0 && count == 3 && elements[1]->type == AST_LIST) {
+        ASTNode *bindings = elements[1];
+        for (int i = 1; i < bindings->as.list.count; i += 2) {
+            folded += fold(pe, bindings->as.list.elements[i]);
+        }
+        return folded + fold(pe, elements[2]);
+    }
+
+    for (int i = 0; i < count; i++) {
+        folded += fold(pe, elements[i]);
+    }
+
+    if (!symbol || !(is_arithmetic(symbol) || is_comparison(symbol) ||
+                     user_function(pe, symbol, count - 1))) {
+        return folded;
+    }
+    for (int i = 1; i < count; i++) {
+        if (elements[i]->type != AST_NUMBER) {
+            return folded;
+        }
+    }
+
+    FunctionInfo *func = user_function(pe, symbol, count - 1);
+    double args[MAX_EVAL_ARGS];
+    if (func) {
+        call_args(node, args);
+        if (known_to_fail(pe, func, args)) {
+            return folded;
+        }
+    }
+
+    double value;
+    pe->steps = 0;
+    pe->depth = 0;
+    if (!is_pure_expr(pe, node)) {
+        return folded;
+    }
+    if (eval(pe, node, NULL, &value)) {
+        replace_with_number(node, value);
+        folded++;
+    } else if (func) {
+        remember_failure(pe, func, args);
+    }
+    return folded;
+}
+
+static int is_def_form(ASTNode *node) {
+    const char *symbol = head_symbol(node);
+    return symbol && strcmp(symbol, "def") == 0 && node->as.list.count == 3 &&
+           node->as.list.elements[1]->type == AST_SYMBOL;
+}
+
+// Same top-level shapes as collect_functions in codegen
+static void collect_globals(PartialEval *pe, ASTNode *ast) {
+    int count = ast->type == AST_LIST ? ast->as.list.count : 0;
+    pe->globals = malloc((count + 1) * sizeof(char *));
+    pe->global_count = 0;
+    if (is_def_form(ast)) {
+        pe->globals[pe->global_count++] = ast->as.list.elements[1]->as.symbol;
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        if (is_def_form(ast->as.list.elements[i])) {
+            pe->globals[pe->global_count++] = ast->as.list.elements[i]->as.list.elements[1]->as.symbol;
+        }
+    }
+}
+
+int partial_eval(SymbolTable *symbols, ASTNode *ast) {
+    PartialEval pe;
+    pe.symbols = symbols;
+    pe.steps = 0;
+    pe.depth = 0;
+    pe.failed = NULL;
+    pe.failed_count = 0;
+    pe.failed_capacity = 0;
+    collect_globals(&pe, ast);
+    analyze_purity(&pe);
+
+    int folded = fold(&pe, ast);
+    free(pe.globals);
+    free(pe.failed);
+    return folded;
+}
@@ -0,0 +1,121 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "profile.h"
+
+#define INITIAL_PROFILE_CAPACITY 16
+
+static void add_calls(Profile *profile, const char *name, long calls) {
+    for (int i = 0; i < profile->function_count; i++) {
+        if (strcmp(profile->functions[i].name, name) == 0) {
+            profile->functions[i].calls += calls;
+            return;
+        }
+    }
+    if (profile->function_count >= profile->function_capacity) {
+        profile->function_capacity *= 2;
+        profile->functions = realloc(profile->functions,
+                                     profile->function_capacity * sizeof(ProfileFunction));
+    }
+    profile->functions[profile->function_count].name = strdup(name);
+    profile->functions[profile->function_count].calls = calls;
+    profile->function_count++;
+}
+
+static void add_branch(Profile *profile, int line, int column, long then_count, long else_count) {
+    for (int i = 0; i < profile->branch_count; i++) {
+        ProfileBranch *branch = &profile->branches[i];
+        if (branch->line == line && branch->column == column) {
+            branch->then_count += then_count;
+            branch->else_count += else_count;
+            return;
+        }
+    }
+    if (profile->branch_count >= profile->branch_capacity) {
+        profile->branch_capacity *= 2;
+        profile->branches = realloc(profile->branches,
+                                    profile->branch_capacity * sizeof(ProfileBranch));
+    }
+    ProfileBranch *branch = &profile->branches[profile->branch_count++];
+    branch->line = line;
+    branch->column = column;
+    branch->then_count = then_count;
+    branch->else_count = else_count;
+}
+
+Profile *load_profile(const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "Error: Could not open profile: %s\n", path);
+        exit(1);
+    }
+
+    char line[512];
+    if (!fgets(line, sizeof(line), f) || strcmp(line, "cljc-profile 1\n") != 0) {
+        fprintf(stderr, "Error: %s is not a cljc profile\n", path);
+        exit(1);
+    }
+
+    Profile *profile = malloc(sizeof(Profile));
+    profile->function_capacity = INITIAL_PROFILE_CAPACITY;
+    profile->function_count = 0;
+    profile->functions = malloc(INITIAL_PROFILE_CAPACITY * sizeof(ProfileFunction));
+    profile->branch_capacity = INITIAL_PROFILE_CAPACITY;
+    profile->branch_count = 0;
+    profile->branches = malloc(INITIAL_PROFILE_CAPACITY * sizeof(ProfileBranch));
+    profile->max_calls = 0;
+
+    int number = 1;
+    while (fgets(line, sizeof(line), f)) {
+        number++;
+        char name[256];
+        long calls, then_count, else_count;
+        int src_line, src_column;
+        if (sscanf(line, "function %255s %ld", name, &calls) == 2) {
+            add_calls(profile, name, calls);
+        } else if (sscanf(line, "branch %d:%d %ld %ld", &src_line, &src_column,
+                          &then_count, &else_count) == 4) {
+            add_branch(profile, src_line, src_column, then_count, else_count);
+        } else if (line[0] != '\n') {
+            fprintf(stderr, "Error: Malformed profile record at %s:%d\n", path, number);
+            exit(1);
+        }
+    }
+    fclose(f);
+
+    for (int i = 0; i < profile->function_count; i++) {
+        if (profile->functions[i].calls > profile->max_calls) {
+            profile->max_calls = profile->functions[i].calls;
+        }
+    }
+    return profile;
+}
+
+// 0 for functions the profiled program never called or did not have
+long profile_calls(const Profile *profile, const char *name) {
+    for (int i = 0; i < profile->function_count; i++) {
+        if (strcmp(profile->functions[i].name, name) == 0) {
+            return profile->functions[i].calls;
+        }
+    }
+    return 0;
+}
+
+const ProfileBranch *profile_branch(const Profile *profile, int line, int column) {
+    for (int i = 0; i < profile->branch_count; i++) {
+        if (profile->branches[i].line == line && profile->branches[i].column == column) {
+            return &profile->branches[i];
+        }
+    }
+    return NULL;
+}
+
+void free_profile(Profile *profile) {
+    for (int i = 0; i < profile->function_count; i++) {
+        free(profile->functions[i].name);
+    }
+    free(profile->functions);
+    free(profile->branches);
+    free(profile);
+}
@@ -0,0 +1,53 @@
+#include <string.h>
+#include "reachability.h"
+
+// Dead-function elimination.
+//
+// Runs after partial evaluation, so a function whose every call was
+// folded to a number is dead too. Any symbol naming a function counts as
+// a use of it -- a call, a value passed to map or reduce, or a name that
+// a local happens to shadow -- which keeps the analysis conservative
+// without resolving scopes.
+
+static int is_defn_form(ASTNode *node) {
+    if (node->type != AST_LIST || node->as.list.count == 0 ||
+        node->as.list.elements[0]->type != AST_SYMBOL) {
+        return 0;
+    }
+    const char *symbol = node->as.list.elements[0]->as.symbol;
+    return strcmp(symbol, "defn") == 0 || strcmp(symbol, "defn-memo") == 0;
+}
+
+static void mark(SymbolTable *symbols, ASTNode *node) {
+    if (node->type == AST_SYMBOL) {
+        FunctionInfo *func = lookup_function(symbols, node->as.symbol);
+        if (func && !func->reachable) {
+            func->reachable = 1;
+            mark(symbols, func->body);
+        }
+        return;
+    }
+    if (node->type != AST_LIST && node->type != AST_MAP) {
+        return;
+    }
+    // A defn is only walked once something uses its name
+    if (is_defn_form(node)) {
+        return;
+    }
+    for (int i = 0; i < node->as.list.count; i++) {
+        mark(symbols, node->as.list.elements[i]);
+    }
+}
+
+int mark_reachable(SymbolTable *symbols, ASTNode *ast) {
+    for (int i = 0; i < symbols->function_count; i++) {
+        symbols->functions[i]->reachable = 0;
+    }
+    mark(symbols, ast);
+
+    int dead = 0;
+    for (int i = 0; i < symbols->function_count; i++) {
+        dead += !symbols->functions[i]->reachable;
+    }
+    return dead;
+}
@@ -1,3 +1,4 @@
+#define _POSIX_C_SOURCE 200809L
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -37,6 +38,13 @@ void add_function(SymbolTable *table, const char *name, int arity,
         if (*p == '-') *p = '_';
     }
     func->label = label;
+    func->used_as_value = 0;
+    func->pure = 0;
+    func->memo = 0;
+    func->memo_max_entries = 0;
+    func->memo_evict = 0;
+    // Functions lifted during codegen (future bodies) are always emitted
+    func->reachable = 1;
 
     table->functions[table->function_count++] = func;
 }
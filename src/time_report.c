@@ -0,0 +1,243 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+#include "time_report.h"
+
+// Compile phase statistics.
+//
+// The Makefile force-includes heap_count.h into every compiler object but
+// this one, so their malloc, calloc, realloc and strdup calls land in the
+// counters below. A phase's numbers are the calls it made and the bytes
+// it asked for; a realloc counts as a new allocation of its full size.
+// A build without heap_count.h never reaches the counters, and reports
+// no numbers ("-" / null) rather than zeros.
+
+#define MAX_PHASES 32
+#define MAX_COUNTS 32
+
+typedef struct {
+    const char *name;
+    double wall_ms;
+    long allocs;
+    long bytes;
+    long peak_rss_kb;  // Process peak when the phase last ended
+} Phase;
+
+typedef struct {
+    const char *name;
+    long value;
+} Count;
+
+static int enabled = 0;
+static Phase phases[MAX_PHASES];
+static int phase_count = 0;
+static Count counts[MAX_COUNTS];
+static int count_count = 0;
+
+static Phase *current_phase = NULL;
+static struct timespec phase_start;
+static long phase_allocs;
+static long phase_bytes;
+
+static long alloc_calls = 0;
+static long alloc_bytes = 0;
+
+void *counted_malloc(size_t size) {
+    alloc_calls++;
+    alloc_bytes += (long)size;
+    return malloc(size);
+}
+
+void *counted_calloc(size_t count, size_t size) {
+    alloc_calls++;
+    alloc_bytes += (long)(count * size);
+    return calloc(count, size);
+}
+
+void *counted_realloc(void *ptr, size_t size) {
+    alloc_calls++;
+    alloc_bytes += (long)size;
+    return realloc(ptr, size);
+}
+
+char *counted_strdup(const char *s) {
+    alloc_calls++;
+    alloc_bytes += (long)strlen(s) + 1;
+    return strdup(s);
+}
+
+static long peak_rss_kb(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;  // Bytes on macOS
+#else
+    return usage.ru_maxrss;
+#endif
+}
+
+static double elapsed_ms(struct timespec *start, struct timespec *end) {
+    return (end->tv_sec - start->tv_sec) * 1e3 + (end->tv_nsec - start->tv_nsec) / 1e6;
+}
+
+void time_report_enable(void) {
+    enabled = 1;
+}
+
+int time_report_enabled(void) {
+    return enabled;
+}
+
+void phase_begin(const char *name) {
+    if (!enabled) {
+        return;
+    }
+
+    current_phase = NULL;
+    for (int i = 0; i < phase_count; i++) {
+        if (strcmp(phases[i].name, name) == 0) {
+            current_phase = &phases[i];
+        }
+    }
+    if (!current_phase) {
+        if (phase_count == MAX_PHASES) {
+            return;
+        }
+        current_phase = &phases[phase_count++];
+        current_phase->name = name;
+        current_phase->wall_ms = 0;
+        current_phase->allocs = 0;
+        current_phase->bytes = 0;
+    }
+    phase_allocs = alloc_calls;
+    phase_bytes = alloc_bytes;
+    clock_gettime(CLOCK_MONOTONIC, &phase_start);
+}
+
+void phase_end(void) {
+    if (!enabled || !current_phase) {
+        return;
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    current_phase->wall_ms += elapsed_ms(&phase_start, &now);
+    current_phase->allocs += alloc_calls - phase_allocs;
+    current_phase->bytes += alloc_bytes - phase_bytes;
+    current_phase->peak_rss_kb = peak_rss_kb();
+    current_phase = NULL;
+}
+
+void time_report_count(const char *name, long value) {
+    if (!enabled) {
+        return;
+    }
+
+    for (int i = 0; i < count_count; i++) {
+        if (strcmp(counts[i].name, name) == 0) {
+            counts[i].value = value;
+            return;
+        }
+    }
+    if (count_count < MAX_COUNTS) {
+        counts[count_count].name = name;
+        counts[count_count].value = value;
+        count_count++;
+    }
+}
+
+// Indented lines that are neither directives nor comments
+long count_instructions(const char *text) {
+    long instructions = 0;
+    for (const char *line = text; *line;) {
+        const char *p = line;
+        while (*p == ' ' || *p == '\t') {
+            p++;
+        }
+        if (p != line && *p && *p != '\n' && *p != '.' && *p != '/' && *p != ';') {
+            instructions++;
+        }
+        const char *next = strchr(p, '\n');
+        if (!next) {
+            break;
+        }
+        line = next + 1;
+    }
+    return instructions;
+}
+
+static void print_heap_column(FILE *f, int width, long value) {
+    if (alloc_calls == 0) {
+        fprintf(f, " %*s", width, "-");
+    } else {
+        fprintf(f, " %*ld", width, value);
+    }
+}
+
+static void print_table(FILE *f) {
+    double total_ms = 0;
+    long total_allocs = 0;
+    long total_bytes = 0;
+    long peak = 0;
+
+    fprintf(f, "%-24s %10s %10s %12s %12s\n", "Phase", "Wall ms", "Allocs", "Bytes", "Peak RSS KB");
+    for (int i = 0; i < phase_count; i++) {
+        Phase *p = &phases[i];
+        fprintf(f, "%-24s %10.3f", p->name, p->wall_ms);
+        print_heap_column(f, 10, p->allocs);
+        print_heap_column(f, 12, p->bytes);
+        fprintf(f, " %12ld\n", p->peak_rss_kb);
+
+        total_ms += p->wall_ms;
+        total_allocs += p->allocs;
+        total_bytes += p->bytes;
+        if (p->peak_rss_kb > peak) {
+            peak = p->peak_rss_kb;
+        }
+    }
+    fprintf(f, "%-24s %10.3f", "total", total_ms);
+    print_heap_column(f, 10, total_allocs);
+    print_heap_column(f, 12, total_bytes);
+    fprintf(f, " %12ld\n", peak);
+
+    if (count_count > 0) {
+        fprintf(f, "\n");
+    }
+    for (int i = 0; i < count_count; i++) {
+        fprintf(f, "%-24s %10ld\n", counts[i].name, counts[i].value);
+    }
+}
+
+static void print_json(FILE *f) {
+    fprintf(f, "{\"phases\": [");
+    for (int i = 0; i < phase_count; i++) {
+        Phase *p = &phases[i];
+        fprintf(f, "%s\n  {\"name\": \"%s\", \"wall_ms\": %.3f, ",
+                i ? "," : "", p->name, p->wall_ms);
+        if (alloc_calls == 0) {
+            fprintf(f, "\"allocs\": null, \"bytes\": null");
+        } else {
+            fprintf(f, "\"allocs\": %ld, \"bytes\": %ld", p->allocs, p->bytes);
+        }
+        fprintf(f, ", \"peak_rss_kb\": %ld}", p->peak_rss_kb);
+    }
+    fprintf(f, "\n], \"counts\": {");
+    for (int i = 0; i < count_count; i++) {
+        fprintf(f, "%s\n  \"%s\": %ld", i ? "," : "", counts[i].name, counts[i].value);
+    }
+    fprintf(f, "\n}}\n");
+}
+
+void time_report_print(FILE *f, TimeReportFormat format) {
+    if (!enabled) {
+        return;
+    }
+    if (format == TIME_REPORT_JSON) {
+        print_json(f);
+    } else {
+        print_table(f);
+    }
+}
@@ -1,3 +1,4 @@
+#define _POSIX_C_SOURCE 200809L
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -147,6 +148,31 @@ static Token tokenize_string(Tokenizer *t) {
     return token;
 }
 
+static Token tokenize_keyword(Tokenizer *t) {
+    int start_col = t->column;
+
+    // Skip the colon
+    advance(t);
+    int start = t->current;
+
+    while (!is_at_end(t) && is_symbol_char(peek(t))) {
+        advance(t);
+    }
+
+    int length = t->current - start;
+    if (length == 0) {
+        return create_token(TOKEN_ERROR, "Empty keyword", t->line, start_col);
+    }
+
+    char *value = malloc(length + 1);
+    strncpy(value, t->source + start, length);
+    value[length] = '\0';
+
+    Token token = create_token(TOKEN_KEYWORD, value, t->line, start_col);
+    free(value);
+    return token;
+}
+
 TokenList *tokenize(const char *source) {
     Tokenizer t;
     init_tokenizer(&t, source);
@@ -178,8 +204,16 @@ TokenList *tokenize(const char *source) {
         } else if (c == ']') {
             advance(&t);
             add_token(list, create_token(TOKEN_RIGHT_BRACKET, "]", t.line, col));
+        } else if (c == '{') {
+            advance(&t);
+            add_token(list, create_token(TOKEN_LEFT_BRACE, "{", t.line, col));
+        } else if (c == '}') {
+            advance(&t);
+            add_token(list, create_token(TOKEN_RIGHT_BRACE, "}", t.line, col));
         } else if (c == '"') {
             add_token(list, tokenize_string(&t));
+        } else if (c == ':') {
+            add_token(list, tokenize_keyword(&t));
         } else if (isdigit(c)) {
             add_token(list, tokenize_number(&t));
         } else if (is_symbol_char(c)) {
@@ -210,23 +244,26 @@ const char *token_type_to_string(TokenType type) {
         case TOKEN_RIGHT_PAREN: return "RIGHT_PAREN";
         case TOKEN_LEFT_BRACKET: return "LEFT_BRACKET";
         case TOKEN_RIGHT_BRACKET: return "RIGHT_BRACKET";
+        case TOKEN_LEFT_BRACE: return "LEFT_BRACE";
+        case TOKEN_RIGHT_BRACE: return "RIGHT_BRACE";
         case TOKEN_NUMBER: return "NUMBER";
         case TOKEN_SYMBOL: return "SYMBOL";
         case TOKEN_STRING: return "STRING";
+        case TOKEN_KEYWORD: return "KEYWORD";
         case TOKEN_EOF: return "EOF";
         case TOKEN_ERROR: return "ERROR";
         default: return "UNKNOWN";
     }
 }
 
-void print_tokens(TokenList *list) {
-    printf("Tokens (%d):\n", list->count);
+void print_tokens(FILE *f, TokenList *list) {
+    fprintf(f, "Tokens (%d):\n", list->count);
     for (int i = 0; i < list->count; i++) {
         Token *t = &list->tokens[i];
-        printf("  [%d:%d] %-15s", t->line, t->column, token_type_to_string(t->type));
+        fprintf(f, "  [%d:%d] %-15s", t->line, t->column, token_type_to_string(t->type));
         if (t->value) {
-            printf(" '%s'", t->value);
+            fprintf(f, " '%s'", t->value);
         }
-        printf("\n");
+        fprintf(f, "\n");
     }
 }
@@ -0,0 +1,208 @@
+#include <stdlib.h>
+#include <string.h>
+#include "uniqueness.h"
+
+// Last-use analysis for copy-on-write collections.
+//
+// Collections are updated in place while only one reference exists (see
+// rt_share in runtime.h). Reading a local that is read again later makes
+// a second reference, so the compiler shares the value at such loads; the
+// final read moves it, letting accumulator-style recursion like
+// (recur-fn (append acc x)) append in place.
+//
+// The analysis is conservative: names are compared by spelling, so an
+// inner binding's reads count against an outer binding of the same name,
+// and the arguments of one call are treated as evaluated at once, since
+// not every builtin evaluates them left to right.
+//
+// Reads that only feed arithmetic, a comparison, an if test or a builtin
+// that returns a number are marked consumed: the value cannot end up in a
+// second place there, so the load needs no share whether or not it is the
+// last use.
+
+typedef struct NameSet {
+    const char **names;
+    int count;
+    int capacity;
+} NameSet;
+
+static void set_init(NameSet *set) {
+    set->names = NULL;
+    set->count = 0;
+    set->capacity = 0;
+}
+
+static int set_has(NameSet *set, const char *name) {
+    for (int i = 0; i < set->count; i++) {
+        if (strcmp(set->names[i], name) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void set_add(NameSet *set, const char *name) {
+    if (set_has(set, name)) {
+        return;
+    }
+    if (set->count >= set->capacity) {
+        set->capacity = set->capacity ? set->capacity * 2 : 8;
+        set->names = realloc(set->names, set->capacity * sizeof(char *));
+    }
+    set->names[set->count++] = name;
+}
+
+static void set_add_all(NameSet *set, NameSet *other) {
+    for (int i = 0; i < other->count; i++) {
+        set_add(set, other->names[i]);
+    }
+}
+
+static void set_free(NameSet *set) {
+    free(set->names);
+}
+
+static const char *head_symbol(ASTNode *node) {
+    if (node->type == AST_LIST && node->as.list.count > 0 &&
+        node->as.list.elements[0]->type == AST_SYMBOL) {
+        return node->as.list.elements[0]->as.symbol;
+    }
+    return "";
+}
+
+// Builtins that read their arguments and return a number, keeping no
+// reference to them
+static int consumes_arguments(const char *head) {
+    static const char *heads[] = {
+        "+", "-", "*", "/", "<", ">", "=", "<=", ">=",
+        "list-count", "str-length", "str-char-at",
+        "list-sum", "list-product", "list-dot", "list-min", "list-max", NULL
+    };
+    for (int i = 0; heads[i]; i++) {
+        if (strcmp(head, heads[i]) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void mark_consumed(ASTNode *node) {
+    if (node->type == AST_SYMBOL) {
+        node->consumed = 1;
+    }
+}
+
+// Every name an expression reads, including captures of nested bodies
+static void collect_uses(ASTNode *node, NameSet *uses) {
+    if (node->type == AST_SYMBOL) {
+        set_add(uses, node->as.symbol);
+        return;
+    }
+    if ((node->type != AST_LIST && node->type != AST_MAP) ||
+        strcmp(head_symbol(node), "quote") == 0) {
+        return;
+    }
+    for (int i = 0; i < node->as.list.count; i++) {
+        collect_uses(node->as.list.elements[i], uses);
+    }
+}
+
+static void analyze(ASTNode *node, NameSet *after);
+
+// Analyzes elements[from..count) as if evaluated at once: each one sees
+// the reads of all the others as coming after it
+static void analyze_together(ASTNode **elements, int from, int count, NameSet *after) {
+    for (int i = from; i < count; i++) {
+        NameSet later;
+        set_init(&later);
+        set_add_all(&later, after);
+        for (int j = from; j < count; j++) {
+            if (j != i) {
+                collect_uses(elements[j], &later);
+            }
+        }
+        analyze(elements[i], &later);
+        set_free(&later);
+    }
+}
+
+static void analyze_let(ASTNode *node, NameSet *after) {
+    if (node->as.list.count != 3 || node->as.list.elements[1]->type != AST_LIST) {
+        return;  // Reported by codegen
+    }
+    ASTNode *bindings = node->as.list.elements[1];
+    ASTNode *body = node->as.list.elements[2];
+
+    // Bindings run in order, then the body: walk them backwards
+    NameSet later;
+    set_init(&later);
+    set_add_all(&later, after);
+    analyze(body, &later);
+    collect_uses(body, &later);
+    for (int i = bindings->as.list.count - 1; i >= 1; i -= 2) {
+        ASTNode *init = bindings->as.list.elements[i];
+        analyze(init, &later);
+        collect_uses(init, &later);
+    }
+    set_free(&later);
+}
+
+static void analyze(ASTNode *node, NameSet *after) {
+    if (node->type == AST_SYMBOL) {
+        node->last_use = !set_has(after, node->as.symbol);
+        node->consumed = 0;
+        return;
+    }
+    if (node->type == AST_MAP) {
+        analyze_together(node->as.list.elements, 0, node->as.list.count, after);
+        return;
+    }
+    if (node->type != AST_LIST || node->as.list.count == 0) {
+        return;
+    }
+
+    const char *head = head_symbol(node);
+    if (strcmp(head, "quote") == 0 || strcmp(head, "future") == 0 ||
+        strcmp(head, "go") == 0) {
+        // Captured locals are always shared with the lifted body
+        return;
+    }
+
+    if (strcmp(head, "let") == 0) {
+        analyze_let(node, after);
+        return;
+    }
+
+    if (strcmp(head, "if") == 0) {
+        // The test runs before either branch
+        NameSet later;
+        set_init(&later);
+        set_add_all(&later, after);
+        for (int i = 2; i < node->as.list.count; i++) {
+            analyze(node->as.list.elements[i], after);
+            collect_uses(node->as.list.elements[i], &later);
+        }
+        if (node->as.list.count > 1) {
+            analyze(node->as.list.elements[1], &later);
+            mark_consumed(node->as.list.elements[1]);
+        }
+        set_free(&later);
+        return;
+    }
+
+    // A keyword head is evaluated like an argument
+    int from = node->as.list.elements[0]->type == AST_SYMBOL ? 1 : 0;
+    analyze_together(node->as.list.elements, from, node->as.list.count, after);
+    if (consumes_arguments(head)) {
+        for (int i = 1; i < node->as.list.count; i++) {
+            mark_consumed(node->as.list.elements[i]);
+        }
+    }
+}
+
+void uniqueness_analyze(ASTNode *expr) {
+    NameSet after;
+    set_init(&after);
+    analyze(expr, &after);
+    set_free(&after);
+}